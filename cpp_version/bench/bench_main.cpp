@@ -0,0 +1,84 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "bench_utility.h"
+
+#ifndef RANGER_SAMPLES_DIR
+#define RANGER_SAMPLES_DIR "../../alex_tests/samples"
+#endif
+
+// Additional options:
+//   --rows=N, --cols=N, --trees=N  Size of synthetic datasets and forests
+//   --maxdepth=N                   Maximal tree depth, 0 for unlimited
+//   --samples=DIR                  Directory with sample images
+//   --tmpdir=DIR                   Directory for temporary files
+// Results are written to ranger_bench.json unless --benchmark_out is given.
+int main(int argc, char** argv) {
+  ranger_bench::BenchConfig& config = ranger_bench::benchConfig();
+  config.samples_dir = RANGER_SAMPLES_DIR;
+  const char* tmp_dir = std::getenv("TMPDIR");
+  config.tmp_dir = tmp_dir ? tmp_dir : "/tmp";
+
+  std::vector<char*> args;
+  bool has_out = false;
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    try {
+      if (arg.compare(0, 7, "--rows=") == 0) {
+        config.num_rows = std::stoul(arg.substr(7));
+      } else if (arg.compare(0, 7, "--cols=") == 0) {
+        config.num_cols = std::stoul(arg.substr(7));
+      } else if (arg.compare(0, 8, "--trees=") == 0) {
+        config.num_trees = std::stoul(arg.substr(8));
+      } else if (arg.compare(0, 11, "--maxdepth=") == 0) {
+        config.max_depth = std::stoul(arg.substr(11));
+      } else if (arg.compare(0, 10, "--samples=") == 0) {
+        config.samples_dir = arg.substr(10);
+      } else if (arg.compare(0, 9, "--tmpdir=") == 0) {
+        config.tmp_dir = arg.substr(9);
+      } else {
+        has_out = has_out || arg.compare(0, 16, "--benchmark_out=") == 0;
+        args.push_back(argv[i]);
+      }
+    } catch (...) {
+      std::cerr << "Error: Illegal argument " << arg << "." << std::endl;
+      return 1;
+    }
+  }
+
+  // JSON output by default to track results across releases
+  char out[] = "--benchmark_out=ranger_bench.json";
+  char format[] = "--benchmark_out_format=json";
+  if (!has_out) {
+    args.push_back(out);
+    args.push_back(format);
+  }
+
+  int num_args = args.size();
+  benchmark::Initialize(&num_args, args.data());
+  if (benchmark::ReportUnrecognizedArguments(num_args, args.data())) {
+    return 1;
+  }
+  benchmark::AddCustomContext("rows", std::to_string(config.num_rows));
+  benchmark::AddCustomContext("cols", std::to_string(config.num_cols));
+  benchmark::AddCustomContext("trees", std::to_string(config.num_trees));
+  benchmark::AddCustomContext("maxdepth", std::to_string(config.max_depth));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
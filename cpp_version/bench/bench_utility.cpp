@@ -0,0 +1,139 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include "bench_utility.h"
+#include "ForestClassification.h"
+#include "ForestProbability.h"
+#include "ForestRegression.h"
+#include "ForestSurvival.h"
+
+namespace ranger_bench {
+
+BenchConfig& benchConfig() {
+  static BenchConfig config;
+  return config;
+}
+
+SyntheticData::SyntheticData(size_t num_rows, size_t num_cols, TreeType treetype, uint seed) {
+  this->num_rows = num_rows;
+  this->num_cols = num_cols;
+  this->num_cols_no_snp = num_cols;
+  this->externalData = false;
+  for (size_t col = 0; col < num_cols; ++col) {
+    variable_names.push_back("x" + std::to_string(col));
+  }
+  reserveMemory(syntheticDependentVariableNames(treetype).size());
+  setIsOrderedVariable(std::vector<std::string>());
+
+  // Integer values 0..255 like image channels
+  std::mt19937_64 random_number_generator(seed);
+  std::uniform_int_distribution<int> value_distribution(0, 255);
+  std::normal_distribution<double> noise_distribution(0, 0.3);
+  std::uniform_real_distribution<double> unif_distribution(0, 1);
+  bool error = false;
+  for (size_t row = 0; row < num_rows; ++row) {
+    for (size_t col = 0; col < num_cols; ++col) {
+      set_x(col, row, value_distribution(random_number_generator), error);
+    }
+    double signal = get_x(row, 0) / 255 + 2 * get_x(row, std::min((size_t) 1, num_cols - 1)) / 255 - 1.5
+        + noise_distribution(random_number_generator);
+    switch (treetype) {
+    case TREE_CLASSIFICATION:
+    case TREE_PROBABILITY:
+      set_y(0, row, signal > 0, error);
+      break;
+    case TREE_REGRESSION:
+      set_y(0, row, 1 / (1 + exp(-signal)), error);
+      break;
+    case TREE_SURVIVAL:
+      // Exponential survival times, discretized to at most 100 time points
+      set_y(0, row, std::min(100.0, ceil(-10 * log(1 - unif_distribution(random_number_generator)) / exp(signal))),
+          error);
+      set_y(1, row, unif_distribution(random_number_generator) < 0.7, error);
+      break;
+    }
+  }
+}
+
+std::vector<std::string> syntheticDependentVariableNames(TreeType treetype) {
+  if (treetype == TREE_SURVIVAL) {
+    return {"time", "status"};
+  } else {
+    return {"y"};
+  }
+}
+
+std::string writeSyntheticCsv(size_t num_rows, size_t num_cols, TreeType treetype) {
+  std::string filename = benchConfig().tmp_dir + "/ranger_bench_" + std::to_string(num_rows) + "x"
+      + std::to_string(num_cols) + "_" + std::to_string(treetype) + ".csv";
+  std::vector<std::string> dependent_variable_names = syntheticDependentVariableNames(treetype);
+  SyntheticData data(num_rows, num_cols, treetype);
+
+  std::ofstream outfile;
+  outfile.open(filename);
+  if (!outfile.good()) {
+    throw std::runtime_error("Could not write to output file: " + filename + ".");
+  }
+  outfile.precision(17);
+
+  // Dependent variables last
+  for (auto& name : data.getVariableNames()) {
+    outfile << name << ",";
+  }
+  for (size_t i = 0; i < dependent_variable_names.size(); ++i) {
+    outfile << dependent_variable_names[i] << (i + 1 < dependent_variable_names.size() ? "," : "\n");
+  }
+  for (size_t row = 0; row < num_rows; ++row) {
+    for (size_t col = 0; col < num_cols; ++col) {
+      outfile << data.get_x(row, col) << ",";
+    }
+    for (size_t i = 0; i < dependent_variable_names.size(); ++i) {
+      outfile << data.get_y(row, i) << (i + 1 < dependent_variable_names.size() ? "," : "\n");
+    }
+  }
+  return filename;
+}
+
+std::string sampleImage() {
+  return benchConfig().samples_dir + "/img_msec_1597559030639_2_thumbnail.jpeg";
+}
+
+std::unique_ptr<Forest> createForest(TreeType treetype) {
+  switch (treetype) {
+  case TREE_CLASSIFICATION:
+    return make_unique_ranger<ForestClassification>();
+  case TREE_REGRESSION:
+    return make_unique_ranger<ForestRegression>();
+  case TREE_SURVIVAL:
+    return make_unique_ranger<ForestSurvival>();
+  case TREE_PROBABILITY:
+    return make_unique_ranger<ForestProbability>();
+  }
+  throw std::runtime_error("Unknown tree type.");
+}
+
+void initForest(Forest& forest, std::unique_ptr<Data> data, uint num_trees, SplitRule splitrule,
+    bool prediction_mode) {
+  std::vector<std::vector<double>> split_select_weights;
+  std::vector<double> case_weights;
+  std::vector<std::vector<size_t>> manual_inbag;
+  std::vector<double> sample_fraction = { DEFAULT_SAMPLE_FRACTION_REPLACE };
+  forest.initR(std::move(data), 0, num_trees, 0, 1, 1, IMP_NONE, 0, split_select_weights, { }, prediction_mode, true,
+      { }, false, splitrule, case_weights, manual_inbag, false, false, sample_fraction, DEFAULT_ALPHA,
+      DEFAULT_MINPROP, false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, false, benchConfig().max_depth, { }, false);
+}
+
+} // namespace ranger_bench
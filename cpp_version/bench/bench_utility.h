@@ -0,0 +1,78 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef BENCH_UTILITY_H_
+#define BENCH_UTILITY_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "globals.h"
+#include "DataDouble.h"
+#include "Forest.h"
+
+namespace ranger_bench {
+
+using namespace ranger;
+
+// Sizes of the synthetic datasets, set from the command line in main()
+struct BenchConfig {
+  size_t num_rows = 10000;
+  size_t num_cols = 10;
+  uint num_trees = 50;
+  uint max_depth = DEFAULT_MAXDEPTH;
+  std::string samples_dir;
+  std::string tmp_dir;
+};
+
+BenchConfig& benchConfig();
+
+// Synthetic data with uniform independent variables x0, x1, .. and a response depending on x0 and x1:
+// Two classes for classification and probability, values in (0,1) for regression and integer times in 1..100
+// and status for survival
+class SyntheticData: public DataDouble {
+public:
+  SyntheticData(size_t num_rows, size_t num_cols, TreeType treetype, uint seed = 1);
+};
+
+// Names of the dependent variables of the synthetic data
+std::vector<std::string> syntheticDependentVariableNames(TreeType treetype);
+
+// Write synthetic data to a CSV file in the temporary directory, returns the file name
+std::string writeSyntheticCsv(size_t num_rows, size_t num_cols, TreeType treetype);
+
+// First sample image committed to the repository
+std::string sampleImage();
+
+// Create empty forest of the given type
+std::unique_ptr<Forest> createForest(TreeType treetype);
+
+// Init forest with default parameters and the given data
+void initForest(Forest& forest, std::unique_ptr<Data> data, uint num_trees, SplitRule splitrule,
+    bool prediction_mode);
+
+// Exposes protected members of a forest for benchmarking
+template<typename T>
+class BenchForest: public T {
+public:
+  using Forest::loadFromFile;
+  void setOutputPrefix(const std::string& output_prefix) {
+    this->output_prefix = output_prefix;
+  }
+  void setDependentVariableNames(const std::vector<std::string>& dependent_variable_names) {
+    this->dependent_variable_names = dependent_variable_names;
+  }
+};
+
+} // namespace ranger_bench
+
+#endif /* BENCH_UTILITY_H_ */
@@ -0,0 +1,52 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include "benchmark/benchmark.h"
+#include "bench_utility.h"
+
+using namespace ranger_bench;
+
+static void loadFromFileAlexCsv(benchmark::State& state) {
+  const BenchConfig& config = benchConfig();
+  std::string filename = writeSyntheticCsv(config.num_rows, config.num_cols, TREE_REGRESSION);
+  std::vector<std::string> dependent_variable_names = syntheticDependentVariableNames(TREE_REGRESSION);
+  for (auto _ : state) {
+    DataDouble data;
+    data.loadFromFileAlex(filename, "", dependent_variable_names, false, 3);
+    benchmark::DoNotOptimize(data.getNumRows());
+  }
+  state.SetItemsProcessed(state.iterations() * config.num_rows);
+}
+BENCHMARK(loadFromFileAlexCsv)->Unit(benchmark::kMillisecond);
+
+static void loadFromFileAlexImage(benchmark::State& state) {
+  std::vector<std::string> dependent_variable_names = { "CLOUD" };
+  size_t num_rows = 0;
+  for (auto _ : state) {
+    DataDouble data;
+    data.loadFromFileAlex(sampleImage(), sampleImage(), dependent_variable_names, false, state.range(0));
+    num_rows = data.getNumRows();
+  }
+  state.SetItemsProcessed(state.iterations() * num_rows);
+}
+BENCHMARK(loadFromFileAlexImage)->Arg(1)->Arg(3)->Unit(benchmark::kMillisecond);
+
+static void sort(benchmark::State& state) {
+  const BenchConfig& config = benchConfig();
+  for (auto _ : state) {
+    state.PauseTiming();
+    SyntheticData data(config.num_rows, config.num_cols, TREE_REGRESSION);
+    state.ResumeTiming();
+    data.sort(state.range(0));
+  }
+  state.SetItemsProcessed(state.iterations() * config.num_rows * config.num_cols);
+}
+BENCHMARK(sort)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
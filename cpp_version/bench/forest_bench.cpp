@@ -0,0 +1,90 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include "benchmark/benchmark.h"
+#include "bench_utility.h"
+#include "ForestProbability.h"
+
+using namespace ranger_bench;
+
+// Grown once, then loaded into forests in prediction mode like the R package does
+static ForestProbability& trainedForest() {
+  static ForestProbability forest;
+  static bool grown = false;
+  if (!grown) {
+    const BenchConfig& config = benchConfig();
+    initForest(forest, make_unique_ranger<SyntheticData>(config.num_rows, config.num_cols, TREE_PROBABILITY),
+        config.num_trees, LOGRANK, false);
+    forest.run(false, false);
+    grown = true;
+  }
+  return forest;
+}
+
+static void loadTrainedForest(ForestProbability& forest) {
+  const BenchConfig& config = benchConfig();
+  ForestProbability& trained = trainedForest();
+  initForest(forest, make_unique_ranger<SyntheticData>(config.num_rows, config.num_cols, TREE_PROBABILITY, 2),
+      config.num_trees, LOGRANK, true);
+  std::vector<std::vector<std::vector<size_t>>> child_nodeIDs = trained.getChildNodeIDs();
+  std::vector<std::vector<size_t>> split_varIDs = trained.getSplitVarIDs();
+  std::vector<std::vector<double>> split_values = trained.getSplitValues();
+  std::vector<double> class_values = trained.getClassValues();
+  std::vector<std::vector<std::vector<double>>> terminal_class_counts = trained.getTerminalClassCounts();
+  std::vector<bool> is_ordered(config.num_cols, true);
+  forest.loadForest(config.num_trees, child_nodeIDs, split_varIDs, split_values, class_values, terminal_class_counts,
+      is_ordered);
+}
+
+// Prediction of all samples with each backend, including conversion of the trees for QuickScorer
+static void forestPredict(benchmark::State& state, PredictionBackend backend) {
+  ForestProbability forest;
+  loadTrainedForest(forest);
+  forest.setPredictionBackend(backend);
+  for (auto _ : state) {
+    forest.run(false, false);
+    benchmark::DoNotOptimize(forest.getPredictions()[0][0][0]);
+  }
+  state.SetItemsProcessed(state.iterations() * benchConfig().num_rows);
+}
+BENCHMARK_CAPTURE(forestPredict, traversal, BACKEND_TRAVERSAL)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(forestPredict, quickscorer, BACKEND_QUICKSCORER)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void forestSaveToFile(benchmark::State& state) {
+  BenchForest<ForestProbability> forest;
+  loadTrainedForest(forest);
+  forest.setOutputPrefix(benchConfig().tmp_dir + "/ranger_bench");
+  forest.setDependentVariableNames(syntheticDependentVariableNames(TREE_PROBABILITY));
+  for (auto _ : state) {
+    forest.saveToFile();
+  }
+}
+BENCHMARK(forestSaveToFile)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void forestLoadFromFile(benchmark::State& state) {
+  const BenchConfig& config = benchConfig();
+  {
+    BenchForest<ForestProbability> forest;
+    loadTrainedForest(forest);
+    forest.setOutputPrefix(config.tmp_dir + "/ranger_bench");
+    forest.setDependentVariableNames(syntheticDependentVariableNames(TREE_PROBABILITY));
+    forest.saveToFile();
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    BenchForest<ForestProbability> forest;
+    initForest(forest, make_unique_ranger<SyntheticData>(config.num_rows, config.num_cols, TREE_PROBABILITY, 2),
+        config.num_trees, LOGRANK, true);
+    state.ResumeTiming();
+    forest.loadFromFile(config.tmp_dir + "/ranger_bench.forest");
+  }
+}
+BENCHMARK(forestLoadFromFile)->Unit(benchmark::kMillisecond);
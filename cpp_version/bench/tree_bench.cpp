@@ -0,0 +1,75 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <algorithm>
+
+#include "benchmark/benchmark.h"
+#include "bench_utility.h"
+#include "ForestRegression.h"
+#include "TreeRegression.h"
+
+using namespace ranger_bench;
+
+// Grow trees of a forest in one worker thread, without OOB prediction. Data is sorted in the untimed setup.
+// The AUC and beta splitrules are much slower than the others and use at most 1000 samples.
+static void treeGrow(benchmark::State& state, TreeType treetype, SplitRule splitrule) {
+  const BenchConfig& config = benchConfig();
+  size_t num_rows = config.num_rows;
+  if (splitrule == AUC || splitrule == AUC_IGNORE_TIES || splitrule == BETA) {
+    num_rows = std::min(num_rows, (size_t) 1000);
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::unique_ptr<Forest> forest = createForest(treetype);
+    initForest(*forest, make_unique_ranger<SyntheticData>(num_rows, config.num_cols, treetype), config.num_trees,
+        splitrule, false);
+    state.ResumeTiming();
+    forest->run(false, false);
+  }
+  state.SetItemsProcessed(state.iterations() * config.num_trees);
+  state.counters["rows"] = num_rows;
+}
+BENCHMARK_CAPTURE(treeGrow, classification_gini, TREE_CLASSIFICATION, LOGRANK)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, classification_extratrees, TREE_CLASSIFICATION, EXTRATREES)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, classification_hellinger, TREE_CLASSIFICATION, HELLINGER)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, probability_gini, TREE_PROBABILITY, LOGRANK)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, probability_extratrees, TREE_PROBABILITY, EXTRATREES)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, probability_hellinger, TREE_PROBABILITY, HELLINGER)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, regression_variance, TREE_REGRESSION, LOGRANK)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, regression_maxstat, TREE_REGRESSION, MAXSTAT)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, regression_extratrees, TREE_REGRESSION, EXTRATREES)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, regression_beta, TREE_REGRESSION, BETA)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, survival_logrank, TREE_SURVIVAL, LOGRANK)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, survival_auc, TREE_SURVIVAL, AUC)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, survival_auc_ignore_ties, TREE_SURVIVAL, AUC_IGNORE_TIES)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, survival_maxstat, TREE_SURVIVAL, MAXSTAT)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(treeGrow, survival_extratrees, TREE_SURVIVAL, EXTRATREES)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Traversal of a single tree for all samples
+static void treePredict(benchmark::State& state) {
+  const BenchConfig& config = benchConfig();
+  ForestRegression forest;
+  initForest(forest, make_unique_ranger<SyntheticData>(config.num_rows, config.num_cols, TREE_REGRESSION), 1,
+      LOGRANK, false);
+  forest.run(false, false);
+  std::vector<std::vector<size_t>> child_nodeIDs = forest.getChildNodeIDs()[0];
+  std::vector<size_t> split_varIDs = forest.getSplitVarIDs()[0];
+  std::vector<double> split_values = forest.getSplitValues()[0];
+  TreeRegression tree(child_nodeIDs, split_varIDs, split_values);
+
+  SyntheticData data(config.num_rows, config.num_cols, TREE_REGRESSION, 2);
+  for (auto _ : state) {
+    tree.predict(&data, false);
+    benchmark::DoNotOptimize(tree.getPrediction(0));
+  }
+  state.SetItemsProcessed(state.iterations() * config.num_rows);
+}
+BENCHMARK(treePredict)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,54 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <numeric>
+#include <random>
+
+#include "benchmark/benchmark.h"
+#include "bench_utility.h"
+#include "utility.h"
+
+using namespace ranger_bench;
+
+static void computeConcordanceIndex(benchmark::State& state) {
+  size_t num_samples = state.range(0);
+  SyntheticData data(num_samples, 2, TREE_SURVIVAL);
+  std::vector<double> sum_chf(num_samples);
+  std::mt19937_64 random_number_generator(1);
+  std::uniform_real_distribution<double> unif_distribution(0, 1);
+  for (auto& value : sum_chf) {
+    value = unif_distribution(random_number_generator);
+  }
+  std::vector<index_t> sample_IDs(num_samples);
+  std::iota(sample_IDs.begin(), sample_IDs.end(), 0);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ranger::computeConcordanceIndex(data, sum_chf, sample_IDs, 0));
+  }
+  state.SetComplexityN(num_samples);
+}
+BENCHMARK(computeConcordanceIndex)->RangeMultiplier(4)->Range(256, 4096)->Complexity()->Unit(
+    benchmark::kMillisecond);
+
+static void drawWithoutReplacement(benchmark::State& state) {
+  size_t num_variables = state.range(0);
+  size_t mtry = std::max((size_t) 1, (size_t) sqrt(num_variables));
+  ranger::RandomGenerator random_number_generator(1);
+  std::vector<size_t> result;
+
+  for (auto _ : state) {
+    result.clear();
+    ranger::drawWithoutReplacement(result, random_number_generator, num_variables, mtry);
+    benchmark::DoNotOptimize(result.data());
+  }
+  state.SetComplexityN(num_variables);
+}
+BENCHMARK(drawWithoutReplacement)->RangeMultiplier(8)->Range(8, 4096)->Complexity();
@@ -0,0 +1,440 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "CompactForest.h"
+
+namespace ranger {
+
+// Round up to multiple of 8 bytes
+inline size_t alignOffset(size_t offset) {
+  return (offset + 7) & ~((size_t) 7);
+}
+
+// True if num_elements elements of element_size bytes starting at offset are within size bytes, without overflow
+inline bool isInFile(uint64_t offset, uint64_t num_elements, size_t element_size, size_t size) {
+  return offset <= size && num_elements <= (size - offset) / element_size;
+}
+
+CompactForest::CompactForest(std::vector<char>&& buffer) :
+    begin(0), size(0), buffer(std::move(buffer)), mapped(0), header(0), trees(0), is_ordered(0), split_masks(0) {
+  begin = this->buffer.data();
+  size = this->buffer.size();
+  init();
+}
+
+CompactForest::CompactForest(const std::string& filename) :
+    begin(0), size(0), mapped(0), header(0), trees(0), is_ordered(0), split_masks(0) {
+#ifdef _WIN32
+  // #nocov start
+  std::ifstream infile;
+  infile.open(filename, std::ios::binary | std::ios::ate);
+  if (!infile.good()) {
+    throw std::runtime_error("Could not read from input file: " + filename + ".");
+  }
+  buffer.resize(infile.tellg());
+  infile.seekg(0);
+  infile.read(buffer.data(), buffer.size());
+  begin = buffer.data();
+  size = buffer.size();
+  // #nocov end
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not read from input file: " + filename + ".");
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t) sizeof(CompactForestHeader)) {
+    close(fd);
+    throw std::runtime_error("Could not read from input file: " + filename + ".");
+  }
+  size = file_stat.st_size;
+  mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    mapped = 0;
+    throw std::runtime_error("Could not memory map forest file: " + filename + ".");
+  }
+  begin = (const char*) mapped;
+#endif
+  init();
+}
+
+CompactForest::~CompactForest() {
+#ifndef _WIN32
+  if (mapped) {
+    munmap(mapped, size);
+  }
+#endif
+}
+
+bool CompactForest::isCompactForestFile(const std::string& filename) {
+  std::ifstream infile;
+  infile.open(filename, std::ios::binary);
+  char magic[4] = { 0, 0, 0, 0 };
+  infile.read(magic, 4);
+  return infile.good() && std::memcmp(magic, COMPACT_FOREST_MAGIC, 4) == 0;
+}
+
+std::vector<std::string> CompactForest::getDependentVariableNames() const {
+  std::vector<std::string> result;
+  const char* pos = begin + header->names_offset;
+  for (size_t i = 0; i < header->num_dependent_variables; ++i) {
+    uint32_t length;
+    std::memcpy(&length, pos, sizeof(length));
+    pos += sizeof(length);
+    result.push_back(std::string(pos, length));
+    pos += length;
+  }
+  return result;
+}
+
+std::vector<bool> CompactForest::getIsOrderedVariable() const {
+  return std::vector<bool>(is_ordered, is_ordered + header->num_independent_variables);
+}
+
+std::vector<double> CompactForest::getClassValues() const {
+  const double* class_values = (const double*) (begin + header->class_values_offset);
+  return std::vector<double>(class_values, class_values + header->num_classes);
+}
+
+void CompactForest::init() {
+  header = (const CompactForestHeader*) begin;
+  if (size < sizeof(CompactForestHeader) || std::memcmp(header->magic, COMPACT_FOREST_MAGIC, 4) != 0) {
+    throw std::runtime_error("Not a version 2 forest file.");
+  }
+  if (header->version != COMPACT_FOREST_VERSION || header->file_size != size) {
+    throw std::runtime_error("Unsupported or truncated version 2 forest file.");
+  }
+
+  // All sections have to be within the file
+  if (!isInFile(header->trees_offset, header->num_trees, sizeof(CompactTreeInfo), size)
+      || !isInFile(header->is_ordered_offset, header->num_independent_variables, sizeof(uint8_t), size)
+      || !isInFile(header->split_masks_offset, header->num_split_masks, sizeof(uint64_t), size)
+      || !isInFile(header->class_values_offset, header->num_classes, sizeof(double), size)) {
+    throw std::runtime_error("Corrupt version 2 forest file.");
+  }
+  uint64_t names_end = header->names_offset;
+  for (size_t i = 0; i < header->num_dependent_variables; ++i) {
+    uint32_t length;
+    if (!isInFile(names_end, 1, sizeof(length), size)) {
+      throw std::runtime_error("Corrupt version 2 forest file.");
+    }
+    std::memcpy(&length, begin + names_end, sizeof(length));
+    names_end += sizeof(length);
+    if (!isInFile(names_end, length, sizeof(char), size)) {
+      throw std::runtime_error("Corrupt version 2 forest file.");
+    }
+    names_end += length;
+  }
+
+  trees = (const CompactTreeInfo*) (begin + header->trees_offset);
+  is_ordered = (const uint8_t*) (begin + header->is_ordered_offset);
+  split_masks = (const uint64_t*) (begin + header->split_masks_offset);
+
+  // Pointers into the buffer, no data is copied
+  tree_nodes.reserve(header->num_trees);
+  tree_leaves.reserve(header->num_trees);
+  for (size_t i = 0; i < header->num_trees; ++i) {
+    if (!isInFile(trees[i].nodes_offset, trees[i].num_nodes, sizeof(CompactNode), size)
+        || !isInFile(trees[i].leaves_offset, (uint64_t) trees[i].num_leaves * header->leaf_width, sizeof(float),
+            size)) {
+      throw std::runtime_error("Corrupt version 2 forest file.");
+    }
+    tree_nodes.push_back((const CompactNode*) (begin + trees[i].nodes_offset));
+    tree_leaves.push_back((const float*) (begin + trees[i].leaves_offset));
+    if (isQuantized()) {
+      if (!isInFile(trees[i].quantized_nodes_offset, trees[i].num_nodes, sizeof(CompactNodeQuantized), size)) {
+        throw std::runtime_error("Corrupt version 2 forest file.");
+      }
+      tree_nodes_quantized.push_back((const CompactNodeQuantized*) (begin + trees[i].quantized_nodes_offset));
+    }
+    if (header->flags & COMPACT_FOREST_DOUBLE_SPLITS) {
+      if (!isInFile(trees[i].split_values_offset, trees[i].num_nodes, sizeof(double), size)) {
+        throw std::runtime_error("Corrupt version 2 forest file.");
+      }
+      tree_split_values.push_back((const double*) (begin + trees[i].split_values_offset));
+    }
+  }
+}
+
+void CompactForest::predictTerminalNodes(const Data* data, size_t sample_idx, std::vector<index_t>& terminal_nodeIDs,
+    std::vector<uint8_t>& sample_values) const {
+  size_t num_trees = header->num_trees;
+  terminal_nodeIDs.resize(num_trees);
+
+  // Fetch all values once as 8 bit integers, fall back to float thresholds if not possible
+  if (isQuantized()) {
+    size_t num_variables = header->num_independent_variables;
+    sample_values.resize(num_variables);
+    bool quantized = true;
+    for (size_t varID = 0; varID < num_variables; ++varID) {
+      double value = data->get_x(sample_idx, varID);
+      if (!(value >= 0 && value <= 255) || value != floor(value)) {
+        quantized = false;
+        break;
+      }
+      sample_values[varID] = value;
+    }
+    if (quantized) {
+      if (num_trees >= 4) {
+        predictTerminalNodesQuantized(sample_values.data(), terminal_nodeIDs.data());
+      } else {
+        for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+          terminal_nodeIDs[tree_idx] = predictTerminalNodeQuantized(tree_idx, sample_values.data());
+        }
+      }
+      return;
+    }
+  }
+
+  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+    terminal_nodeIDs[tree_idx] = predictTerminalNode(tree_idx, data, sample_idx);
+  }
+}
+
+void CompactForest::predictTerminalNodesQuantized(const uint8_t* sample_values, index_t* terminal_nodeIDs) const {
+  size_t num_trees = header->num_trees;
+
+  // Each of 4 lanes traverses a tree, so 4 independent node loads and comparisons are in flight in each step. A lane
+  // that reaches a terminal node continues with the next tree, the last trees are finished one by one. The
+  // comparisons stay in core registers, moving the nodeIDs to NEON registers and back costs more than they save.
+  size_t lane_trees[4];
+  const CompactNodeQuantized* lane_nodes[4];
+  size_t nodeIDs[4] = { 0, 0, 0, 0 };
+  size_t next_tree_idx = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    lane_trees[i] = next_tree_idx;
+    lane_nodes[i] = tree_nodes_quantized[next_tree_idx++];
+  }
+
+  while (true) {
+    for (size_t i = 0; i < 4; ++i) {
+      while (lane_nodes[i][nodeIDs[i]].left_child == 0) {
+        terminal_nodeIDs[lane_trees[i]] = nodeIDs[i];
+        if (next_tree_idx == num_trees) {
+          for (size_t j = 0; j < 4; ++j) {
+            if (j != i) {
+              terminal_nodeIDs[lane_trees[j]] = predictTerminalNodeQuantized(lane_trees[j], sample_values, nodeIDs[j]);
+            }
+          }
+          return;
+        }
+        lane_trees[i] = next_tree_idx;
+        lane_nodes[i] = tree_nodes_quantized[next_tree_idx++];
+        nodeIDs[i] = 0;
+      }
+      const CompactNodeQuantized& node = lane_nodes[i][nodeIDs[i]];
+      nodeIDs[i] = node.left_child + (sample_values[node.varID] > node.split_value);
+    }
+  }
+}
+
+CompactForestBuilder::CompactForestBuilder(TreeType treetype, size_t num_independent_variables,
+    const std::vector<std::string>& dependent_variable_names, const std::vector<bool>& is_ordered_variable,
+    const std::vector<double>& class_values, size_t leaf_width) :
+    treetype(treetype), num_independent_variables(num_independent_variables), dependent_variable_names(
+        dependent_variable_names), is_ordered_variable(is_ordered_variable), class_values(class_values), leaf_width(
+        leaf_width), double_splits(false) {
+}
+
+void CompactForestBuilder::addTree(const std::vector<std::vector<index_t>>& child_nodeIDs,
+    const std::vector<index_t>& split_varIDs, const std::vector<double>& split_values,
+    const std::vector<float>& leaf_values) {
+
+  size_t num_nodes = split_varIDs.size();
+  std::vector<CompactNode> nodes(num_nodes);
+  size_t num_leaves = 0;
+  for (size_t i = 0; i < num_nodes; ++i) {
+    CompactNode& node = nodes[i];
+    if (child_nodeIDs[0][i] == 0 && child_nodeIDs[1][i] == 0) {
+      // Terminal node
+      node.left_child = 0;
+      node.varID = num_leaves++;
+      node.split_value = 0;
+    } else {
+      if (child_nodeIDs[1][i] != child_nodeIDs[0][i] + 1) {
+        throw std::runtime_error("Tree cannot be saved in version 2 format, right child not next to left child.");
+      }
+      node.left_child = child_nodeIDs[0][i];
+      node.varID = split_varIDs[i];
+      if (is_ordered_variable[split_varIDs[i]]) {
+        // Round down, so that value <= split_value is unchanged for all float values. Otherwise the double split
+        // values are saved as well.
+        float split_value = split_values[i];
+        if (split_value > split_values[i]) {
+          split_value = std::nextafter(split_value, -std::numeric_limits<float>::infinity());
+        }
+        node.split_value = split_value;
+        double_splits |= split_value != split_values[i];
+      } else {
+        node.split_mask = split_masks.size();
+        split_masks.push_back(floor(split_values[i]));
+      }
+    }
+  }
+
+  if (leaf_values.size() != num_leaves * leaf_width) {
+    throw std::runtime_error("Number of leaf values does not match number of terminal nodes.");
+  }
+
+  tree_nodes.push_back(nodes);
+  tree_leaves.push_back(leaf_values);
+  tree_split_values.push_back(split_values);
+}
+
+bool CompactForestBuilder::quantize(const std::vector<bool>& is_uint8_variable) {
+  if (num_independent_variables > 65536) {
+    return false;
+  }
+
+  std::vector<std::vector<CompactNodeQuantized>> quantized(tree_nodes.size());
+  for (size_t i = 0; i < tree_nodes.size(); ++i) {
+    quantized[i].resize(tree_nodes[i].size());
+    for (size_t j = 0; j < tree_nodes[i].size(); ++j) {
+      const CompactNode& node = tree_nodes[i][j];
+      CompactNodeQuantized& node_quantized = quantized[i][j];
+      node_quantized.left_child = node.left_child;
+      node_quantized.varID = 0;
+      node_quantized.split_value = 0;
+      node_quantized.unused = 0;
+      if (node.left_child != 0) {
+        if (!is_ordered_variable[node.varID] || !is_uint8_variable[node.varID] || node.split_value < 0) {
+          return false;
+        }
+        // For integer x: x <= t is equivalent to x <= floor(t)
+        node_quantized.varID = node.varID;
+        node_quantized.split_value = std::min(std::floor(node.split_value), 255.0f);
+      }
+    }
+  }
+
+  tree_nodes_quantized.swap(quantized);
+  return true;
+}
+
+std::vector<char> CompactForestBuilder::finish() {
+
+  size_t num_trees = tree_nodes.size();
+
+  // Compute layout
+  CompactForestHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, COMPACT_FOREST_MAGIC, 4);
+  header.version = COMPACT_FOREST_VERSION;
+  header.treetype = treetype;
+  header.num_trees = num_trees;
+  header.num_independent_variables = num_independent_variables;
+  header.num_dependent_variables = dependent_variable_names.size();
+  header.num_classes = class_values.size();
+  header.leaf_width = leaf_width;
+  header.num_split_masks = split_masks.size();
+  if (!tree_nodes_quantized.empty()) {
+    header.flags |= COMPACT_FOREST_QUANTIZED;
+  }
+  if (double_splits) {
+    header.flags |= COMPACT_FOREST_DOUBLE_SPLITS;
+  }
+
+  size_t offset = alignOffset(sizeof(CompactForestHeader));
+  header.names_offset = offset;
+  for (auto& name : dependent_variable_names) {
+    offset += sizeof(uint32_t) + name.size();
+  }
+  offset = alignOffset(offset);
+  header.is_ordered_offset = offset;
+  offset = alignOffset(offset + num_independent_variables);
+  header.class_values_offset = offset;
+  offset += class_values.size() * sizeof(double);
+  header.split_masks_offset = offset;
+  offset += split_masks.size() * sizeof(uint64_t);
+  header.trees_offset = offset;
+  offset += num_trees * sizeof(CompactTreeInfo);
+
+  std::vector<CompactTreeInfo> tree_infos(num_trees);
+  for (size_t i = 0; i < num_trees; ++i) {
+    tree_infos[i].num_nodes = tree_nodes[i].size();
+    tree_infos[i].num_leaves = tree_leaves[i].size() / (leaf_width > 0 ? leaf_width : 1);
+    tree_infos[i].nodes_offset = offset;
+    offset = alignOffset(offset + tree_nodes[i].size() * sizeof(CompactNode));
+    tree_infos[i].leaves_offset = offset;
+    offset = alignOffset(offset + tree_leaves[i].size() * sizeof(float));
+    if (!tree_nodes_quantized.empty()) {
+      tree_infos[i].quantized_nodes_offset = offset;
+      offset = alignOffset(offset + tree_nodes_quantized[i].size() * sizeof(CompactNodeQuantized));
+    } else {
+      tree_infos[i].quantized_nodes_offset = 0;
+    }
+    if (double_splits) {
+      tree_infos[i].split_values_offset = offset;
+      offset = alignOffset(offset + tree_split_values[i].size() * sizeof(double));
+    } else {
+      tree_infos[i].split_values_offset = 0;
+    }
+  }
+  header.file_size = offset;
+
+  // Write to buffer
+  std::vector<char> buffer(offset, 0);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+  char* pos = buffer.data() + header.names_offset;
+  for (auto& name : dependent_variable_names) {
+    uint32_t length = name.size();
+    std::memcpy(pos, &length, sizeof(length));
+    pos += sizeof(length);
+    std::memcpy(pos, name.data(), length);
+    pos += length;
+  }
+  for (size_t i = 0; i < num_independent_variables; ++i) {
+    buffer[header.is_ordered_offset + i] = is_ordered_variable[i];
+  }
+  if (!class_values.empty()) {
+    std::memcpy(buffer.data() + header.class_values_offset, class_values.data(), class_values.size() * sizeof(double));
+  }
+  if (!split_masks.empty()) {
+    std::memcpy(buffer.data() + header.split_masks_offset, split_masks.data(), split_masks.size() * sizeof(uint64_t));
+  }
+  if (num_trees > 0) {
+    std::memcpy(buffer.data() + header.trees_offset, tree_infos.data(), num_trees * sizeof(CompactTreeInfo));
+  }
+  for (size_t i = 0; i < num_trees; ++i) {
+    std::memcpy(buffer.data() + tree_infos[i].nodes_offset, tree_nodes[i].data(),
+        tree_nodes[i].size() * sizeof(CompactNode));
+    if (!tree_leaves[i].empty()) {
+      std::memcpy(buffer.data() + tree_infos[i].leaves_offset, tree_leaves[i].data(),
+          tree_leaves[i].size() * sizeof(float));
+    }
+    if (!tree_nodes_quantized.empty()) {
+      std::memcpy(buffer.data() + tree_infos[i].quantized_nodes_offset, tree_nodes_quantized[i].data(),
+          tree_nodes_quantized[i].size() * sizeof(CompactNodeQuantized));
+    }
+    if (double_splits && !tree_split_values[i].empty()) {
+      std::memcpy(buffer.data() + tree_infos[i].split_values_offset, tree_split_values[i].data(),
+          tree_split_values[i].size() * sizeof(double));
+    }
+  }
+
+  return buffer;
+}
+
+} // namespace ranger
@@ -0,0 +1,238 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef COMPACTFOREST_H_
+#define COMPACTFOREST_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+
+#include "globals.h"
+#include "Data.h"
+
+namespace ranger {
+
+// Version 2 forest file format. The file is a header followed by a per-tree offset table and flat node and
+// leaf arrays, all 8 byte aligned and in native byte order. It is memory mapped and traversed in place.
+const char COMPACT_FOREST_MAGIC[4] = { 'R', 'G', 'F', '2' };
+// Revision of the layout, 3 added the double split values
+const uint32_t COMPACT_FOREST_VERSION = 3;
+
+// Header flags
+const uint32_t COMPACT_FOREST_QUANTIZED = 1;
+const uint32_t COMPACT_FOREST_DOUBLE_SPLITS = 2;
+
+struct CompactForestHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t treetype;
+  uint32_t num_trees;
+  uint32_t num_independent_variables;
+  uint32_t num_dependent_variables;
+  uint32_t num_classes;
+  uint32_t leaf_width;
+  uint32_t num_split_masks;
+  uint32_t flags;
+  uint64_t names_offset;        // Dependent variable names, uint32_t length and chars for each
+  uint64_t is_ordered_offset;   // uint8_t for each independent variable
+  uint64_t class_values_offset; // double for each class
+  uint64_t split_masks_offset;  // uint64_t factor bitmask for each unordered split
+  uint64_t trees_offset;        // CompactTreeInfo for each tree
+  uint64_t file_size;
+};
+
+struct CompactTreeInfo {
+  uint64_t nodes_offset;
+  uint64_t leaves_offset;
+  uint64_t quantized_nodes_offset; // Only used with COMPACT_FOREST_QUANTIZED
+  uint64_t split_values_offset;    // Only used with COMPACT_FOREST_DOUBLE_SPLITS, double for each node
+  uint32_t num_nodes;
+  uint32_t num_leaves;
+};
+
+// Nodes are stored in the order of the original tree, so the node index is the terminal nodeID.
+// The right child always directly follows the left child.
+struct CompactNode {
+  uint32_t left_child;   // 0 for terminal nodes
+  uint32_t varID;        // Split variable, index of the leaf values for terminal nodes
+  union {
+    float split_value;   // Ordered variables: Largest float not greater than the double split value, which is
+                         // stored separately if it is not a float for any node of the forest
+    uint32_t split_mask; // Unordered variables: Index in split mask table
+  };
+};
+
+// Node for forests where all split variables are integers in 0..255, in the same order as CompactNode.
+// Leaf values are found with the CompactNode of the same index.
+struct CompactNodeQuantized {
+  uint32_t left_child;
+  uint16_t varID;
+  uint8_t split_value;   // value <= split_value for all integer values, equal to the original comparison
+  uint8_t unused;
+};
+
+class CompactForest {
+public:
+  // Use buffer created with CompactForestBuilder
+  CompactForest(std::vector<char>&& buffer);
+
+  // Memory map file
+  CompactForest(const std::string& filename);
+
+  CompactForest(const CompactForest&) = delete;
+  CompactForest& operator=(const CompactForest&) = delete;
+
+  ~CompactForest();
+
+  static bool isCompactForestFile(const std::string& filename);
+
+  // Terminal nodeIDs of all trees for a sample. Uses the 8 bit nodes if available and the sample values allow it,
+  // sample_values is a buffer for the 8 bit values.
+  void predictTerminalNodes(const Data* data, size_t sample_idx, std::vector<index_t>& terminal_nodeIDs,
+      std::vector<uint8_t>& sample_values) const;
+
+  // Traverse from nodeID down to the terminal node
+  size_t predictTerminalNode(size_t tree_idx, const Data* data, size_t sample_idx, size_t nodeID = 0) const {
+    const CompactNode* nodes = tree_nodes[tree_idx];
+    const double* split_values = getSplitValues(tree_idx);
+    while (nodes[nodeID].left_child != 0) {
+      const CompactNode& node = nodes[nodeID];
+      double value = data->get_x(sample_idx, node.varID);
+      if (is_ordered[node.varID]) {
+        // Left is <= splitval (NaN goes right), the float threshold is only exact for float data
+        double split_value = split_values ? split_values[nodeID] : node.split_value;
+        nodeID = node.left_child + !(value <= split_value);
+      } else {
+        size_t factorID = floor(value) - 1;
+        nodeID = node.left_child + ((split_masks[node.split_mask] & (1ULL << factorID)) != 0);
+      }
+    }
+    return nodeID;
+  }
+
+  size_t predictTerminalNodeQuantized(size_t tree_idx, const uint8_t* sample_values, size_t nodeID = 0) const {
+    const CompactNodeQuantized* nodes = tree_nodes_quantized[tree_idx];
+    while (nodes[nodeID].left_child != 0) {
+      const CompactNodeQuantized& node = nodes[nodeID];
+      nodeID = node.left_child + (sample_values[node.varID] > node.split_value);
+    }
+    return nodeID;
+  }
+
+  // Terminal nodeIDs of all trees with the 8 bit nodes, traversing 4 trees at once. At least 4 trees.
+  void predictTerminalNodesQuantized(const uint8_t* sample_values, index_t* terminal_nodeIDs) const;
+
+  const float* getLeafValues(size_t tree_idx, size_t nodeID) const {
+    return tree_leaves[tree_idx] + (size_t) tree_nodes[tree_idx][nodeID].varID * header->leaf_width;
+  }
+
+  const CompactNode* getNodes(size_t tree_idx) const {
+    return tree_nodes[tree_idx];
+  }
+
+  // Exact split values of all nodes, nullptr if all ordered split values are floats
+  const double* getSplitValues(size_t tree_idx) const {
+    return tree_split_values.empty() ? nullptr : tree_split_values[tree_idx];
+  }
+  size_t getNumNodes(size_t tree_idx) const {
+    return trees[tree_idx].num_nodes;
+  }
+  size_t getNumLeaves(size_t tree_idx) const {
+    return trees[tree_idx].num_leaves;
+  }
+  uint64_t getSplitMask(uint32_t split_mask) const {
+    return split_masks[split_mask];
+  }
+  bool isOrderedVariable(size_t varID) const {
+    return is_ordered[varID];
+  }
+
+  TreeType getTreeType() const {
+    return (TreeType) header->treetype;
+  }
+  size_t getNumTrees() const {
+    return header->num_trees;
+  }
+  size_t getNumIndependentVariables() const {
+    return header->num_independent_variables;
+  }
+  size_t getLeafWidth() const {
+    return header->leaf_width;
+  }
+  bool isQuantized() const {
+    return header->flags & COMPACT_FOREST_QUANTIZED;
+  }
+
+  std::vector<std::string> getDependentVariableNames() const;
+  std::vector<bool> getIsOrderedVariable() const;
+  std::vector<double> getClassValues() const;
+
+private:
+  void init();
+
+  const char* begin;
+  size_t size;
+
+  // Owned buffer if not memory mapped
+  std::vector<char> buffer;
+  void* mapped;
+
+  const CompactForestHeader* header;
+  const CompactTreeInfo* trees;
+  const uint8_t* is_ordered;
+  const uint64_t* split_masks;
+  std::vector<const CompactNode*> tree_nodes;
+  std::vector<const float*> tree_leaves;
+  std::vector<const CompactNodeQuantized*> tree_nodes_quantized;
+  std::vector<const double*> tree_split_values;
+};
+
+class CompactForestBuilder {
+public:
+  CompactForestBuilder(TreeType treetype, size_t num_independent_variables,
+      const std::vector<std::string>& dependent_variable_names, const std::vector<bool>& is_ordered_variable,
+      const std::vector<double>& class_values, size_t leaf_width);
+
+  CompactForestBuilder(const CompactForestBuilder&) = delete;
+  CompactForestBuilder& operator=(const CompactForestBuilder&) = delete;
+
+  // Leaf values are leaf_width values for each terminal node, in node order
+  void addTree(const std::vector<std::vector<index_t>>& child_nodeIDs, const std::vector<index_t>& split_varIDs,
+      const std::vector<double>& split_values, const std::vector<float>& leaf_values);
+
+  // Rewrite thresholds to 8 bit if all split variables are integers in 0..255. Returns false if not possible.
+  bool quantize(const std::vector<bool>& is_uint8_variable);
+
+  std::vector<char> finish();
+
+private:
+  TreeType treetype;
+  size_t num_independent_variables;
+  std::vector<std::string> dependent_variable_names;
+  std::vector<bool> is_ordered_variable;
+  std::vector<double> class_values;
+  size_t leaf_width;
+
+  std::vector<uint64_t> split_masks;
+  std::vector<std::vector<CompactNode>> tree_nodes;
+  std::vector<std::vector<float>> tree_leaves;
+  std::vector<std::vector<CompactNodeQuantized>> tree_nodes_quantized;
+
+  // Split values of all nodes, saved only if an ordered split value is not a float
+  std::vector<std::vector<double>> tree_split_values;
+  bool double_splits;
+};
+
+} // namespace ranger
+
+#endif /* COMPACTFOREST_H_ */
@@ -15,26 +15,34 @@
 #include <string>
 #include <ctime>
 #include <functional>
+#include <limits>
 #ifndef OLD_WIN_R_BUILD
 #include <thread>
 #include <chrono>
 #endif
 
 #include "utility.h"
+#include "version.h"
 #include "Forest.h"
 #include "DataChar.h"
 #include "DataDouble.h"
 #include "DataFloat.h"
 #include "DataInt.h"
+#include "DataUint8.h"
+#include "DataHalf.h"
+#include "DataAdaptive.h"
+#include "DataMapped.h"
+#include "DataRowMajor.h"
 
 namespace ranger {
 
 Forest::Forest() :
     verbose_out(0), num_trees(DEFAULT_NUM_TREE), mtry(0), min_node_size(0), num_independent_variables(0), seed(0), num_samples(
         0), prediction_mode(false), memory_mode(MEM_INT), sample_with_replacement(true), memory_saving_splitting(
-        false), splitrule(DEFAULT_SPLITRULE), predict_all(false), keep_inbag(false), sample_fraction( { 1 }), holdout(
+        false), level_wise_growth(false), splitrule(DEFAULT_SPLITRULE), predict_all(false), keep_inbag(false), sample_fraction( { 1 }), holdout(
         false), prediction_type(DEFAULT_PREDICTIONTYPE), num_random_splits(DEFAULT_NUM_RANDOM_SPLITS), max_depth(
-        DEFAULT_MAXDEPTH), alpha(DEFAULT_ALPHA), minprop(DEFAULT_MINPROP), num_threads(DEFAULT_NUM_THREADS), data { }, kernelsize(3), overall_prediction_error(
+        DEFAULT_MAXDEPTH), alpha(DEFAULT_ALPHA), minprop(DEFAULT_MINPROP), num_threads(DEFAULT_NUM_THREADS), data { }, prediction_backend(
+        DEFAULT_PREDICTION_BACKEND), fixed_point_prediction(false), check_fixed_point_deviation(false), kernelsize(3), overall_prediction_error(
     NAN), importance_mode(DEFAULT_IMPORTANCE_MODE), regularization_usedepth(false),  progress(0) {
 }
 
@@ -80,6 +88,11 @@ void Forest::initCpp(std::string dependent_variable_name, MemoryMode memory_mode
     prediction_mode = true;
   }
 
+  // The index data of the sorted mode would be held in memory
+  if (!out_of_core_file.empty()) {
+    memory_saving_splitting = true;
+  }
+
   // Sample fraction default and convert to vector
   if (sample_fraction == 0) {
     if (sample_with_replacement) {
@@ -95,12 +108,18 @@ void Forest::initCpp(std::string dependent_variable_name, MemoryMode memory_mode
   }
   //std::cout<<"about to call other init fn"<<std::endl;
   // Call other init function
-  init(loadDataFromFile(input_file, evaluation_file, batch_data, kernelsize), mtry, output_prefix, num_trees, seed, num_threads, importance_mode,
+  std::unique_ptr<Data> input_data;
+  {
+    PhaseTimer timer(run_stats.get(), PHASE_LOAD);
+    input_data = loadDataFromFile(input_file, evaluation_file, batch_data, kernelsize, prediction_mode);
+  }
+  init(std::move(input_data), mtry, output_prefix, num_trees, seed, num_threads, importance_mode,
       min_node_size, prediction_mode, sample_with_replacement, unordered_variable_names, memory_saving_splitting,
       splitrule, predict_all, sample_fraction_vector, alpha, minprop, holdout, prediction_type, num_random_splits,
       false, max_depth, regularization_factor, regularization_usedepth);
   //std::cout<<"called other init fn"<<std::endl;
   if (prediction_mode) {
+    PhaseTimer timer(run_stats.get(), PHASE_LOAD);
     loadFromFile(load_forest_filename);
   }
   // Set variables to be always considered for splitting
@@ -272,9 +291,17 @@ void Forest::init(std::unique_ptr<Data> input_data, uint mtry, std::string outpu
     throw std::runtime_error("sample_fraction too small, no observations sampled.");
   }
 
-  // Permute samples for corrected Gini importance
+  // Check if sample and node IDs fit in index type (up to 2 nodes per sample, 2 variables per column with corrected importance)
+  if (std::max(num_samples, num_independent_variables) > std::numeric_limits<index_t>::max() / 2) {
+    throw std::runtime_error("Too many samples or variables for 32 bit indices. Compile with RANGER_64BIT_INDEX.");
+  }
+
+  // Permute samples for corrected Gini importance, copy the permuted data unless saving memory
   if (importance_mode == IMP_GINI_CORRECTED) {
     data->permuteSampleIDs(random_number_generator);
+    if (!memory_saving_splitting) {
+      data->materializeShadowColumns(num_threads);
+    }
   }
 
   // Order SNP levels if in "order" splitting
@@ -292,26 +319,35 @@ void Forest::init(std::unique_ptr<Data> input_data, uint mtry, std::string outpu
     }
 
     // Set all variables to not used
-    split_varIDs_used.resize(num_independent_variables, false);
+    regularization_state.init(num_independent_variables, num_trees, REGULARIZATION_TREE_LAG);
   }
 }
 
+void Forest::enableRunStats() {
+  run_stats = make_unique_ranger<RunStats>();
+}
+
 void Forest::run(bool verbose, bool compute_oob_error) {
   if (prediction_mode) {
     if (verbose && verbose_out) {
       *verbose_out << "Predicting .." << std::endl;
     }
+    PhaseTimer timer(run_stats.get(), PHASE_PREDICT);
     predict();
   } else {
     if (verbose && verbose_out) {
       *verbose_out << "Growing trees .." << std::endl;
     }
-    grow();
+    {
+      PhaseTimer timer(run_stats.get(), PHASE_GROW);
+      grow();
+    }
     if (verbose && verbose_out) {
       *verbose_out << "Computing prediction error .." << std::endl;
     }
 
     if (compute_oob_error) {
+      PhaseTimer timer(run_stats.get(), PHASE_OOB);
       computePredictionError();
     }
 
@@ -320,13 +356,73 @@ void Forest::run(bool verbose, bool compute_oob_error) {
       if (verbose && verbose_out) {
         *verbose_out << "Computing permutation variable importance .." << std::endl;
       }
+      PhaseTimer timer(run_stats.get(), PHASE_IMPORTANCE);
       computePermutationImportance();
     }
   }
 }
 
+void Forest::predictFile(const std::string& input_file, const std::string& output_prefix) {
+  if (!prediction_mode) {
+    throw std::runtime_error("Predicting new samples requires a forest loaded for prediction.");
+  }
+  std::string extension = input_file.substr(input_file.find_last_of(".") + 1);
+  bool image_input = (extension == "jpeg" || extension == "png");
+  if (write_to_img && !image_input) {
+    throw std::runtime_error("Writing to an image requires an image input.");
+  }
+
+  std::unique_ptr<Data> prediction_data;
+  {
+    PhaseTimer timer(run_stats.get(), PHASE_LOAD);
+    prediction_data = loadDataFromFile(input_file, "", false, kernelsize, true);
+  }
+  if (image_input) {
+    std::tuple<size_t, size_t, size_t> dims = prediction_data->getImgDims(input_file);
+    img_width = std::get<0>(dims);
+    img_height = std::get<1>(dims);
+  }
+  this->output_prefix = output_prefix;
+  setPredictionData(std::move(prediction_data));
+
+  PhaseTimer timer(run_stats.get(), PHASE_PREDICT);
+  predict();
+}
+
+void Forest::predictValues(const std::vector<double>& values, size_t num_rows) {
+  if (!prediction_mode) {
+    throw std::runtime_error("Predicting new samples requires a forest loaded for prediction.");
+  }
+  std::unique_ptr<Data> prediction_data = createData(true);
+  bool found_rounding_error = prediction_data->loadFromValues(data->getVariableNames(), values, num_rows);
+  prediction_data->packColumns();
+  if (found_rounding_error && verbose_out) {
+    *verbose_out << "Warning: Rounding or Integer overflow occurred. Use FLOAT or DOUBLE precision to avoid this."
+        << std::endl;
+  }
+  setPredictionData(std::move(prediction_data));
+
+  PhaseTimer timer(run_stats.get(), PHASE_PREDICT);
+  predict();
+}
+
+void Forest::setPredictionData(std::unique_ptr<Data> prediction_data) {
+  if (prediction_data->getNumCols() != num_independent_variables) {
+    throw std::runtime_error("Number of independent variables in data does not match with the loaded forest.");
+  }
+  if (prediction_data->getNumRows() == 0) {
+    throw std::runtime_error("No samples to predict.");
+  }
+
+  // Variable types are stored with the forest, keep them
+  prediction_data->getIsOrderedVariable() = data->getIsOrderedVariable();
+  data = std::move(prediction_data);
+  num_samples = data->getNumRows();
+}
+
 // #nocov start
 void Forest::writeOutput() {
+  PhaseTimer timer(run_stats.get(), PHASE_WRITE);
 
   if (verbose_out)
     *verbose_out << std::endl;
@@ -375,6 +471,22 @@ void Forest::writeOutput() {
   }
 }
 
+void Forest::writePredictionFile() {
+
+  // Open prediction file for writing
+  std::string filename = output_prefix + ".prediction";
+  std::ofstream outfile;
+  outfile.open(filename, std::ios::out);
+  if (!outfile.good()) {
+    throw std::runtime_error("Could not write to prediction file: " + filename + ".");
+  }
+
+  writePredictions(outfile);
+
+  if (verbose_out)
+    *verbose_out << "Saved predictions to file " << filename << "." << std::endl;
+}
+
 void Forest::writeImportanceFile() {
 
   // Open importance file for writing
@@ -416,6 +528,7 @@ void Forest::writeImportanceFile() {
 }
 
 void Forest::saveToFile() {
+  PhaseTimer timer(run_stats.get(), PHASE_WRITE);
 
   // Open file for writing
   std::string filename = output_prefix + ".forest";
@@ -456,6 +569,206 @@ void Forest::saveToFile() {
   if (verbose_out)
     *verbose_out << "Saved forest to file " << filename << "." << std::endl;
 }
+
+void Forest::saveToCompactFile(bool quantize) {
+  PhaseTimer timer(run_stats.get(), PHASE_WRITE);
+
+  // Open file for writing
+  std::string filename = output_prefix + ".forest";
+  std::ofstream outfile;
+  outfile.open(filename, std::ios::binary);
+  if (!outfile.good()) {
+    throw std::runtime_error("Could not write to output file: " + filename + ".");
+  }
+
+  std::vector<char> buffer = buildCompactForest(quantize);
+  outfile.write(buffer.data(), buffer.size());
+
+  // Close file
+  outfile.close();
+  if (verbose_out)
+    *verbose_out << "Saved forest to file " << filename << " (version 2)." << std::endl;
+}
+
+std::vector<char> Forest::buildCompactForest(bool quantize) {
+  std::unique_ptr<CompactForestBuilder> builder = createCompactForestBuilder();
+  for (size_t tree_idx = 0; tree_idx < trees.size(); ++tree_idx) {
+    const std::vector<std::vector<index_t>>& child_nodeIDs = trees[tree_idx]->getChildNodeIDs();
+    std::vector<double> leaf_values;
+    for (size_t nodeID = 0; nodeID < child_nodeIDs[0].size(); ++nodeID) {
+      if (child_nodeIDs[0][nodeID] == 0 && child_nodeIDs[1][nodeID] == 0) {
+        appendLeafValues(tree_idx, nodeID, leaf_values);
+      }
+    }
+    builder->addTree(child_nodeIDs, trees[tree_idx]->getSplitVarIDs(), trees[tree_idx]->getSplitValues(),
+        std::vector<float>(leaf_values.begin(), leaf_values.end()));
+  }
+
+  if (quantize) {
+    std::vector<bool> is_uint8_variable(num_independent_variables);
+    for (size_t varID = 0; varID < num_independent_variables; ++varID) {
+      is_uint8_variable[varID] = data->isUint8Variable(varID);
+    }
+    if (builder->quantize(is_uint8_variable)) {
+      if (verbose_out)
+        *verbose_out << "Saving 8 bit thresholds." << std::endl;
+    } else {
+      if (verbose_out)
+        *verbose_out << "Warning: Split variables are not all integers in 0..255, 8 bit thresholds not saved." << std::endl;
+    }
+  }
+
+  return builder->finish();
+}
+
+void Forest::exportToCpp() {
+  if (trees.empty()) {
+    throw std::runtime_error("Forests loaded from version 2 files cannot be exported to C++.");
+  }
+  PhaseTimer timer(run_stats.get(), PHASE_WRITE);
+
+  // Open file for writing
+  std::string filename = output_prefix + ".cpp";
+  std::ofstream outfile;
+  outfile.open(filename);
+  if (!outfile.good()) {
+    throw std::runtime_error("Could not write to output file: " + filename + ".");
+  }
+
+  outfile << "// Random forest exported by ranger " << RANGER_VERSION << " with " << num_trees << " trees." << std::endl;
+  outfile << "// Predictions are identical to ranger. Compile with -DRANGER_FOREST_MAIN for a command line" << std::endl;
+  outfile << "// predictor reading one sample per line from stdin." << std::endl << std::endl;
+  outfile << "#include <cmath>" << std::endl;
+  outfile << "#include <cstddef>" << std::endl;
+  outfile << "#ifdef RANGER_FOREST_MAIN" << std::endl;
+  outfile << "#include <cstdio>" << std::endl;
+  outfile << "#endif" << std::endl << std::endl;
+  outfile << "namespace ranger_forest {" << std::endl << std::endl;
+
+  // Leaf values of all terminal nodes, width is the same for all leaves
+  size_t num_outputs = 0;
+  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+    const std::vector<std::vector<index_t>>& child_nodeIDs = trees[tree_idx]->getChildNodeIDs();
+    std::vector<size_t> leaf_offsets(child_nodeIDs[0].size(), 0);
+    std::vector<double> leaf_values;
+    for (size_t nodeID = 0; nodeID < child_nodeIDs[0].size(); ++nodeID) {
+      if (child_nodeIDs[0][nodeID] == 0 && child_nodeIDs[1][nodeID] == 0) {
+        leaf_offsets[nodeID] = leaf_values.size();
+        appendLeafValues(tree_idx, nodeID, leaf_values);
+        if (num_outputs == 0) {
+          num_outputs = leaf_values.size();
+        }
+      }
+    }
+    outfile << "static const double leaf_values_" << tree_idx << "[] = { ";
+    for (size_t i = 0; i < leaf_values.size(); ++i) {
+      outfile << (i > 0 ? ", " : "") << doubleToString(leaf_values[i]);
+    }
+    outfile << " };" << std::endl << std::endl;
+
+    // One label for each node, no nesting limits for deep trees
+    const std::vector<index_t>& split_varIDs = trees[tree_idx]->getSplitVarIDs();
+    const std::vector<double>& split_values = trees[tree_idx]->getSplitValues();
+    outfile << "static const double* tree_" << tree_idx << "(const double* x) {" << std::endl;
+    for (size_t nodeID = 0; nodeID < child_nodeIDs[0].size(); ++nodeID) {
+      if (nodeID > 0) {
+        outfile << "n" << nodeID << ": ";
+      } else {
+        outfile << "  ";
+      }
+      size_t left_child = child_nodeIDs[0][nodeID];
+      size_t right_child = child_nodeIDs[1][nodeID];
+      if (left_child == 0 && right_child == 0) {
+        outfile << "return leaf_values_" << tree_idx << " + " << leaf_offsets[nodeID] << ";" << std::endl;
+        continue;
+      }
+
+      // Same comparisons as Tree::predict()
+      size_t varID = split_varIDs[nodeID];
+      if (data->isOrderedVariable(varID)) {
+        outfile << "if (x[" << varID << "] <= " << doubleToString(split_values[nodeID]) << ")";
+      } else {
+        size_t splitID = floor(split_values[nodeID]);
+        outfile << "if (!(" << splitID << "ULL & (1ULL << (size_t) (floor(x[" << varID << "]) - 1))))";
+      }
+      outfile << " goto n" << left_child << "; else goto n" << right_child << ";" << std::endl;
+    }
+    outfile << "}" << std::endl << std::endl;
+  }
+
+  outfile << "typedef const double* (*TreeFunction)(const double*);" << std::endl;
+  outfile << "static const TreeFunction trees[] = { ";
+  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+    outfile << (tree_idx > 0 ? ", " : "") << "tree_" << tree_idx;
+  }
+  outfile << " };" << std::endl << std::endl;
+
+  outfile << "const size_t num_trees = " << num_trees << ";" << std::endl;
+  outfile << "const size_t num_independent_variables = " << num_independent_variables << ";" << std::endl;
+  outfile << "const char* const variable_names[] = { ";
+  for (size_t varID = 0; varID < num_independent_variables; ++varID) {
+    outfile << (varID > 0 ? ", " : "") << cppStringLiteral(data->getVariableNames()[varID]);
+  }
+  outfile << " };" << std::endl << std::endl;
+
+  outfile << "// x holds the independent variables in the order of variable_names, result has num_outputs values"
+      << std::endl;
+  writeCppPredictFunction(outfile, num_outputs);
+  outfile << std::endl << "} // namespace ranger_forest" << std::endl << std::endl;
+
+  // Command line predictor for testing
+  outfile << "#ifdef RANGER_FOREST_MAIN" << std::endl;
+  outfile << "int main() {" << std::endl;
+  outfile << "  using namespace ranger_forest;" << std::endl;
+  outfile << "  double x[num_independent_variables];" << std::endl;
+  outfile << "  double result[num_outputs];" << std::endl;
+  outfile << "  while (true) {" << std::endl;
+  outfile << "    for (size_t i = 0; i < num_independent_variables; ++i) {" << std::endl;
+  outfile << "      if (scanf(\"%lf%*[ ,\\t]\", &x[i]) != 1) {" << std::endl;
+  outfile << "        return 0;" << std::endl;
+  outfile << "      }" << std::endl;
+  outfile << "    }" << std::endl;
+  outfile << "    predict(x, result);" << std::endl;
+  outfile << "    for (size_t i = 0; i < num_outputs; ++i) {" << std::endl;
+  outfile << "      printf(\"%.17g%c\", result[i], i + 1 < num_outputs ? ' ' : '\\n');" << std::endl;
+  outfile << "    }" << std::endl;
+  outfile << "  }" << std::endl;
+  outfile << "}" << std::endl;
+  outfile << "#endif" << std::endl;
+
+  // Close file
+  outfile.close();
+  if (verbose_out)
+    *verbose_out << "Exported forest to C++ file " << filename << "." << std::endl;
+}
+
+void Forest::writeRunStats() {
+  if (!run_stats) {
+    return;
+  }
+  std::string filename = output_prefix + ".stats.json";
+  run_stats->writeToFile(filename, data->getVariableNames());
+  if (verbose_out)
+    *verbose_out << "Saved run statistics to file " << filename << "." << std::endl;
+}
+
+void Forest::writeCppPredictFunction(std::ofstream& outfile, size_t num_outputs) const {
+  outfile << "const size_t num_outputs = " << num_outputs << ";" << std::endl << std::endl;
+  outfile << "void predict(const double* x, double* result) {" << std::endl;
+  outfile << "  for (size_t i = 0; i < num_outputs; ++i) {" << std::endl;
+  outfile << "    result[i] = 0;" << std::endl;
+  outfile << "  }" << std::endl;
+  outfile << "  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {" << std::endl;
+  outfile << "    const double* leaf = trees[tree_idx](x);" << std::endl;
+  outfile << "    for (size_t i = 0; i < num_outputs; ++i) {" << std::endl;
+  outfile << "      result[i] += leaf[i];" << std::endl;
+  outfile << "    }" << std::endl;
+  outfile << "  }" << std::endl;
+  outfile << "  for (size_t i = 0; i < num_outputs; ++i) {" << std::endl;
+  outfile << "    result[i] /= num_trees;" << std::endl;
+  outfile << "  }" << std::endl;
+  outfile << "}" << std::endl;
+}
 // #nocov end
 
 void Forest::grow() {
@@ -466,15 +779,14 @@ void Forest::grow() {
   //std::cout<<"about to do growinternal"<<std::endl;
   growInternal();
   //std::cout<<"did growinternal"<<std::endl;
-  // Init trees, create a seed for each tree, based on main seed
-  std::uniform_int_distribution<uint> udist;
+  if (!case_weights.empty() && sample_with_replacement) {
+    case_weights_alias = AliasTable(case_weights);
+  }
+
+  // Init trees, create a seed for each tree, based on main seed. The tree seeds do not depend on other draws of the
+  // forest random number generator.
   for (size_t i = 0; i < num_trees; ++i) {
-    uint tree_seed;
-    if (seed == 0) {
-      tree_seed = udist(random_number_generator);
-    } else {
-      tree_seed = (i + 1) * seed;
-    }
+    uint64_t tree_seed = random_number_generator.streamSeed(i);
 
     // Get split select weights for tree
     std::vector<double>* tree_split_select_weights;
@@ -494,9 +806,18 @@ void Forest::grow() {
 
     trees[i]->init(data.get(), mtry, num_samples, tree_seed, &deterministic_varIDs, tree_split_select_weights,
         importance_mode, min_node_size, sample_with_replacement, memory_saving_splitting, splitrule, &case_weights,
-        tree_manual_inbag, keep_inbag, &sample_fraction, alpha, minprop, holdout, num_random_splits, max_depth,
-        &regularization_factor, regularization_usedepth, &split_varIDs_used);
+        &case_weights_alias, tree_manual_inbag, keep_inbag, &sample_fraction, alpha, minprop, holdout, num_random_splits, max_depth,
+        &regularization_factor, regularization_usedepth, &regularization_state, i);
+    trees[i]->setLevelWiseGrowth(level_wise_growth);
+  }
+  // Record statistics in each tree
+  if (run_stats) {
+    run_stats->initTreeStats(num_trees, num_independent_variables);
+    for (size_t i = 0; i < num_trees; ++i) {
+      trees[i]->setStats(&run_stats->getTreeStats(i));
+    }
   }
+
   // Init variable importance
   //std::cout<<"about to init var importance"<<std::endl;
   variable_importance.resize(num_independent_variables, 0);
@@ -570,22 +891,69 @@ void Forest::grow() {
 
 void Forest::predict() {
 
+  // The QuickScorer backend works on the compact forest, convert trees of version 1 files
+  if (prediction_backend == BACKEND_QUICKSCORER) {
+    if (!compact_forest && !quick_scorer_forest) {
+      quick_scorer_forest = make_unique_ranger<CompactForest>(buildCompactForest(false));
+    }
+    if (!quick_scorer) {
+      quick_scorer = make_unique_ranger<QuickScorer>(compact_forest ? *compact_forest : *quick_scorer_forest);
+      if (verbose_out) {
+        *verbose_out << "Using QuickScorer prediction backend." << std::endl;
+        if (quick_scorer->getNumTruncatedTrees() > 0) {
+          *verbose_out << quick_scorer->getNumTruncatedTrees()
+              << " trees with more than 64 leaves, their lower levels are traversed." << std::endl;
+        }
+      }
+    }
+  }
+
+  // Fixed point prediction needs the 8 bit thresholds of the compact forest
+  if (fixed_point_prediction) {
+    if (!compact_forest) {
+      compact_forest = make_unique_ranger<CompactForest>(buildCompactForest(true));
+    }
+    if (!compact_forest->isQuantized()) {
+      throw std::runtime_error(
+          "Fixed point prediction requires 8 bit thresholds: All split variables have to be integers in 0..255 and version 2 forests have to be saved with '--quantize'.");
+    }
+    initFixedPointPrediction();
+  }
+
   // Predict trees in multiple threads and join the threads with the main thread
 #ifdef OLD_WIN_R_BUILD
   // #nocov start
   progress = 0;
   clock_t start_time = clock();
   clock_t lap_time = clock();
-  for (size_t i = 0; i < num_trees; ++i) {
-    trees[i]->predict(data.get(), false);
-    progress++;
-    showProgress("Predicting..", start_time, lap_time);
+  if (quick_scorer && !compact_forest) {
+    for (auto& tree : trees) {
+      tree->resetPredictionTerminalNodeIDs(num_samples);
+    }
+    CompactPredictionBuffers buffers;
+    for (size_t sample_idx = 0; sample_idx < num_samples; ++sample_idx) {
+      quick_scorer->predictTerminalNodes(data.get(), sample_idx, buffers.terminal_nodeIDs, buffers.leaf_bitvectors);
+      for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+        trees[tree_idx]->setPredictionTerminalNodeID(sample_idx, buffers.terminal_nodeIDs[tree_idx]);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < trees.size(); ++i) {
+      trees[i]->predict(data.get(), false);
+      progress++;
+      showProgress("Predicting..", start_time, lap_time);
+    }
   }
 
   // For all samples get tree predictions
   allocatePredictMemory();
+  CompactPredictionBuffers buffers;
   for (size_t sample_idx = 0; sample_idx < data->getNumRows(); ++sample_idx) {
-    predictInternal(sample_idx);
+    if (compact_forest) {
+      predictCompactInternal(sample_idx, buffers);
+    } else {
+      predictInternal(sample_idx);
+    }
   }
   // #nocov end
 #else
@@ -595,15 +963,30 @@ void Forest::predict() {
   aborted_threads = 0;
 #endif
 
-  // Predict
+  // Predict, trees of version 2 forests are traversed while aggregating
   std::vector<std::thread> threads;
-  threads.reserve(num_threads);
-  for (uint i = 0; i < num_threads; ++i) {
-    threads.emplace_back(&Forest::predictTreesInThread, this, i, data.get(), false);
-  }
-  showProgress("Predicting..", num_trees);
-  for (auto &thread : threads) {
-    thread.join();
+  if (quick_scorer && !compact_forest) {
+    // Terminal nodes of version 1 trees by sample
+    for (auto& tree : trees) {
+      tree->resetPredictionTerminalNodeIDs(num_samples);
+    }
+    threads.reserve(num_threads);
+    for (uint i = 0; i < num_threads; ++i) {
+      threads.emplace_back(&Forest::predictQuickScorerInThread, this, i);
+    }
+    showProgress("Predicting..", num_samples);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  } else if (!compact_forest) {
+    threads.reserve(num_threads);
+    for (uint i = 0; i < num_threads; ++i) {
+      threads.emplace_back(&Forest::predictTreesInThread, this, i, data.get(), false);
+    }
+    showProgress("Predicting..", num_trees);
+    for (auto &thread : threads) {
+      thread.join();
+    }
   }
 
   // Aggregate predictions
@@ -625,6 +1008,22 @@ void Forest::predict() {
   }
 #endif
 #endif
+
+  if (fixed_point_prediction) {
+    finishFixedPointPrediction();
+  }
+}
+
+void Forest::initFixedPointPrediction() {
+  throw std::runtime_error("Fixed point prediction is only available for classification and probability forests.");
+}
+
+void Forest::predictCompactTerminalNodes(size_t sample_idx, CompactPredictionBuffers& buffers) const {
+  if (quick_scorer) {
+    quick_scorer->predictTerminalNodes(data.get(), sample_idx, buffers.terminal_nodeIDs, buffers.leaf_bitvectors);
+  } else {
+    compact_forest->predictTerminalNodes(data.get(), sample_idx, buffers.terminal_nodeIDs, buffers.sample_values);
+  }
 }
 
 void Forest::computePredictionError() {
@@ -662,6 +1061,11 @@ void Forest::computePredictionError() {
 
   // Call special function for subclasses
   computePredictionErrorInternal();
+
+  // OOB samples are recreated from the tree seeds when needed again
+  for (auto& tree : trees) {
+    tree->clearOobSampleIDs();
+  }
 }
 
 void Forest::computePermutationImportance() {
@@ -685,7 +1089,10 @@ void Forest::computePermutationImportance() {
 
   // Compute importance
   for (size_t i = 0; i < num_trees; ++i) {
-    trees[i]->computePermutationImportance(variable_importance, variance, variable_importance_casewise);
+    trees[i]->createOobSampleIDs();
+    trees[i]->computePermutationImportance(0, num_independent_variables, variable_importance, variance,
+        variable_importance_casewise);
+    trees[i]->clearOobSampleIDs();
     progress++;
     showProgress("Computing permutation importance..", start_time, lap_time);
   }
@@ -697,28 +1104,58 @@ void Forest::computePermutationImportance() {
   aborted_threads = 0;
 #endif
 
-  std::vector<std::thread> threads;
-  threads.reserve(num_threads);
+  // Split trees and variables into chunks and use one thread for each pair of tree chunk and variable chunk. The
+  // threads of a tree chunk share its accumulators, they write to disjoint variables. Casewise importance needs
+  // num_independent_variables x num_samples values per tree chunk, so it is split by variables first.
+  size_t num_tree_chunks;
+  size_t num_variable_chunks;
+  if (importance_mode == IMP_PERM_CASEWISE) {
+    num_variable_chunks = std::min((size_t) num_threads, num_independent_variables);
+    num_tree_chunks = std::min(num_threads / num_variable_chunks, num_trees);
+  } else {
+    num_tree_chunks = std::min((size_t) num_threads, num_trees);
+    num_variable_chunks = std::min(num_threads / num_tree_chunks, num_independent_variables);
+  }
+  std::vector<uint> tree_ranges;
+  equalSplit(tree_ranges, 0, num_trees - 1, num_tree_chunks);
+  std::vector<uint> variable_ranges;
+  equalSplit(variable_ranges, 0, num_independent_variables - 1, num_variable_chunks);
 
   // Initialize importance and variance
-  std::vector<std::vector<double>> variable_importance_threads(num_threads);
-  std::vector<std::vector<double>> variance_threads(num_threads);
-  std::vector<std::vector<double>> variable_importance_casewise_threads(num_threads);
-
-  // Compute importance
-  for (uint i = 0; i < num_threads; ++i) {
-    variable_importance_threads[i].resize(num_independent_variables, 0);
+  std::vector<std::vector<double>> variable_importance_chunks(num_tree_chunks);
+  std::vector<std::vector<double>> variance_chunks(num_tree_chunks);
+  std::vector<std::vector<double>> variable_importance_casewise_chunks(num_tree_chunks);
+  for (size_t i = 0; i < num_tree_chunks; ++i) {
+    variable_importance_chunks[i].resize(num_independent_variables, 0);
     if (importance_mode == IMP_PERM_BREIMAN || importance_mode == IMP_PERM_LIAW) {
-      variance_threads[i].resize(num_independent_variables, 0);
+      variance_chunks[i].resize(num_independent_variables, 0);
     }
     if (importance_mode == IMP_PERM_CASEWISE) {
-      variable_importance_casewise_threads[i].resize(num_independent_variables * num_samples, 0);
+      variable_importance_casewise_chunks[i].resize(num_independent_variables * num_samples, 0);
+    }
+  }
+
+  // Recreate OOB samples first, the threads of a tree chunk read them concurrently
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (uint i = 0; i < num_threads; ++i) {
+    threads.emplace_back(&Forest::createOobSampleIDsInThread, this, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Compute importance
+  threads.clear();
+  threads.reserve(num_tree_chunks * num_variable_chunks);
+  for (size_t i = 0; i < num_tree_chunks; ++i) {
+    for (size_t j = 0; j < num_variable_chunks; ++j) {
+      threads.emplace_back(&Forest::computeTreePermutationImportanceInThread, this, tree_ranges[i],
+          tree_ranges[i + 1], variable_ranges[j], variable_ranges[j + 1], std::ref(variable_importance_chunks[i]),
+          std::ref(variance_chunks[i]), std::ref(variable_importance_casewise_chunks[i]));
     }
-    threads.emplace_back(&Forest::computeTreePermutationImportanceInThread, this, i,
-        std::ref(variable_importance_threads[i]), std::ref(variance_threads[i]),
-        std::ref(variable_importance_casewise_threads[i]));
   }
-  showProgress("Computing permutation importance..", num_trees);
+  showProgress("Computing permutation importance..", num_trees * num_variable_chunks);
   for (auto &thread : threads) {
     thread.join();
   }
@@ -729,35 +1166,25 @@ void Forest::computePermutationImportance() {
   }
 #endif
 
-  // Sum thread importances
-  variable_importance.resize(num_independent_variables, 0);
-  for (size_t i = 0; i < num_independent_variables; ++i) {
-    for (uint j = 0; j < num_threads; ++j) {
-      variable_importance[i] += variable_importance_threads[j][i];
+  // Sum chunk importances, variances and casewise importances
+  variable_importance = std::move(variable_importance_chunks[0]);
+  std::vector<double> variance = std::move(variance_chunks[0]);
+  variable_importance_casewise = std::move(variable_importance_casewise_chunks[0]);
+  for (size_t j = 1; j < num_tree_chunks; ++j) {
+    for (size_t i = 0; i < variable_importance.size(); ++i) {
+      variable_importance[i] += variable_importance_chunks[j][i];
     }
-  }
-  variable_importance_threads.clear();
-
-  // Sum thread variances
-  std::vector<double> variance(num_independent_variables, 0);
-  if (importance_mode == IMP_PERM_BREIMAN || importance_mode == IMP_PERM_LIAW) {
-    for (size_t i = 0; i < num_independent_variables; ++i) {
-      for (uint j = 0; j < num_threads; ++j) {
-        variance[i] += variance_threads[j][i];
-      }
+    for (size_t i = 0; i < variance.size(); ++i) {
+      variance[i] += variance_chunks[j][i];
     }
-    variance_threads.clear();
-  }
-
-  // Sum thread casewise importances
-  if (importance_mode == IMP_PERM_CASEWISE) {
-    variable_importance_casewise.resize(num_independent_variables * num_samples, 0);
     for (size_t i = 0; i < variable_importance_casewise.size(); ++i) {
-      for (uint j = 0; j < num_threads; ++j) {
-        variable_importance_casewise[i] += variable_importance_casewise_threads[j][i];
-      }
+      variable_importance_casewise[i] += variable_importance_casewise_chunks[j][i];
     }
-    variable_importance_casewise_threads.clear();
+    variable_importance_casewise_chunks[j].clear();
+    variable_importance_casewise_chunks[j].shrink_to_fit();
+  }
+  for (auto& tree : trees) {
+    tree->clearOobSampleIDs();
   }
 #endif
 
@@ -783,12 +1210,30 @@ void Forest::computePermutationImportance() {
 #ifndef OLD_WIN_R_BUILD
 void Forest::growTreesInThread(uint thread_idx, std::vector<double>* variable_importance) {
   if (thread_ranges.size() > thread_idx + 1) {
-    for (size_t i = thread_ranges[thread_idx]; i < thread_ranges[thread_idx + 1]; ++i) {
+    bool regularization = !regularization_factor.empty();
+    size_t num_thread_trees = thread_ranges[thread_idx + 1] - thread_ranges[thread_idx];
+    for (size_t j = 0; j < num_thread_trees; ++j) {
+      // Regularized trees wait for earlier trees, grow them interleaved so that all threads work on neighbouring
+      // trees. The number of trees per thread is the same.
+      size_t i;
+      if (regularization) {
+        i = thread_idx + j * num_threads;
+        regularization_state.waitForTree(i);
+      } else {
+        i = thread_ranges[thread_idx] + j;
+      }
+
       trees[i]->grow(variable_importance);
+      if (regularization) {
+        regularization_state.setGrown(i);
+      }
 
       // Check for user interrupt
 #ifdef R_BUILD
       if (aborted) {
+        if (regularization) {
+          regularization_state.release();
+        }
         std::unique_lock<std::mutex> lock(mutex);
         ++aborted_threads;
         condition_variable.notify_one();
@@ -827,14 +1272,27 @@ void Forest::predictTreesInThread(uint thread_idx, const Data* prediction_data,
   }
 }
 
+void Forest::createOobSampleIDsInThread(uint thread_idx) {
+  if (thread_ranges.size() > thread_idx + 1) {
+    for (size_t i = thread_ranges[thread_idx]; i < thread_ranges[thread_idx + 1]; ++i) {
+      trees[i]->createOobSampleIDs();
+    }
+  }
+}
+
 void Forest::predictInternalInThread(uint thread_idx) {
   // Create thread ranges
   std::vector<uint> predict_ranges;
   equalSplit(predict_ranges, 0, num_samples - 1, num_threads);
 
   if (predict_ranges.size() > thread_idx + 1) {
+    CompactPredictionBuffers buffers;
     for (size_t i = predict_ranges[thread_idx]; i < predict_ranges[thread_idx + 1]; ++i) {
-      predictInternal(i);
+      if (compact_forest) {
+        predictCompactInternal(i, buffers);
+      } else {
+        predictInternal(i);
+      }
 
       // Check for user interrupt
 #ifdef R_BUILD
@@ -854,11 +1312,17 @@ void Forest::predictInternalInThread(uint thread_idx) {
   }
 }
 
-void Forest::computeTreePermutationImportanceInThread(uint thread_idx, std::vector<double>& importance,
-    std::vector<double>& variance, std::vector<double>& importance_casewise) {
-  if (thread_ranges.size() > thread_idx + 1) {
-    for (size_t i = thread_ranges[thread_idx]; i < thread_ranges[thread_idx + 1]; ++i) {
-      trees[i]->computePermutationImportance(importance, variance, importance_casewise);
+void Forest::predictQuickScorerInThread(uint thread_idx) {
+  std::vector<uint> predict_ranges;
+  equalSplit(predict_ranges, 0, num_samples - 1, num_threads);
+
+  if (predict_ranges.size() > thread_idx + 1) {
+    CompactPredictionBuffers buffers;
+    for (size_t i = predict_ranges[thread_idx]; i < predict_ranges[thread_idx + 1]; ++i) {
+      quick_scorer->predictTerminalNodes(data.get(), i, buffers.terminal_nodeIDs, buffers.leaf_bitvectors);
+      for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+        trees[tree_idx]->setPredictionTerminalNodeID(i, buffers.terminal_nodeIDs[tree_idx]);
+      }
 
       // Check for user interrupt
 #ifdef R_BUILD
@@ -870,13 +1334,36 @@ void Forest::computeTreePermutationImportanceInThread(uint thread_idx, std::vect
       }
 #endif
 
-      // Increase progress by 1 tree
+      // Increase progress by 1 sample
       std::unique_lock<std::mutex> lock(mutex);
       ++progress;
       condition_variable.notify_one();
     }
   }
 }
+
+void Forest::computeTreePermutationImportanceInThread(size_t start_treeID, size_t end_treeID, size_t start_varID,
+    size_t end_varID, std::vector<double>& importance, std::vector<double>& variance,
+    std::vector<double>& importance_casewise) {
+  for (size_t i = start_treeID; i < end_treeID; ++i) {
+    trees[i]->computePermutationImportance(start_varID, end_varID, importance, variance, importance_casewise);
+
+    // Check for user interrupt
+#ifdef R_BUILD
+    if (aborted) {
+      std::unique_lock<std::mutex> lock(mutex);
+      ++aborted_threads;
+      condition_variable.notify_one();
+      return;
+    }
+#endif
+
+    // Increase progress by 1 tree
+    std::unique_lock<std::mutex> lock(mutex);
+    ++progress;
+    condition_variable.notify_one();
+  }
+}
 #endif
 
 // #nocov start
@@ -884,6 +1371,18 @@ void Forest::loadFromFile(std::string filename) {
   if (verbose_out)
     *verbose_out << "Loading forest from file " << filename << "." << std::endl;
 
+  // Version 2 files are memory mapped and not parsed
+  if (CompactForest::isCompactForestFile(filename)) {
+    compact_forest = make_unique_ranger<CompactForest>(filename);
+    if (compact_forest->getNumIndependentVariables() != num_independent_variables) {
+      throw std::runtime_error("Number of independent variables in data does not match with the loaded forest.");
+    }
+    num_trees = compact_forest->getNumTrees();
+    data->getIsOrderedVariable() = compact_forest->getIsOrderedVariable();
+    loadFromCompactForestInternal();
+    return;
+  }
+
   // Open file for reading
   std::ifstream infile;
   infile.open(filename, std::ios::binary);
@@ -917,6 +1416,11 @@ void Forest::loadFromFile(std::string filename) {
 
 void Forest::loadDependentVariableNamesFromFile(std::string filename) {
 
+  if (CompactForest::isCompactForestFile(filename)) {
+    dependent_variable_names = CompactForest(filename).getDependentVariableNames();
+    return;
+  }
+
   // Open file for reading
   std::ifstream infile;
   infile.open(filename, std::ios::binary);
@@ -941,8 +1445,53 @@ void Forest::loadDependentVariableNamesFromFile(std::string filename) {
   infile.close();
 }
 
-std::unique_ptr<Data> Forest::loadDataFromFile(const std::string& data_path, const std::string& evaldata_path, const bool batch_data, const size_t kernel_size) {
+std::unique_ptr<Data> Forest::createData(bool row_major) const {
   std::unique_ptr<Data> result { };
+
+  // Trees read one value per node and sample, keep the values of a sample together
+  if (row_major) {
+    switch (memory_mode) {
+    case MEM_DOUBLE:
+      result = make_unique_ranger<DataRowMajor<double>>();
+      break;
+    case MEM_FLOAT:
+      result = make_unique_ranger<DataRowMajor<float>>();
+      break;
+    case MEM_CHAR:
+      result = make_unique_ranger<DataRowMajor<char>>();
+      break;
+    case MEM_INT:
+      result = make_unique_ranger<DataRowMajor<uint32_t>>();
+      break;
+    case MEM_UINT8:
+      result = make_unique_ranger<DataRowMajor<uint8_t>>();
+      break;
+    default:
+      break;
+    }
+    if (result) {
+      return result;
+    }
+  }
+
+  // Training data larger than the main memory
+  if (!row_major && !out_of_core_file.empty()) {
+    switch (memory_mode) {
+    case MEM_DOUBLE:
+      return make_unique_ranger<DataMapped<double>>(out_of_core_file);
+    case MEM_FLOAT:
+      return make_unique_ranger<DataMapped<float>>(out_of_core_file);
+    case MEM_CHAR:
+      return make_unique_ranger<DataMapped<char>>(out_of_core_file);
+    case MEM_INT:
+      return make_unique_ranger<DataMapped<uint32_t>>(out_of_core_file);
+    case MEM_UINT8:
+      return make_unique_ranger<DataMapped<uint8_t>>(out_of_core_file);
+    default:
+      throw std::runtime_error("Out-of-core training is not available for memory modes 5 and 6.");
+    }
+  }
+
   switch (memory_mode) {
   case MEM_DOUBLE:
     result = make_unique_ranger<DataDouble>();
@@ -956,12 +1505,27 @@ std::unique_ptr<Data> Forest::loadDataFromFile(const std::string& data_path, con
   case MEM_INT:
     result = make_unique_ranger<DataInt>();
     break;
+  case MEM_UINT8:
+    result = make_unique_ranger<DataUint8>();
+    break;
+  case MEM_HALF:
+    result = make_unique_ranger<DataHalf>();
+    break;
+  case MEM_ADAPTIVE:
+    result = make_unique_ranger<DataAdaptive>();
+    break;
   }
+  return result;
+}
+
+std::unique_ptr<Data> Forest::loadDataFromFile(const std::string& data_path, const std::string& evaldata_path, const bool batch_data, const size_t kernel_size, bool row_major) {
+  std::unique_ptr<Data> result = createData(row_major);
 
   if (verbose_out)
     *verbose_out << "Loading input file: " << data_path << "." << std::endl;
   //bool found_rounding_error = result->loadFromFile(data_path, dependent_variable_names);
   bool found_rounding_error = result->loadFromFileAlex(data_path, evaldata_path, dependent_variable_names, batch_data, kernel_size);
+  result->packColumns();
   if (found_rounding_error && verbose_out) {
     *verbose_out << "Warning: Rounding or Integer overflow occurred. Use FLOAT or DOUBLE precision to avoid this."
         << std::endl;
@@ -25,11 +25,23 @@
 #endif
 
 #include "globals.h"
+#include "RandomGenerator.h"
+#include "RegularizationState.h"
 #include "Tree.h"
 #include "Data.h"
+#include "CompactForest.h"
+#include "QuickScorer.h"
+#include "RunStats.h"
 
 namespace ranger {
 
+// Vectors used to predict one sample with a compact forest, reused for all samples of a thread
+struct CompactPredictionBuffers {
+  std::vector<index_t> terminal_nodeIDs;
+  std::vector<uint8_t> sample_values;
+  std::vector<uint64_t> leaf_bitvectors;
+};
+
 class Forest {
 public:
   Forest();
@@ -67,14 +79,46 @@ public:
       bool order_snps, uint max_depth, const std::vector<double>& regularization_factor, bool regularization_usedepth);
   virtual void initInternal() = 0;
 
+  // Engine to find terminal nodes in prediction mode, call before run()
+  void setPredictionBackend(PredictionBackend prediction_backend) {
+    this->prediction_backend = prediction_backend;
+  }
+
+  // Predict with 8 bit thresholds and integer leaf values, optionally also compute the floating point prediction
+  // to report the deviation. Call before run().
+  void setFixedPointPrediction(bool fixed_point_prediction, bool check_fixed_point_deviation) {
+    this->fixed_point_prediction = fixed_point_prediction;
+    this->check_fixed_point_deviation = check_fixed_point_deviation;
+  }
+
+  // Record timings and counters of all phases, call before init
+  void enableRunStats();
+
+  // Keep the training data in a memory-mapped file instead of main memory, implies memory saving splitting. Call
+  // before initCpp.
+  void setOutOfCoreFile(const std::string& out_of_core_file) {
+    this->out_of_core_file = out_of_core_file;
+  }
+
+  // Grow the trees level by level, see Tree::prepareLevel(). Call before run.
+  void setLevelWiseGrowth(bool level_wise_growth) {
+    this->level_wise_growth = level_wise_growth;
+  }
+
   // Grow or predict
   void run(bool verbose, bool compute_oob_error);
 
+  // Predict new samples with a forest loaded for prediction, without reloading the forest. Call after initCpp,
+  // writeOutput then writes the results to output_prefix.
+  void predictFile(const std::string& input_file, const std::string& output_prefix);
+  void predictValues(const std::vector<double>& values, size_t num_rows);
+
   // Write results to output files
   void writeOutput();
   virtual void writeOutputInternal() = 0;
   virtual void writeConfusionFile() = 0;
-  virtual void writePredictionFile() = 0;
+  void writePredictionFile();
+  virtual void writePredictions(std::ostream& outfile) = 0;
   virtual void writeImageMask() = 0;
   void writeImportanceFile();
 
@@ -82,17 +126,31 @@ public:
   void saveToFile();
   virtual void saveToFileInternal(std::ofstream& outfile) = 0;
 
+  // Save forest to file in version 2 format
+  void saveToCompactFile(bool quantize);
+
+  // Write forest as C++ source file <outprefix>.cpp with a standalone predict() function
+  void exportToCpp();
+
+  // Write run statistics to <outprefix>.stats.json
+  void writeRunStats();
+
   std::vector<std::vector<std::vector<size_t>>> getChildNodeIDs() {
     std::vector<std::vector<std::vector<size_t>>> result;
     for (auto& tree : trees) {
-      result.push_back(tree->getChildNodeIDs());
+      std::vector<std::vector<size_t>> child_nodeIDs;
+      for (auto& child_nodes : tree->getChildNodeIDs()) {
+        child_nodeIDs.push_back(std::vector<size_t>(child_nodes.begin(), child_nodes.end()));
+      }
+      result.push_back(child_nodeIDs);
     }
     return result;
   }
   std::vector<std::vector<size_t>> getSplitVarIDs() {
     std::vector<std::vector<size_t>> result;
     for (auto& tree : trees) {
-      result.push_back(tree->getSplitVarIDs());
+      const std::vector<index_t>& split_varIDs = tree->getSplitVarIDs();
+      result.push_back(std::vector<size_t>(split_varIDs.begin(), split_varIDs.end()));
     }
     return result;
   }
@@ -152,6 +210,18 @@ protected:
   void predict();
   virtual void allocatePredictMemory() = 0;
   virtual void predictInternal(size_t sample_idx) = 0;
+  virtual void predictCompactInternal(size_t sample_idx, CompactPredictionBuffers& buffers) = 0;
+
+  // Prepare integer leaf values of the compact forest, only classification and probability forests support this
+  virtual void initFixedPointPrediction();
+
+  // Convert the integer sums of all samples to predictions after aggregation
+  virtual void finishFixedPointPrediction() {
+  }
+
+  // Terminal nodeIDs of all trees of the compact forest in buffers.terminal_nodeIDs, with the selected prediction
+  // backend
+  void predictCompactTerminalNodes(size_t sample_idx, CompactPredictionBuffers& buffers) const;
 
   void computePredictionError();
   virtual void computePredictionErrorInternal() = 0;
@@ -161,18 +231,34 @@ protected:
   // Multithreading methods for growing/prediction/importance, called by each thread
   void growTreesInThread(uint thread_idx, std::vector<double>* variable_importance);
   void predictTreesInThread(uint thread_idx, const Data* prediction_data, bool oob_prediction);
+  void createOobSampleIDsInThread(uint thread_idx);
   void predictInternalInThread(uint thread_idx);
-  void computeTreePermutationImportanceInThread(uint thread_idx, std::vector<double>& importance,
-      std::vector<double>& variance, std::vector<double>& importance_casewise);
+  void predictQuickScorerInThread(uint thread_idx);
+  void computeTreePermutationImportanceInThread(size_t start_treeID, size_t end_treeID, size_t start_varID,
+      size_t end_varID, std::vector<double>& importance, std::vector<double>& variance,
+      std::vector<double>& importance_casewise);
 
   // Load forest from file
   void loadFromFile(std::string filename);
   virtual void loadFromFileInternal(std::ifstream& infile) = 0;
   void loadDependentVariableNamesFromFile(std::string filename);
+  virtual void loadFromCompactForestInternal() = 0;
+
+  // Convert trees to flat version 2 format, leaf values are added for each terminal node
+  std::vector<char> buildCompactForest(bool quantize);
+  virtual std::unique_ptr<CompactForestBuilder> createCompactForestBuilder() = 0;
+  virtual void appendLeafValues(size_t tree_idx, size_t nodeID, std::vector<double>& leaf_values) const = 0;
 
-  // Load data from file
+  // Write predict() of exported C++ forest, default is the mean of the leaf values over trees
+  virtual void writeCppPredictFunction(std::ofstream& outfile, size_t num_outputs) const;
+
+  // Replace data of a forest loaded for prediction
+  void setPredictionData(std::unique_ptr<Data> prediction_data);
+
+  // Load data from file, row-major data for prediction
+  std::unique_ptr<Data> createData(bool row_major) const;
   std::unique_ptr<Data> loadDataFromFile(const std::string& data_path, const std::string& evaldata_path,
-      const bool batch_data, const size_t kernel_size);
+      const bool batch_data, const size_t kernel_size, bool row_major);
 
   // Set split select weights and variables to be always considered for splitting
   void setSplitWeightVector(std::vector<std::vector<double>>& split_select_weights);
@@ -197,8 +283,10 @@ protected:
   size_t num_samples;
   bool prediction_mode;
   MemoryMode memory_mode;
+  std::string out_of_core_file;
   bool sample_with_replacement;
   bool memory_saving_splitting;
+  bool level_wise_growth;
   SplitRule splitrule;
   bool predict_all;
   bool keep_inbag;
@@ -222,6 +310,17 @@ protected:
 
   std::vector<std::unique_ptr<Tree>> trees;
   std::unique_ptr<Data> data;
+
+  // Forest loaded from version 2 file, used instead of trees for prediction
+  std::unique_ptr<CompactForest> compact_forest;
+  PredictionBackend prediction_backend;
+  std::unique_ptr<QuickScorer> quick_scorer;
+
+  // Compact forest of the trees of version 1 files for the QuickScorer. It only finds the terminal nodes, the
+  // predictions are aggregated from the trees with their double leaf values.
+  std::unique_ptr<CompactForest> quick_scorer_forest;
+  bool fixed_point_prediction;
+  bool check_fixed_point_deviation;
   bool write_to_img;
   size_t img_width;
   size_t img_height;
@@ -239,11 +338,16 @@ protected:
   // Bootstrap weights
   std::vector<double> case_weights;
 
+  // Alias table of case weights for weighted sampling with replacement, shared by all trees
+  AliasTable case_weights_alias;
+
   // Pre-selected bootstrap samples (per tree)
   std::vector<std::vector<size_t>> manual_inbag;
 
-  // Random number generator
-  std::mt19937_64 random_number_generator;
+  // Random number generator. Trees and ties in predictions of samples get own streams of its seed, tree i stream i
+  // and sample i stream SAMPLE_STREAM_START + i.
+  RandomGenerator random_number_generator;
+  static constexpr uint64_t SAMPLE_STREAM_START = 1ULL << 32;
 
   std::string output_prefix;
   ImportanceMode importance_mode;
@@ -251,7 +355,7 @@ protected:
   // Regularization
   std::vector<double> regularization_factor;
   bool regularization_usedepth;
-  std::vector<bool> split_varIDs_used;
+  RegularizationState regularization_state;
 
   // Variable importance for all variables in forest
   std::vector<double> variable_importance;
@@ -259,6 +363,9 @@ protected:
   // Casewise variable importance for all variables in forest
   std::vector<double> variable_importance_casewise;
 
+  // Timings and counters, nullptr if not recorded
+  std::unique_ptr<RunStats> run_stats;
+
   // Computation progress (finished trees)
   size_t progress;
 #ifdef R_BUILD
@@ -93,9 +93,10 @@ void ForestClassification::initInternal() {
   // Set class weights all to 1
   class_weights = std::vector<double>(class_values.size(), 1.0);
 
-  // Sort data if memory saving mode
-  if (!memory_saving_splitting) {
-    data->sort();
+  // Sort data if memory saving mode, not needed for prediction
+  if (!memory_saving_splitting && !prediction_mode) {
+    PhaseTimer timer(run_stats.get(), PHASE_SORT);
+    data->sort(num_threads);
   }
 }
 
@@ -134,7 +135,8 @@ void ForestClassification::predictInternal(size_t sample_idx) {
     for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
       ++class_count[getTreePrediction(tree_idx, sample_idx)];
     }
-    predictions[0][0][sample_idx] = mostFrequentValue(class_count, random_number_generator);
+    predictions[0][0][sample_idx] = mostFrequentValue(class_count,
+        RandomGenerator(random_number_generator.streamSeed(SAMPLE_STREAM_START + sample_idx)));
   }
 }
 
@@ -160,7 +162,8 @@ void ForestClassification::computePredictionErrorInternal() {
       std::vector<std::vector<double>>(1, std::vector<double>(num_samples)));
   for (size_t i = 0; i < num_samples; ++i) {
     if (!class_counts[i].empty()) {
-      predictions[0][0][i] = mostFrequentValue(class_counts[i], random_number_generator);
+      predictions[0][0][i] = mostFrequentValue(class_counts[i],
+          RandomGenerator(random_number_generator.streamSeed(SAMPLE_STREAM_START + i)));
     } else {
       predictions[0][0][i] = NAN;
     }
@@ -271,15 +274,8 @@ void ForestClassification::writeImageMask() {
   stbi_image_free(cloud_mask_out);
 }
 
-void ForestClassification::writePredictionFile() {
+void ForestClassification::writePredictions(std::ostream& outfile) {
 
-  // Open prediction file for writing
-  std::string filename = output_prefix + ".prediction";
-  std::ofstream outfile;
-  outfile.open(filename, std::ios::out);
-  if (!outfile.good()) {
-    throw std::runtime_error("Could not write to prediction file: " + filename + ".");
-  }
   // Write
   outfile << "Predictions: " << std::endl;
   if (predict_all) {
@@ -301,9 +297,6 @@ void ForestClassification::writePredictionFile() {
       }
     }
   }
-
-  if (verbose_out)
-    *verbose_out << "Saved predictions to file " << filename << "." << std::endl;
 }
 
 void ForestClassification::saveToFileInternal(std::ofstream& outfile) {
@@ -356,6 +349,75 @@ void ForestClassification::loadFromFileInternal(std::ifstream& infile) {
   }
 }
 
+void ForestClassification::predictCompactInternal(size_t sample_idx, CompactPredictionBuffers& buffers) {
+  predictCompactTerminalNodes(sample_idx, buffers);
+  const std::vector<index_t>& terminal_nodeIDs = buffers.terminal_nodeIDs;
+
+  // Leaf values are indices in class_values
+  if (predict_all || prediction_type == TERMINALNODES) {
+    for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+      size_t nodeID = terminal_nodeIDs[tree_idx];
+      if (prediction_type == TERMINALNODES) {
+        predictions[0][sample_idx][tree_idx] = nodeID;
+      } else {
+        predictions[0][sample_idx][tree_idx] = class_values[*compact_forest->getLeafValues(tree_idx, nodeID)];
+      }
+    }
+  } else {
+    // Count classes over trees and save class with maximum count
+    std::unordered_map<double, size_t> class_count;
+    for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+      size_t nodeID = terminal_nodeIDs[tree_idx];
+      ++class_count[class_values[*compact_forest->getLeafValues(tree_idx, nodeID)]];
+    }
+    predictions[0][0][sample_idx] = mostFrequentValue(class_count,
+        RandomGenerator(random_number_generator.streamSeed(SAMPLE_STREAM_START + sample_idx)));
+  }
+}
+
+void ForestClassification::loadFromCompactForestInternal() {
+  if (compact_forest->getTreeType() != TREE_CLASSIFICATION) {
+    throw std::runtime_error("Wrong treetype. Loaded file is not a classification forest.");
+  }
+  class_values = compact_forest->getClassValues();
+}
+
+std::unique_ptr<CompactForestBuilder> ForestClassification::createCompactForestBuilder() {
+  return make_unique_ranger<CompactForestBuilder>(TREE_CLASSIFICATION, num_independent_variables,
+      dependent_variable_names, data->getIsOrderedVariable(), class_values, 1);
+}
+
+void ForestClassification::appendLeafValues(size_t tree_idx, size_t nodeID, std::vector<double>& leaf_values) const {
+  double value = trees[tree_idx]->getSplitValues()[nodeID];
+  size_t classID = std::find(class_values.begin(), class_values.end(), value) - class_values.begin();
+  leaf_values.push_back(classID);
+}
+
+void ForestClassification::writeCppPredictFunction(std::ofstream& outfile, size_t num_outputs) const {
+  // Leaf values are indices in class_values
+  outfile << "const size_t num_outputs = 1;" << std::endl;
+  outfile << "const size_t num_classes = " << class_values.size() << ";" << std::endl;
+  outfile << "const double class_values[] = { ";
+  for (size_t i = 0; i < class_values.size(); ++i) {
+    outfile << (i > 0 ? ", " : "") << doubleToString(class_values[i]);
+  }
+  outfile << " };" << std::endl << std::endl;
+  outfile << "// Majority vote. Ties are broken by the first class, ranger breaks ties at random." << std::endl;
+  outfile << "void predict(const double* x, double* result) {" << std::endl;
+  outfile << "  size_t class_count[num_classes] = { };" << std::endl;
+  outfile << "  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {" << std::endl;
+  outfile << "    ++class_count[(size_t) trees[tree_idx](x)[0]];" << std::endl;
+  outfile << "  }" << std::endl;
+  outfile << "  size_t max_idx = 0;" << std::endl;
+  outfile << "  for (size_t i = 1; i < num_classes; ++i) {" << std::endl;
+  outfile << "    if (class_count[i] > class_count[max_idx]) {" << std::endl;
+  outfile << "      max_idx = i;" << std::endl;
+  outfile << "    }" << std::endl;
+  outfile << "  }" << std::endl;
+  outfile << "  result[0] = class_values[max_idx];" << std::endl;
+  outfile << "}" << std::endl;
+}
+
 double ForestClassification::getTreePrediction(size_t tree_idx, size_t sample_idx) const {
   const auto& tree = dynamic_cast<const TreeClassification&>(*trees[tree_idx]);
   return tree.getPrediction(sample_idx);
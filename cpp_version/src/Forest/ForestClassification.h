@@ -51,10 +51,19 @@ protected:
   void computePredictionErrorInternal() override;
   void writeOutputInternal() override;
   void writeConfusionFile() override;
-  void writePredictionFile() override;
+  void writePredictions(std::ostream& outfile) override;
   void writeImageMask() override;
   void saveToFileInternal(std::ofstream& outfile) override;
   void loadFromFileInternal(std::ifstream& infile) override;
+  void predictCompactInternal(size_t sample_idx, CompactPredictionBuffers& buffers) override;
+
+  // Votes are already counted as integers, nothing to prepare
+  void initFixedPointPrediction() override {
+  }
+  void loadFromCompactForestInternal() override;
+  std::unique_ptr<CompactForestBuilder> createCompactForestBuilder() override;
+  void appendLeafValues(size_t tree_idx, size_t nodeID, std::vector<double>& leaf_values) const override;
+  void writeCppPredictFunction(std::ofstream& outfile, size_t num_outputs) const override;
 
   // Classes of the dependent variable and classIDs for responses
   std::vector<double> class_values;
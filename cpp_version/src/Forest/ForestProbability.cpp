@@ -9,9 +9,12 @@
  R package "ranger" under GPL3 license.
  #-------------------------------------------------------------------------------*/
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
 #include "utility.h"
+#include "Simd.h"
 #include "ForestProbability.h"
 #include "TreeProbability.h"
 #include "Data.h"
@@ -98,9 +101,10 @@ void ForestProbability::initInternal() {
   // Set class weights all to 1
   class_weights = std::vector<double>(class_values.size(), 1.0);
 
-  // Sort data if memory saving mode
-  if (!memory_saving_splitting) {
-    data->sort();
+  // Sort data if memory saving mode, not needed for prediction
+  if (!memory_saving_splitting && !prediction_mode) {
+    PhaseTimer timer(run_stats.get(), PHASE_SORT);
+    data->sort(num_threads);
   }
 }
 
@@ -124,13 +128,18 @@ void ForestProbability::allocatePredictMemory() {
     predictions = std::vector<std::vector<std::vector<double>>>(1,
         std::vector<std::vector<double>>(num_prediction_samples, std::vector<double>(class_values.size(), 0)));
   }
+  if (fixed_point_prediction) {
+    fixed_point_sums.assign(num_prediction_samples * class_values.size(), 0);
+    fixed_point_deviations.assign(num_prediction_samples, 0);
+    fixed_point_mask_deviations.assign(num_prediction_samples, 0);
+  }
 }
 
 void ForestProbability::predictInternal(size_t sample_idx) {
   // For each sample compute proportions in each tree
   for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
     if (predict_all) {
-      std::vector<double> counts = getTreePrediction(tree_idx, sample_idx);
+      const std::vector<double>& counts = getTreePrediction(tree_idx, sample_idx);
 
       for (size_t class_idx = 0; class_idx < counts.size(); ++class_idx) {
         predictions[sample_idx][class_idx][tree_idx] += counts[class_idx];
@@ -138,11 +147,8 @@ void ForestProbability::predictInternal(size_t sample_idx) {
     } else if (prediction_type == TERMINALNODES) {
       predictions[0][sample_idx][tree_idx] = getTreePredictionTerminalNodeID(tree_idx, sample_idx);
     } else {
-      std::vector<double> counts = getTreePrediction(tree_idx, sample_idx);
-
-      for (size_t class_idx = 0; class_idx < counts.size(); ++class_idx) {
-        predictions[0][sample_idx][class_idx] += counts[class_idx];
-      }
+      const std::vector<double>& counts = getTreePrediction(tree_idx, sample_idx);
+      addToSums(predictions[0][sample_idx].data(), counts.data(), counts.size());
     }
   }
 
@@ -165,11 +171,8 @@ void ForestProbability::computePredictionErrorInternal() {
   for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
     for (size_t sample_idx = 0; sample_idx < trees[tree_idx]->getNumSamplesOob(); ++sample_idx) {
       size_t sampleID = trees[tree_idx]->getOobSampleIDs()[sample_idx];
-      std::vector<double> counts = getTreePrediction(tree_idx, sample_idx);
-
-      for (size_t class_idx = 0; class_idx < counts.size(); ++class_idx) {
-        predictions[0][sampleID][class_idx] += counts[class_idx];
-      }
+      const std::vector<double>& counts = getTreePrediction(tree_idx, sample_idx);
+      addToSums(predictions[0][sampleID].data(), counts.data(), counts.size());
       ++samples_oob_count[sampleID];
     }
   }
@@ -200,6 +203,12 @@ void ForestProbability::computePredictionErrorInternal() {
 void ForestProbability::writeOutputInternal() {
   if (verbose_out) {
     *verbose_out << "Tree type:                         " << "Probability estimation" << std::endl;
+    if (fixed_point_prediction && check_fixed_point_deviation && !fixed_point_deviations.empty()) {
+      *verbose_out << "Fixed point prediction, maximum deviation from floating point: "
+          << *std::max_element(fixed_point_deviations.begin(), fixed_point_deviations.end()) << " (probability), "
+          << (int) *std::max_element(fixed_point_mask_deviations.begin(), fixed_point_mask_deviations.end())
+          << " (mask value)" << std::endl;
+    }
   }
 }
 
@@ -237,6 +246,14 @@ void ForestProbability::writeImageMask() {
     for(size_t j = 0; j < img_height; j++) {
       int k = ((img_width * j) +i);
       int idx = (channels) * k;
+      if (fixed_point_prediction) {
+        // Integer scaling of the fixed point sum
+        uint8_t mask_value = fixedPointMaskValue(fixed_point_sums[((img_height * i) + j) * class_values.size()]);
+        cloud_mask_out[idx] = mask_value;
+        cloud_mask_out[idx+1] = mask_value;
+        cloud_mask_out[idx+2] = mask_value;
+        continue;
+      }
       double val = predictions[0][((img_height * i) +j)][0];//0.0;
       //std::cout<<"othersize"<<predictions[0].size()<<"\n";
       if(k < predictions[0][0].size()) {
@@ -259,15 +276,7 @@ void ForestProbability::writeImageMask() {
   stbi_image_free(cloud_mask_out);
 }
 
-void ForestProbability::writePredictionFile() {
-
-  // Open prediction file for writing
-  std::string filename = output_prefix + ".prediction";
-  std::ofstream outfile;
-  outfile.open(filename, std::ios::out);
-  if (!outfile.good()) {
-    throw std::runtime_error("Could not write to prediction file: " + filename + ".");
-  }
+void ForestProbability::writePredictions(std::ostream& outfile) {
 
   // Write
   outfile << "Class predictions, one sample per row." << std::endl;
@@ -297,9 +306,6 @@ void ForestProbability::writePredictionFile() {
       }
     }
   }
-
-  if (verbose_out)
-    *verbose_out << "Saved predictions to file " << filename << "." << std::endl;
 }
 
 void ForestProbability::saveToFileInternal(std::ofstream& outfile) {
@@ -366,6 +372,137 @@ void ForestProbability::loadFromFileInternal(std::ifstream& infile) {
   }
 }
 
+void ForestProbability::predictCompactInternal(size_t sample_idx, CompactPredictionBuffers& buffers) {
+  // For each sample add leaf proportions of each tree
+  size_t num_classes = class_values.size();
+  predictCompactTerminalNodes(sample_idx, buffers);
+  const std::vector<index_t>& terminal_nodeIDs = buffers.terminal_nodeIDs;
+  if (fixed_point_prediction && !predict_all && prediction_type != TERMINALNODES) {
+    predictFixedPoint(sample_idx, terminal_nodeIDs);
+    return;
+  }
+  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+    size_t nodeID = terminal_nodeIDs[tree_idx];
+    if (prediction_type == TERMINALNODES) {
+      predictions[0][sample_idx][tree_idx] = nodeID;
+    } else {
+      const float* counts = compact_forest->getLeafValues(tree_idx, nodeID);
+      if (predict_all) {
+        for (size_t class_idx = 0; class_idx < num_classes; ++class_idx) {
+          predictions[sample_idx][class_idx][tree_idx] += counts[class_idx];
+        }
+      } else {
+        addToSums(predictions[0][sample_idx].data(), counts, num_classes);
+      }
+    }
+  }
+
+  // Average over trees
+  if (!predict_all && prediction_type != TERMINALNODES) {
+    for (size_t class_idx = 0; class_idx < predictions[0][sample_idx].size(); ++class_idx) {
+      predictions[0][sample_idx][class_idx] /= num_trees;
+    }
+  }
+}
+
+void ForestProbability::initFixedPointPrediction() {
+  if (num_trees > (1 << 16)) {
+    throw std::runtime_error("Fixed point prediction supports at most 65536 trees.");
+  }
+
+  // Leaves are rounded once for all predictions with the loaded forest
+  if (fixed_point_leaves.size() == num_trees) {
+    return;
+  }
+
+  // Round leaf proportions to fixed point, leaf values are in the order of the leaf indices
+  size_t num_classes = class_values.size();
+  fixed_point_leaves.resize(num_trees);
+  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+    const CompactNode* nodes = compact_forest->getNodes(tree_idx);
+    std::vector<uint16_t>& leaves = fixed_point_leaves[tree_idx];
+    leaves.assign(compact_forest->getNumLeaves(tree_idx) * num_classes, 0);
+    for (size_t nodeID = 0; nodeID < compact_forest->getNumNodes(tree_idx); ++nodeID) {
+      if (nodes[nodeID].left_child == 0) {
+        const float* counts = compact_forest->getLeafValues(tree_idx, nodeID);
+        for (size_t class_idx = 0; class_idx < num_classes; ++class_idx) {
+          double value = std::min(std::max((double) counts[class_idx], 0.0), 1.0);
+          leaves[(size_t) nodes[nodeID].varID * num_classes + class_idx] = std::round(value * FIXED_POINT_ONE);
+        }
+      }
+    }
+  }
+}
+
+void ForestProbability::predictFixedPoint(size_t sample_idx, const std::vector<index_t>& terminal_nodeIDs) {
+  // Sum fixed point leaf proportions
+  size_t num_classes = class_values.size();
+  uint32_t* sums = fixed_point_sums.data() + sample_idx * num_classes;
+  const size_t max_leaves = 16;
+  const uint16_t* leaves[max_leaves];
+  for (size_t start_tree_idx = 0; start_tree_idx < num_trees; start_tree_idx += max_leaves) {
+    size_t num_leaves = std::min(max_leaves, num_trees - start_tree_idx);
+    for (size_t i = 0; i < num_leaves; ++i) {
+      size_t tree_idx = start_tree_idx + i;
+      size_t leaf = compact_forest->getNodes(tree_idx)[terminal_nodeIDs[tree_idx]].varID;
+      leaves[i] = fixed_point_leaves[tree_idx].data() + leaf * num_classes;
+    }
+    addLeafSums(sums, leaves, num_leaves, num_classes);
+  }
+
+  // Compare with the floating point leaf values of the same terminal nodes
+  if (check_fixed_point_deviation) {
+    std::vector<double> float_sums(num_classes, 0);
+    for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+      addToSums(float_sums.data(), compact_forest->getLeafValues(tree_idx, terminal_nodeIDs[tree_idx]), num_classes);
+    }
+    double total = (double) num_trees * FIXED_POINT_ONE;
+    double deviation = 0;
+    for (size_t class_idx = 0; class_idx < num_classes; ++class_idx) {
+      deviation = std::max(deviation, std::abs(float_sums[class_idx] / num_trees - sums[class_idx] / total));
+    }
+    fixed_point_deviations[sample_idx] = deviation;
+    int float_mask_value = std::round(float_sums[0] / num_trees * -255) + 255;
+    fixed_point_mask_deviations[sample_idx] = std::abs(float_mask_value - fixedPointMaskValue(sums[0]));
+  }
+}
+
+void ForestProbability::finishFixedPointPrediction() {
+  if (predict_all || prediction_type == TERMINALNODES) {
+    return;
+  }
+
+  // Probabilities for the prediction file
+  size_t num_classes = class_values.size();
+  double total = (double) num_trees * FIXED_POINT_ONE;
+  for (size_t sample_idx = 0; sample_idx < predictions[0].size(); ++sample_idx) {
+    const uint32_t* sums = fixed_point_sums.data() + sample_idx * num_classes;
+    for (size_t class_idx = 0; class_idx < num_classes; ++class_idx) {
+      predictions[0][sample_idx][class_idx] = sums[class_idx] / total;
+    }
+  }
+}
+
+void ForestProbability::loadFromCompactForestInternal() {
+  if (compact_forest->getTreeType() != TREE_PROBABILITY) {
+    throw std::runtime_error("Wrong treetype. Loaded file is not a probability estimation forest.");
+  }
+  class_values = compact_forest->getClassValues();
+}
+
+std::unique_ptr<CompactForestBuilder> ForestProbability::createCompactForestBuilder() {
+  return make_unique_ranger<CompactForestBuilder>(TREE_PROBABILITY, num_independent_variables,
+      dependent_variable_names, data->getIsOrderedVariable(), class_values, class_values.size());
+}
+
+void ForestProbability::appendLeafValues(size_t tree_idx, size_t nodeID, std::vector<double>& leaf_values) const {
+  const auto& tree = dynamic_cast<const TreeProbability&>(*trees[tree_idx]);
+  const std::vector<double>& counts = tree.getTerminalClassCounts()[nodeID];
+  for (size_t class_idx = 0; class_idx < class_values.size(); ++class_idx) {
+    leaf_values.push_back(class_idx < counts.size() ? counts[class_idx] : 0);
+  }
+}
+
 const std::vector<double>& ForestProbability::getTreePrediction(size_t tree_idx, size_t sample_idx) const {
   const auto& tree = dynamic_cast<const TreeProbability&>(*trees[tree_idx]);
   return tree.getPrediction(sample_idx);
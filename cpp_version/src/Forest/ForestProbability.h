@@ -54,10 +54,16 @@ protected:
   void computePredictionErrorInternal() override;
   void writeOutputInternal() override;
   void writeConfusionFile() override;
-  void writePredictionFile() override;
+  void writePredictions(std::ostream& outfile) override;
   void writeImageMask() override;
   void saveToFileInternal(std::ofstream& outfile) override;
   void loadFromFileInternal(std::ifstream& infile) override;
+  void predictCompactInternal(size_t sample_idx, CompactPredictionBuffers& buffers) override;
+  void initFixedPointPrediction() override;
+  void finishFixedPointPrediction() override;
+  void loadFromCompactForestInternal() override;
+  std::unique_ptr<CompactForestBuilder> createCompactForestBuilder() override;
+  void appendLeafValues(size_t tree_idx, size_t nodeID, std::vector<double>& leaf_values) const override;
 
   // Classes of the dependent variable and classIDs for responses
   std::vector<double> class_values;
@@ -68,6 +74,23 @@ protected:
   std::vector<double> class_weights;
 
 private:
+  void predictFixedPoint(size_t sample_idx, const std::vector<index_t>& terminal_nodeIDs);
+
+  // Mask value 0..255 of the image output for a fixed point sum of the first class
+  uint8_t fixedPointMaskValue(uint64_t sum) const {
+    uint64_t total = (uint64_t) num_trees * FIXED_POINT_ONE;
+    return 255 - (255 * sum + total / 2) / total;
+  }
+
+  // Leaf proportions scaled to FIXED_POINT_ONE for each tree, leaf and class. The sum over 2^16 trees fits 32 bits.
+  static const uint32_t FIXED_POINT_ONE = 1 << 15;
+  std::vector<std::vector<uint16_t>> fixed_point_leaves;
+  std::vector<uint32_t> fixed_point_sums;
+
+  // Maximum absolute difference to the floating point prediction for each sample, for probabilities and mask values
+  std::vector<double> fixed_point_deviations;
+  std::vector<uint8_t> fixed_point_mask_deviations;
+
   const std::vector<double>& getTreePrediction(size_t tree_idx, size_t sample_idx) const;
   size_t getTreePredictionTerminalNodeID(size_t tree_idx, size_t sample_idx) const;
 };
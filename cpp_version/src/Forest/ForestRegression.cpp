@@ -64,9 +64,10 @@ void ForestRegression::initInternal() {
     }
   }
 
-  // Sort data if memory saving mode
-  if (!memory_saving_splitting) {
-    data->sort();
+  // Sort data if memory saving mode, not needed for prediction
+  if (!memory_saving_splitting && !prediction_mode) {
+    PhaseTimer timer(run_stats.get(), PHASE_SORT);
+    data->sort(num_threads);
   }
 }
 
@@ -199,15 +200,7 @@ void ForestRegression::writeImageMask() {
   stbi_image_free(cloud_mask_out);
 }
 
-void ForestRegression::writePredictionFile() {
-
-  // Open prediction file for writing
-  std::string filename = output_prefix + ".prediction";
-  std::ofstream outfile;
-  outfile.open(filename, std::ios::out);
-  if (!outfile.good()) {
-    throw std::runtime_error("Could not write to prediction file: " + filename + ".");
-  }
+void ForestRegression::writePredictions(std::ostream& outfile) {
 
   // Write
   outfile << "Predictions: " << std::endl;
@@ -230,9 +223,6 @@ void ForestRegression::writePredictionFile() {
       }
     }
   }
-
-  if (verbose_out)
-    *verbose_out << "Saved predictions to file " << filename << "." << std::endl;
 }
 
 void ForestRegression::saveToFileInternal(std::ofstream& outfile) {
@@ -278,6 +268,46 @@ void ForestRegression::loadFromFileInternal(std::ifstream& infile) {
   }
 }
 
+void ForestRegression::predictCompactInternal(size_t sample_idx, CompactPredictionBuffers& buffers) {
+  predictCompactTerminalNodes(sample_idx, buffers);
+  const std::vector<index_t>& terminal_nodeIDs = buffers.terminal_nodeIDs;
+
+  if (predict_all || prediction_type == TERMINALNODES) {
+    // Get all tree predictions
+    for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+      size_t nodeID = terminal_nodeIDs[tree_idx];
+      if (prediction_type == TERMINALNODES) {
+        predictions[0][sample_idx][tree_idx] = nodeID;
+      } else {
+        predictions[0][sample_idx][tree_idx] = *compact_forest->getLeafValues(tree_idx, nodeID);
+      }
+    }
+  } else {
+    // Mean over trees
+    double prediction_sum = 0;
+    for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+      size_t nodeID = terminal_nodeIDs[tree_idx];
+      prediction_sum += *compact_forest->getLeafValues(tree_idx, nodeID);
+    }
+    predictions[0][0][sample_idx] = prediction_sum / num_trees;
+  }
+}
+
+void ForestRegression::loadFromCompactForestInternal() {
+  if (compact_forest->getTreeType() != TREE_REGRESSION) {
+    throw std::runtime_error("Wrong treetype. Loaded file is not a regression forest.");
+  }
+}
+
+std::unique_ptr<CompactForestBuilder> ForestRegression::createCompactForestBuilder() {
+  return make_unique_ranger<CompactForestBuilder>(TREE_REGRESSION, num_independent_variables,
+      dependent_variable_names, data->getIsOrderedVariable(), std::vector<double>(), 1);
+}
+
+void ForestRegression::appendLeafValues(size_t tree_idx, size_t nodeID, std::vector<double>& leaf_values) const {
+  leaf_values.push_back(trees[tree_idx]->getSplitValues()[nodeID]);
+}
+
 double ForestRegression::getTreePrediction(size_t tree_idx, size_t sample_idx) const {
   const auto& tree = dynamic_cast<const TreeRegression&>(*trees[tree_idx]);
   return tree.getPrediction(sample_idx);
@@ -41,10 +41,14 @@ private:
   void computePredictionErrorInternal() override;
   void writeOutputInternal() override;
   void writeConfusionFile() override;
-  void writePredictionFile() override;
+  void writePredictions(std::ostream& outfile) override;
   void writeImageMask() override;
   void saveToFileInternal(std::ofstream& outfile) override;
   void loadFromFileInternal(std::ifstream& infile) override;
+  void predictCompactInternal(size_t sample_idx, CompactPredictionBuffers& buffers) override;
+  void loadFromCompactForestInternal() override;
+  std::unique_ptr<CompactForestBuilder> createCompactForestBuilder() override;
+  void appendLeafValues(size_t tree_idx, size_t nodeID, std::vector<double>& leaf_values) const override;
 
 private:
   double getTreePrediction(size_t tree_idx, size_t sample_idx) const;
@@ -88,9 +88,10 @@ void ForestSurvival::initInternal() {
     }
   }
 
-  // Sort data if extratrees and not memory saving mode
-  if (splitrule == EXTRATREES && !memory_saving_splitting) {
-    data->sort();
+  // Sort data if extratrees or maxstat and not memory saving mode, not needed for prediction
+  if ((splitrule == EXTRATREES || splitrule == MAXSTAT) && !memory_saving_splitting && !prediction_mode) {
+    PhaseTimer timer(run_stats.get(), PHASE_SORT);
+    data->sort(num_threads);
   }
 }
 
@@ -164,7 +165,7 @@ void ForestSurvival::computePredictionErrorInternal() {
   // Divide sample predictions by number of trees where sample is oob and compute summed chf for samples
   std::vector<double> sum_chf;
   sum_chf.reserve(predictions[0].size());
-  std::vector<size_t> oob_sampleIDs;
+  std::vector<index_t> oob_sampleIDs;
   oob_sampleIDs.reserve(predictions[0].size());
   for (size_t i = 0; i < predictions[0].size(); ++i) {
     if (samples_oob_count[i] > 0) {
@@ -242,15 +243,7 @@ void ForestSurvival::writeImageMask() {
   stbi_image_free(cloud_mask_out);
 }
 
-void ForestSurvival::writePredictionFile() {
-
-  // Open prediction file for writing
-  std::string filename = output_prefix + ".prediction";
-  std::ofstream outfile;
-  outfile.open(filename, std::ios::out);
-  if (!outfile.good()) {
-    throw std::runtime_error("Could not write to prediction file: " + filename + ".");
-  }
+void ForestSurvival::writePredictions(std::ostream& outfile) {
 
   // Write
   outfile << "Unique timepoints: " << std::endl;
@@ -281,9 +274,6 @@ void ForestSurvival::writePredictionFile() {
       }
     }
   }
-
-  if (verbose_out)
-    *verbose_out << "Saved predictions to file " << filename << "." << std::endl;
 }
 
 void ForestSurvival::saveToFileInternal(std::ofstream& outfile) {
@@ -354,6 +344,24 @@ void ForestSurvival::loadFromFileInternal(std::ifstream& infile) {
   }
 }
 
+void ForestSurvival::predictCompactInternal(size_t sample_idx, CompactPredictionBuffers& buffers) {
+  throw std::runtime_error("Version 2 forest files are not supported for survival forests.");
+}
+
+void ForestSurvival::loadFromCompactForestInternal() {
+  throw std::runtime_error("Version 2 forest files are not supported for survival forests.");
+}
+
+std::unique_ptr<CompactForestBuilder> ForestSurvival::createCompactForestBuilder() {
+  throw std::runtime_error("Version 2 forest files are not supported for survival forests.");
+}
+
+void ForestSurvival::appendLeafValues(size_t tree_idx, size_t nodeID, std::vector<double>& leaf_values) const {
+  const auto& tree = dynamic_cast<const TreeSurvival&>(*trees[tree_idx]);
+  const std::vector<double>& chf = tree.getChf()[nodeID];
+  leaf_values.insert(leaf_values.end(), chf.begin(), chf.end());
+}
+
 const std::vector<double>& ForestSurvival::getTreePrediction(size_t tree_idx, size_t sample_idx) const {
   const auto& tree = dynamic_cast<const TreeSurvival&>(*trees[tree_idx]);
   return tree.getPrediction(sample_idx);
@@ -0,0 +1,203 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "QuickScorer.h"
+#include "Simd.h"
+
+namespace ranger {
+
+// Index of lowest set bit, word must not be 0
+inline size_t lowestSetBit(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(word);
+#else
+  // #nocov start
+  size_t result = 0;
+  while (!(word & 1)) {
+    word >>= 1;
+    ++result;
+  }
+  return result;
+  // #nocov end
+#endif
+}
+
+// Smallest float not less than value. For float thresholds value <= threshold is equal to the result <= threshold.
+inline float roundUpToFloat(double value) {
+  float result = value;
+  if (result < value) {
+    result = std::nextafter(result, std::numeric_limits<float>::infinity());
+  }
+  return result;
+}
+
+QuickScorer::QuickScorer(const CompactForest& forest) :
+    forest(forest), num_trees(forest.getNumTrees()), num_truncated_trees(0) {
+
+  size_t num_variables = forest.getNumIndependentVariables();
+  std::vector<std::vector<OrderedCondition>> ordered(num_variables);
+  std::vector<std::vector<UnorderedCondition>> unordered(num_variables);
+
+  leaf_nodeIDs.reserve(num_trees * 64);
+  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+    addTree(forest, tree_idx, ordered, unordered);
+  }
+
+  // Flatten conditions, only keep variables used for splitting
+  ordered_offsets.push_back(0);
+  unordered_offsets.push_back(0);
+  for (size_t varID = 0; varID < num_variables; ++varID) {
+    if (ordered[varID].empty() && unordered[varID].empty()) {
+      continue;
+    }
+    std::stable_sort(ordered[varID].begin(), ordered[varID].end(),
+        [](const OrderedCondition& a, const OrderedCondition& b) {return a.split_value < b.split_value;});
+    varIDs.push_back(varID);
+    ordered_conditions.insert(ordered_conditions.end(), ordered[varID].begin(), ordered[varID].end());
+    for (auto& condition : ordered[varID]) {
+      if (forest.getSplitValues(0)) {
+        ordered_split_values_double.push_back(condition.split_value);
+      } else {
+        ordered_split_values.push_back(condition.split_value);
+      }
+    }
+    ordered_offsets.push_back(ordered_conditions.size());
+    unordered_conditions.insert(unordered_conditions.end(), unordered[varID].begin(), unordered[varID].end());
+    unordered_offsets.push_back(unordered_conditions.size());
+  }
+}
+
+void QuickScorer::predictTerminalNodes(const Data* data, size_t sample_idx, std::vector<index_t>& terminal_nodeIDs,
+    std::vector<uint64_t>& leaf_bitvectors) const {
+  leaf_bitvectors.assign(num_trees, ~0ULL);
+  uint64_t* bitvectors = leaf_bitvectors.data();
+
+  for (size_t i = 0; i < varIDs.size(); ++i) {
+    double value = data->get_x(sample_idx, varIDs[i]);
+
+    // Left is <= splitval, the sample goes right at all nodes before the first one it goes left (NaN goes right
+    // everywhere). Float thresholds are compared in batches, with the value rounded up.
+    size_t num_right = ordered_offsets[i + 1] - ordered_offsets[i];
+    if (!std::isnan(value)) {
+      if (!ordered_split_values_double.empty()) {
+        const double* split_values = ordered_split_values_double.data() + ordered_offsets[i];
+        num_right = std::lower_bound(split_values, split_values + num_right, value) - split_values;
+      } else {
+        num_right = countSortedBelow(ordered_split_values.data() + ordered_offsets[i], num_right,
+            roundUpToFloat(value));
+      }
+    }
+    for (size_t j = ordered_offsets[i]; j < ordered_offsets[i] + num_right; ++j) {
+      const OrderedCondition& condition = ordered_conditions[j];
+      bitvectors[condition.tree_idx] &= condition.leaf_mask;
+    }
+
+    for (size_t j = unordered_offsets[i]; j < unordered_offsets[i + 1]; ++j) {
+      const UnorderedCondition& condition = unordered_conditions[j];
+      size_t factorID = floor(value) - 1;
+      if (condition.split_mask & (1ULL << factorID)) {
+        bitvectors[condition.tree_idx] &= condition.leaf_mask;
+      }
+    }
+  }
+
+  // Terminal node is the leftmost leaf not removed, traverse on from frontier nodes of truncated trees
+  terminal_nodeIDs.resize(num_trees);
+  for (size_t tree_idx = 0; tree_idx < num_trees; ++tree_idx) {
+    size_t nodeID = leaf_nodeIDs[tree_idx * 64 + lowestSetBit(bitvectors[tree_idx])];
+    if (forest.getNodes(tree_idx)[nodeID].left_child != 0) {
+      nodeID = forest.predictTerminalNode(tree_idx, data, sample_idx, nodeID);
+    }
+    terminal_nodeIDs[tree_idx] = nodeID;
+  }
+}
+
+void QuickScorer::addTree(const CompactForest& forest, size_t tree_idx,
+    std::vector<std::vector<OrderedCondition>>& ordered, std::vector<std::vector<UnorderedCondition>>& unordered) {
+  const CompactNode* nodes = forest.getNodes(tree_idx);
+  size_t num_nodes = forest.getNumNodes(tree_idx);
+
+  // Children always have larger nodeIDs than their parent. Count nodes and leaves per depth ...
+  std::vector<uint32_t> depths(num_nodes, 0);
+  std::vector<size_t> num_nodes_depth(1, 0);
+  std::vector<size_t> num_leaves_depth(1, 0);
+  for (size_t nodeID = 0; nodeID < num_nodes; ++nodeID) {
+    size_t depth = depths[nodeID];
+    if (depth >= num_nodes_depth.size()) {
+      num_nodes_depth.resize(depth + 1, 0);
+      num_leaves_depth.resize(depth + 1, 0);
+    }
+    ++num_nodes_depth[depth];
+    if (nodes[nodeID].left_child == 0) {
+      ++num_leaves_depth[depth];
+    } else {
+      depths[nodes[nodeID].left_child] = depth + 1;
+      depths[nodes[nodeID].left_child + 1] = depth + 1;
+    }
+  }
+
+  // ... and find the deepest frontier with at most 64 nodes, the root is always possible
+  size_t max_depth = 0;
+  size_t num_leaves_above = 0;
+  for (size_t depth = 1; depth < num_nodes_depth.size(); ++depth) {
+    num_leaves_above += num_leaves_depth[depth - 1];
+    if (num_leaves_above + num_nodes_depth[depth] > 64) {
+      break;
+    }
+    max_depth = depth;
+  }
+  if (max_depth + 1 < num_nodes_depth.size()) {
+    ++num_truncated_trees;
+  }
+
+  // Count frontier nodes in each subtree bottom up ...
+  std::vector<uint32_t> num_leaves(num_nodes, 1);
+  for (size_t nodeID = num_nodes; nodeID-- > 0;) {
+    if (nodes[nodeID].left_child != 0 && depths[nodeID] < max_depth) {
+      num_leaves[nodeID] = num_leaves[nodes[nodeID].left_child] + num_leaves[nodes[nodeID].left_child + 1];
+    }
+  }
+
+  // ... and number them from left to right top down
+  std::vector<uint32_t> first_leaf(num_nodes, 0);
+  size_t leaf_offset = leaf_nodeIDs.size();
+  leaf_nodeIDs.resize(leaf_offset + 64, 0);
+  for (size_t nodeID = 0; nodeID < num_nodes; ++nodeID) {
+    const CompactNode& node = nodes[nodeID];
+    if (depths[nodeID] > max_depth) {
+      continue;
+    }
+    if (node.left_child == 0 || depths[nodeID] == max_depth) {
+      leaf_nodeIDs[leaf_offset + first_leaf[nodeID]] = nodeID;
+      continue;
+    }
+
+    size_t left = node.left_child;
+    first_leaf[left] = first_leaf[nodeID];
+    first_leaf[left + 1] = first_leaf[nodeID] + num_leaves[left];
+
+    // Going right removes the left subtree
+    size_t num_removed = num_leaves[left];
+    uint64_t leaf_mask = ~((num_removed == 64 ? ~0ULL : (1ULL << num_removed) - 1) << first_leaf[nodeID]);
+    if (forest.isOrderedVariable(node.varID)) {
+      double split_value = forest.getSplitValues(tree_idx) ? forest.getSplitValues(tree_idx)[nodeID] : node.split_value;
+      ordered[node.varID].push_back( { split_value, (uint32_t) tree_idx, leaf_mask });
+    } else {
+      unordered[node.varID].push_back( { forest.getSplitMask(node.split_mask), (uint32_t) tree_idx, leaf_mask });
+    }
+  }
+}
+
+} // namespace ranger
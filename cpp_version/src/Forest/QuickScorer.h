@@ -0,0 +1,83 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef QUICKSCORER_H_
+#define QUICKSCORER_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "globals.h"
+#include "Data.h"
+#include "CompactForest.h"
+
+namespace ranger {
+
+// Prediction engine after Lucchese et al. (2015), QuickScorer. Instead of traversing each tree, the split nodes of
+// all trees are grouped by variable and sorted by threshold. For a sample, only the nodes where the sample goes right
+// are visited and each of them removes the leaves of its left subtree from a 64 bit leaf bitvector of the tree. The
+// leftmost remaining leaf is the terminal node. Trees with more than 64 leaves are only scored down to the deepest
+// level with at most 64 nodes on the frontier (leaves above it and nodes at that level), the remaining levels
+// below a frontier node are traversed.
+class QuickScorer {
+public:
+  QuickScorer(const CompactForest& forest);
+
+  QuickScorer(const QuickScorer&) = delete;
+  QuickScorer& operator=(const QuickScorer&) = delete;
+
+  // Terminal nodeIDs of all trees for a sample, identical to CompactForest::predictTerminalNodes()
+  void predictTerminalNodes(const Data* data, size_t sample_idx, std::vector<index_t>& terminal_nodeIDs,
+      std::vector<uint64_t>& leaf_bitvectors) const;
+
+  // Number of trees not scored completely, for these the deeper levels are traversed
+  size_t getNumTruncatedTrees() const {
+    return num_truncated_trees;
+  }
+
+private:
+  // Split node, if the sample goes right the leaves not in leaf_mask are unreachable
+  struct OrderedCondition {
+    double split_value;
+    uint32_t tree_idx;
+    uint64_t leaf_mask;
+  };
+
+  struct UnorderedCondition {
+    uint64_t split_mask;
+    uint32_t tree_idx;
+    uint64_t leaf_mask;
+  };
+
+  void addTree(const CompactForest& forest, size_t tree_idx, std::vector<std::vector<OrderedCondition>>& ordered,
+      std::vector<std::vector<UnorderedCondition>>& unordered);
+
+  const CompactForest& forest;
+  size_t num_trees;
+  size_t num_truncated_trees;
+
+  // NodeID of each frontier node in left to right order, 64 entries per tree
+  std::vector<index_t> leaf_nodeIDs;
+
+  // Conditions grouped by variable, ordered conditions sorted by split value. The split values are kept as floats
+  // unless the forest has double split values.
+  std::vector<size_t> varIDs;
+  std::vector<size_t> ordered_offsets;
+  std::vector<OrderedCondition> ordered_conditions;
+  std::vector<float> ordered_split_values;
+  std::vector<double> ordered_split_values_double;
+  std::vector<size_t> unordered_offsets;
+  std::vector<UnorderedCondition> unordered_conditions;
+};
+
+} // namespace ranger
+
+#endif /* QUICKSCORER_H_ */
@@ -9,39 +9,52 @@
  R package "ranger" under GPL3 license.
  #-------------------------------------------------------------------------------*/
 
+#include <algorithm>
 #include <iterator>
+#include <numeric>
 
 #include "Tree.h"
 #include "utility.h"
+#include "Simd.h"
 
 namespace ranger {
 
+constexpr index_t Tree::NO_LEVEL_NODE;
+constexpr size_t Tree::NO_LEVEL_VARIABLE;
+
 Tree::Tree() :
     mtry(0), num_samples(0), num_samples_oob(0), min_node_size(0), deterministic_varIDs(0), split_select_weights(0), case_weights(
-        0), manual_inbag(0), oob_sampleIDs(0), holdout(false), keep_inbag(false), data(0), regularization_factor(0), regularization_usedepth(
-        false), split_varIDs_used(0), variable_importance(0), importance_mode(DEFAULT_IMPORTANCE_MODE), sample_with_replacement(
+        0), case_weights_alias(0), manual_inbag(0), num_presorted_variables(0), oob_sampleIDs(0), has_oob_sampleIDs(false), holdout(false), keep_inbag(
+        false), seed(0), data(0), regularization_factor(0), regularization_usedepth(false), regularization_state(0), tree_idx(0), variable_importance(0), importance_mode(DEFAULT_IMPORTANCE_MODE), sample_with_replacement(
         true), sample_fraction(0), memory_saving_splitting(false), splitrule(DEFAULT_SPLITRULE), alpha(DEFAULT_ALPHA), minprop(
         DEFAULT_MINPROP), num_random_splits(DEFAULT_NUM_RANDOM_SPLITS), max_depth(DEFAULT_MAXDEPTH), depth(0), last_left_nodeID(
-        0) {
+        0), level_wise_growth(false), level_start(0), level_values_varID(
+        NO_LEVEL_VARIABLE), stats(0) {
 }
 
 Tree::Tree(std::vector<std::vector<size_t>>& child_nodeIDs, std::vector<size_t>& split_varIDs,
     std::vector<double>& split_values) :
     mtry(0), num_samples(0), num_samples_oob(0), min_node_size(0), deterministic_varIDs(0), split_select_weights(0), case_weights(
-        0), manual_inbag(0), split_varIDs(split_varIDs), split_values(split_values), child_nodeIDs(child_nodeIDs), oob_sampleIDs(
-        0), holdout(false), keep_inbag(false), data(0), regularization_factor(0), regularization_usedepth(false), split_varIDs_used(
-        0), variable_importance(0), importance_mode(DEFAULT_IMPORTANCE_MODE), sample_with_replacement(true), sample_fraction(
+        0), case_weights_alias(0), manual_inbag(0), split_varIDs(split_varIDs.begin(), split_varIDs.end()), split_values(
+        split_values), num_presorted_variables(0), oob_sampleIDs(0), has_oob_sampleIDs(false), holdout(false), keep_inbag(false), seed(0), data(0), regularization_factor(
+        0), regularization_usedepth(false), regularization_state(0), tree_idx(0), variable_importance(0), importance_mode(DEFAULT_IMPORTANCE_MODE), sample_with_replacement(true), sample_fraction(
         0), memory_saving_splitting(false), splitrule(DEFAULT_SPLITRULE), alpha(DEFAULT_ALPHA), minprop(
         DEFAULT_MINPROP), num_random_splits(DEFAULT_NUM_RANDOM_SPLITS), max_depth(DEFAULT_MAXDEPTH), depth(0), last_left_nodeID(
-        0) {
+        0), level_wise_growth(false), level_start(0), level_values_varID(
+        NO_LEVEL_VARIABLE), stats(0) {
+  // Narrow loaded node indices to index_t
+  this->child_nodeIDs.reserve(child_nodeIDs.size());
+  for (auto& child_nodes : child_nodeIDs) {
+    this->child_nodeIDs.push_back(std::vector<index_t>(child_nodes.begin(), child_nodes.end()));
+  }
 }
 
-void Tree::init(const Data* data, uint mtry, size_t num_samples, uint seed, std::vector<size_t>* deterministic_varIDs,
+void Tree::init(const Data* data, uint mtry, size_t num_samples, uint64_t seed, std::vector<size_t>* deterministic_varIDs,
     std::vector<double>* split_select_weights, ImportanceMode importance_mode, uint min_node_size,
     bool sample_with_replacement, bool memory_saving_splitting, SplitRule splitrule, std::vector<double>* case_weights,
-    std::vector<size_t>* manual_inbag, bool keep_inbag, std::vector<double>* sample_fraction, double alpha,
-    double minprop, bool holdout, uint num_random_splits, uint max_depth, std::vector<double>* regularization_factor,
-    bool regularization_usedepth, std::vector<bool>* split_varIDs_used) {
+    const AliasTable* case_weights_alias, std::vector<size_t>* manual_inbag, bool keep_inbag,
+    std::vector<double>* sample_fraction, double alpha, double minprop, bool holdout, uint num_random_splits, uint max_depth, std::vector<double>* regularization_factor,
+    bool regularization_usedepth, RegularizationState* regularization_state, size_t tree_idx) {
 
   this->data = data;
   this->mtry = mtry;
@@ -49,12 +62,13 @@ void Tree::init(const Data* data, uint mtry, size_t num_samples, uint seed, std:
   this->memory_saving_splitting = memory_saving_splitting;
 
   // Create root node, assign bootstrap sample and oob samples
-  child_nodeIDs.push_back(std::vector<size_t>());
-  child_nodeIDs.push_back(std::vector<size_t>());
+  child_nodeIDs.push_back(std::vector<index_t>());
+  child_nodeIDs.push_back(std::vector<index_t>());
   createEmptyNode();
 
   // Initialize random number generator and set seed
-  random_number_generator.seed(seed);
+  random_number_generator.seed(seed, BOOTSTRAP_STREAM);
+  this->seed = seed;
 
   this->deterministic_varIDs = deterministic_varIDs;
   this->split_select_weights = split_select_weights;
@@ -63,6 +77,7 @@ void Tree::init(const Data* data, uint mtry, size_t num_samples, uint seed, std:
   this->sample_with_replacement = sample_with_replacement;
   this->splitrule = splitrule;
   this->case_weights = case_weights;
+  this->case_weights_alias = case_weights_alias;
   this->manual_inbag = manual_inbag;
   this->keep_inbag = keep_inbag;
   this->sample_fraction = sample_fraction;
@@ -73,7 +88,8 @@ void Tree::init(const Data* data, uint mtry, size_t num_samples, uint seed, std:
   this->max_depth = max_depth;
   this->regularization_factor = regularization_factor;
   this->regularization_usedepth = regularization_usedepth;
-  this->split_varIDs_used = split_varIDs_used;
+  this->regularization_state = regularization_state;
+  this->tree_idx = tree_idx;
 
   // Regularization
   if (regularization_factor->size() > 0) {
@@ -89,38 +105,58 @@ void Tree::grow(std::vector<double>* variable_importance) {
 
   this->variable_importance = variable_importance;
 
-  // Bootstrap, dependent if weighted or not and with or without replacement
-  if (!case_weights->empty()) {
-    if (sample_with_replacement) {
-      bootstrapWeighted();
-    } else {
-      bootstrapWithoutReplacementWeighted();
-    }
-  } else if (sample_fraction->size() > 1) {
-    if (sample_with_replacement) {
-      bootstrapClassWise();
-    } else {
-      bootstrapWithoutReplacementClassWise();
-    }
-  } else if (!manual_inbag->empty()) {
-    setManualInbag();
-  } else {
-    if (sample_with_replacement) {
-      bootstrap();
-    } else {
-      bootstrapWithoutReplacement();
+  if (regularization) {
+    split_varIDs_used.assign(regularization_factor->size(), false);
+  }
+
+  double start_time = 0;
+  if (stats) {
+    start_time = RunStats::wallTime();
+  }
+
+  drawBootstrapSample();
+
+  // Inbag counts are only stored if requested
+  if (keep_inbag) {
+    inbag_counts.resize(num_samples, 0);
+    for (auto& sampleID : sampleIDs) {
+      ++inbag_counts[sampleID];
     }
   }
 
+  if (stats) {
+    stats->bootstrap_seconds = RunStats::wallTime() - start_time;
+  }
+
   // Init start and end positions
   start_pos[0] = 0;
   end_pos[0] = sampleIDs.size();
 
+  // Sort once for maximally selected rank statistics
+  if (splitrule == MAXSTAT && !memory_saving_splitting) {
+    presortSampleIDs();
+  }
+
+  // Node histograms read the classes contiguously
+  if (!memory_saving_splitting) {
+    initSampleClassIDs();
+  }
+
+  // Regularization depends on the order of the splits
+  bool level_wise = level_wise_growth && supportsLevelWiseGrowth() && !regularization;
+  size_t next_level_start = 0;
+
   // While not all nodes terminal, split next node
   size_t num_open_nodes = 1;
   size_t i = 0;
   depth = 0;
   while (num_open_nodes > 0) {
+    // Nodes are numbered by level, all nodes of the next level exist when its first node is reached
+    if (level_wise && i == next_level_start) {
+      next_level_start = split_varIDs.size();
+      prepareLevel(i, next_level_start);
+    }
+
     // Split node
     bool is_terminal_node = splitNode(i);
     if (is_terminal_node) {
@@ -137,9 +173,39 @@ void Tree::grow(std::vector<double>* variable_importance) {
     ++i;
   }
 
+  if (stats) {
+    stats->grow_seconds = RunStats::wallTime() - start_time;
+    stats->num_nodes = split_varIDs.size();
+    stats->depth = depth;
+  }
+
   // Delete sampleID vector to save memory
   sampleIDs.clear();
   sampleIDs.shrink_to_fit();
+  presorted_sampleIDs.clear();
+  presorted_sampleIDs.shrink_to_fit();
+  sample_classIDs.clear();
+  sample_classIDs.shrink_to_fit();
+  presorted_buffer.clear();
+  presorted_buffer.shrink_to_fit();
+  presorted_right_child.clear();
+  presorted_right_child.shrink_to_fit();
+  presorted_scores.clear();
+  presorted_scores.shrink_to_fit();
+  split_varIDs_used.clear();
+  split_varIDs_used.shrink_to_fit();
+  level_sampleIDs.clear();
+  level_sampleIDs.shrink_to_fit();
+  level_node_of_sample.clear();
+  level_node_of_sample.shrink_to_fit();
+  level_sample_counts.clear();
+  level_sample_counts.shrink_to_fit();
+  level_node_slots.clear();
+  level_node_slots.shrink_to_fit();
+  level_values.clear();
+  level_values.shrink_to_fit();
+  level_splits.clear();
+  level_splits.shrink_to_fit();
   cleanUpInternal();
 }
 
@@ -147,6 +213,7 @@ void Tree::predict(const Data* prediction_data, bool oob_prediction) {
 
   size_t num_samples_predict;
   if (oob_prediction) {
+    createOobSampleIDs();
     num_samples_predict = num_samples_oob;
   } else {
     num_samples_predict = prediction_data->getNumRows();
@@ -201,43 +268,73 @@ void Tree::predict(const Data* prediction_data, bool oob_prediction) {
   }
 }
 
-void Tree::computePermutationImportance(std::vector<double>& forest_importance, std::vector<double>& forest_variance,
-    std::vector<double>& forest_importance_casewise) {
+void Tree::computePermutationImportance(size_t start_varID, size_t end_varID, std::vector<double>& forest_importance,
+    std::vector<double>& forest_variance, std::vector<double>& forest_importance_casewise) const {
 
-  size_t num_independent_variables = data->getNumCols();
+  // Drop OOB samples down the tree once. For each variable in the range, save the OOB samples with a split on the
+  // variable in their path and the first node of that split. Only these samples can be affected by permuting the variable.
+  std::vector<index_t> terminal_nodeIDs(num_samples_oob);
+  std::vector<std::vector<PermutedPath>> permuted_paths(end_varID - start_varID);
+  std::vector<size_t> last_oob_idx(end_varID - start_varID, num_samples_oob);
+  for (size_t i = 0; i < num_samples_oob; ++i) {
+    size_t nodeID = 0;
+    while (child_nodeIDs[0][nodeID] != 0 || child_nodeIDs[1][nodeID] != 0) {
+      size_t split_varID = split_varIDs[nodeID];
+      if (split_varID >= start_varID && split_varID < end_varID && last_oob_idx[split_varID - start_varID] != i) {
+        last_oob_idx[split_varID - start_varID] = i;
+        permuted_paths[split_varID - start_varID].push_back( { (index_t) i, (index_t) nodeID });
+      }
+      nodeID = getChildNodeID(nodeID, data->get_x(oob_sampleIDs[i], split_varID));
+    }
+    terminal_nodeIDs[i] = nodeID;
+  }
 
-  // Compute normal prediction accuracy for each tree. Predictions already computed..
+  // Compute normal prediction accuracy for each tree
   double accuracy_normal;
   std::vector<double> prederr_normal_casewise;
   std::vector<double> prederr_shuf_casewise;
   if (importance_mode == IMP_PERM_CASEWISE) {
     prederr_normal_casewise.resize(num_samples_oob, 0);
     prederr_shuf_casewise.resize(num_samples_oob, 0);
-    accuracy_normal = computePredictionAccuracyInternal(&prederr_normal_casewise);
+    accuracy_normal = computePredictionAccuracyInternal(terminal_nodeIDs, &prederr_normal_casewise);
   } else {
-    accuracy_normal = computePredictionAccuracyInternal(NULL);
+    accuracy_normal = computePredictionAccuracyInternal(terminal_nodeIDs, NULL);
   }
 
-  prediction_terminal_nodeIDs.clear();
-  prediction_terminal_nodeIDs.resize(num_samples_oob, 0);
+  std::vector<index_t> permuted_terminal_nodeIDs(terminal_nodeIDs);
+  std::vector<index_t> permutations;
+
+  // Randomly permute for all independent variables in the range
+  for (size_t i = start_varID; i < end_varID; ++i) {
 
-  // Reserve space for permutations, initialize with oob_sampleIDs
-  std::vector<size_t> permutations(oob_sampleIDs);
+    // Predictions and accuracy are unchanged if no OOB sample passes a split on the variable
+    const std::vector<PermutedPath>& paths = permuted_paths[i - start_varID];
+    if (paths.empty()) {
+      continue;
+    }
 
-  // Randomly permute for all independent variables
-  for (size_t i = 0; i < num_independent_variables; ++i) {
+    // Own random numbers for each variable, independent of the order the variables are computed in
+    RandomGenerator permutation_random_number_generator(seed, VARIABLE_STREAM_START + i);
+    permutations.assign(oob_sampleIDs.begin(), oob_sampleIDs.end());
+    std::shuffle(permutations.begin(), permutations.end(), permutation_random_number_generator);
 
-    // Permute and compute prediction accuracy again for this permutation and save difference
-    permuteAndPredictOobSamples(i, permutations);
+    // Drop affected samples down from the first split on the variable and compute prediction accuracy again
+    for (auto& path : paths) {
+      permuted_terminal_nodeIDs[path.oob_idx] = dropDownSamplePermuted(i, oob_sampleIDs[path.oob_idx],
+          permutations[path.oob_idx], path.nodeID);
+    }
     double accuracy_permuted;
     if (importance_mode == IMP_PERM_CASEWISE) {
-      accuracy_permuted = computePredictionAccuracyInternal(&prederr_shuf_casewise);
+      accuracy_permuted = computePredictionAccuracyInternal(permuted_terminal_nodeIDs, &prederr_shuf_casewise);
       for (size_t j = 0; j < num_samples_oob; ++j) {
         size_t pos = i * num_samples + oob_sampleIDs[j];
         forest_importance_casewise[pos] += prederr_shuf_casewise[j] - prederr_normal_casewise[j];
       }
     } else {
-      accuracy_permuted = computePredictionAccuracyInternal(NULL);
+      accuracy_permuted = computePredictionAccuracyInternal(permuted_terminal_nodeIDs, NULL);
+    }
+    for (auto& path : paths) {
+      permuted_terminal_nodeIDs[path.oob_idx] = terminal_nodeIDs[path.oob_idx];
     }
 
     double accuracy_difference = accuracy_normal - accuracy_permuted;
@@ -255,9 +352,13 @@ void Tree::computePermutationImportance(std::vector<double>& forest_importance,
 // #nocov start
 void Tree::appendToFile(std::ofstream& file) {
 
-  // Save general fields
-  saveVector2D(child_nodeIDs, file);
-  saveVector1D(split_varIDs, file);
+  // Save general fields, indices are written as size_t to keep the file format independent of index_t
+  std::vector<std::vector<size_t>> child_nodeIDs_file;
+  for (auto& child_nodes : child_nodeIDs) {
+    child_nodeIDs_file.push_back(std::vector<size_t>(child_nodes.begin(), child_nodes.end()));
+  }
+  saveVector2D(child_nodeIDs_file, file);
+  saveVector1D(std::vector<size_t>(split_varIDs.begin(), split_varIDs.end()), file);
   saveVector1D(split_values, file);
 
   // Call special functions for subclasses to save special fields.
@@ -291,6 +392,9 @@ void Tree::createPossibleSplitVarSubset(std::vector<size_t>& result) {
 
 bool Tree::splitNode(size_t nodeID) {
 
+  // Own random numbers for each node, independent of the order the nodes are split in
+  random_number_generator.seed(seed, NODE_STREAM_START + nodeID);
+
   // Select random subset of variables to possibly split at
   std::vector<size_t> possible_split_varIDs;
   createPossibleSplitVarSubset(possible_split_varIDs);
@@ -332,6 +436,9 @@ bool Tree::splitNode(size_t nodeID) {
         // If going to right, move to right end
         --start_pos[right_child_nodeID];
         std::swap(sampleIDs[pos], sampleIDs[start_pos[right_child_nodeID]]);
+        if (!sample_classIDs.empty()) {
+          std::swap(sample_classIDs[pos], sample_classIDs[start_pos[right_child_nodeID]]);
+        }
       }
     }
   } else {
@@ -351,6 +458,9 @@ bool Tree::splitNode(size_t nodeID) {
         // If going to right, move to right end
         --start_pos[right_child_nodeID];
         std::swap(sampleIDs[pos], sampleIDs[start_pos[right_child_nodeID]]);
+        if (!sample_classIDs.empty()) {
+          std::swap(sample_classIDs[pos], sample_classIDs[start_pos[right_child_nodeID]]);
+        }
       }
     }
   }
@@ -359,201 +469,483 @@ bool Tree::splitNode(size_t nodeID) {
   end_pos[left_child_nodeID] = start_pos[right_child_nodeID];
   end_pos[right_child_nodeID] = end_pos[nodeID];
 
+  if (!presorted_sampleIDs.empty()) {
+    partitionPresortedSampleIDs(nodeID, right_child_nodeID);
+  }
+
   // No terminal node
   return false;
 }
 
-void Tree::createEmptyNode() {
-  split_varIDs.push_back(0);
-  split_values.push_back(0);
-  child_nodeIDs[0].push_back(0);
-  child_nodeIDs[1].push_back(0);
-  start_pos.push_back(0);
-  end_pos.push_back(0);
-
-  createEmptyNodeInternal();
+bool Tree::isPureNode(size_t nodeID, double& pure_value) const {
+  pure_value = 0;
+  for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+    size_t sampleID = sampleIDs[pos];
+    double value = data->get_y(sampleID, 0);
+    if (pos != start_pos[nodeID] && value != pure_value) {
+      return false;
+    }
+    pure_value = value;
+  }
+  return true;
 }
 
-size_t Tree::dropDownSamplePermuted(size_t permuted_varID, size_t sampleID, size_t permuted_sampleID) {
+void Tree::prepareLevel(size_t level_start, size_t level_end) {
+  size_t num_level_nodes = level_end - level_start;
+  this->level_start = level_start;
+  level_splits.clear();
+  level_splits.resize(num_level_nodes);
+
+  // Remove the samples of the previous level
+  level_node_of_sample.resize(num_samples, NO_LEVEL_NODE);
+  level_sample_counts.resize(num_samples, 0);
+  for (auto& sampleID : level_sampleIDs) {
+    level_node_of_sample[sampleID] = NO_LEVEL_NODE;
+    level_sample_counts[sampleID] = 0;
+  }
+  level_sampleIDs.clear();
 
-  // Start in root and drop down
-  size_t nodeID = 0;
-  while (child_nodeIDs[0][nodeID] != 0 || child_nodeIDs[1][nodeID] != 0) {
+  // Nodes at maximal depth are not split
+  if (max_depth > 0 && depth >= max_depth) {
+    return;
+  }
 
-    // Permute if variable is permutation variable
-    size_t split_varID = split_varIDs[nodeID];
-    size_t sampleID_final = sampleID;
-    if (split_varID == permuted_varID) {
-      sampleID_final = permuted_sampleID;
+  // Draw the split variables of each node as splitNode() does, skip nodes that will not be split
+  size_t num_vars = data->getNumCols();
+  if (importance_mode == IMP_GINI_CORRECTED) {
+    num_vars += data->getNumCols();
+  }
+  std::vector<std::vector<size_t>> level_nodes_per_variable(num_vars);
+  std::vector<size_t> num_samples_per_variable(num_vars, 0);
+  size_t num_samples_level = 0;
+  for (size_t level_node = 0; level_node < num_level_nodes; ++level_node) {
+    size_t nodeID = level_start + level_node;
+    size_t num_samples_node = end_pos[nodeID] - start_pos[nodeID];
+    double pure_value;
+    if (num_samples_node <= min_node_size || isPureNode(nodeID, pure_value)) {
+      continue;
     }
 
-    // Move to child
-    double value = data->get_x(sampleID_final, split_varID);
-    if (data->isOrderedVariable(split_varID)) {
-      if (value <= split_values[nodeID]) {
-        // Move to left child
-        nodeID = child_nodeIDs[0][nodeID];
-      } else {
-        // Move to right child
-        nodeID = child_nodeIDs[1][nodeID];
+    random_number_generator.seed(seed, NODE_STREAM_START + nodeID);
+    std::vector<size_t> possible_split_varIDs;
+    createPossibleSplitVarSubset(possible_split_varIDs);
+
+    bool prepared = false;
+    for (auto& varID : possible_split_varIDs) {
+      bool batched = memory_saving_splitting ? !data->isSnpVariable(varID) :
+          data->getNumUniqueDataValues(varID) <= num_samples_node;
+      if (data->isOrderedVariable(varID) && batched) {
+        level_nodes_per_variable[varID].push_back(level_node);
+        num_samples_per_variable[varID] += num_samples_node;
+        prepared = true;
       }
-    } else {
-      size_t factorID = floor(value) - 1;
-      size_t splitID = floor(split_values[nodeID]);
+    }
+    if (prepared) {
+      num_samples_level += num_samples_node;
+    }
+  }
 
-      // Left if 0 found at position factorID
-      if (!(splitID & (1ULL << factorID))) {
-        // Move to left child
-        nodeID = child_nodeIDs[0][nodeID];
-      } else {
-        // Move to right child
-        nodeID = child_nodeIDs[1][nodeID];
+  // A pass visits all samples of the level, variables drawn for only a few nodes are left to splitNode()
+  bool prepared = false;
+  for (size_t varID = 0; varID < num_vars; ++varID) {
+    if (2 * num_samples_per_variable[varID] < num_samples_level) {
+      level_nodes_per_variable[varID].clear();
+    }
+    prepared |= !level_nodes_per_variable[varID].empty();
+  }
+
+  if (!prepared) {
+    return;
+  }
+  if (memory_saving_splitting) {
+    prepareLevelValues(num_level_nodes, level_nodes_per_variable);
+    return;
+  }
+
+  for (size_t varID = 0; varID < num_vars; ++varID) {
+    for (auto& level_node : level_nodes_per_variable[varID]) {
+      size_t nodeID = level_start + level_node;
+      if (level_sample_counts[sampleIDs[start_pos[nodeID]]] > 0) {
+        continue;
+      }
+      for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+        size_t sampleID = sampleIDs[pos];
+        level_node_of_sample[sampleID] = level_node;
+        ++level_sample_counts[sampleID];
       }
     }
+  }
 
+  // Bootstrapped copies of a sample are counted once with their inbag count
+  for (size_t sampleID = 0; sampleID < num_samples; ++sampleID) {
+    if (level_node_of_sample[sampleID] != NO_LEVEL_NODE) {
+      level_sampleIDs.push_back(sampleID);
+    }
+  }
+
+  // One pass over the level for each variable, in the order of the columns
+  for (size_t varID = 0; varID < num_vars; ++varID) {
+    const std::vector<size_t>& level_nodes = level_nodes_per_variable[varID];
+    if (level_nodes.empty()) {
+      continue;
+    }
+    level_node_slots.assign(num_level_nodes, NO_LEVEL_NODE);
+    for (size_t slot = 0; slot < level_nodes.size(); ++slot) {
+      level_node_slots[level_nodes[slot]] = slot;
+    }
+    findBestSplitValuesLevel(varID, level_nodes);
   }
-  return nodeID;
 }
 
-void Tree::permuteAndPredictOobSamples(size_t permuted_varID, std::vector<size_t>& permutations) {
+void Tree::prepareLevelValues(size_t num_level_nodes,
+    const std::vector<std::vector<size_t>>& level_nodes_per_variable) {
 
-  // Permute OOB sample
-  //std::vector<size_t> permutations(oob_sampleIDs);
-  std::shuffle(permutations.begin(), permutations.end(), random_number_generator);
+  // Positions of the prepared nodes ordered by sample with a counting sort, so that the values are read in ascending
+  // order
+  std::vector<bool> is_prepared(num_level_nodes, false);
+  for (auto& level_nodes : level_nodes_per_variable) {
+    for (auto& level_node : level_nodes) {
+      is_prepared[level_node] = true;
+    }
+  }
+  std::vector<index_t> position_level_nodes(sampleIDs.size(), NO_LEVEL_NODE);
+  std::vector<index_t> counts(num_samples + 1, 0);
+  for (size_t level_node = 0; level_node < num_level_nodes; ++level_node) {
+    if (!is_prepared[level_node]) {
+      continue;
+    }
+    size_t nodeID = level_start + level_node;
+    for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+      position_level_nodes[pos] = level_node;
+      ++counts[sampleIDs[pos] + 1];
+    }
+  }
+  std::partial_sum(counts.begin(), counts.end(), counts.begin());
+  std::vector<index_t> level_positions(counts[num_samples]);
+  for (size_t pos = 0; pos < sampleIDs.size(); ++pos) {
+    if (position_level_nodes[pos] != NO_LEVEL_NODE) {
+      level_positions[counts[sampleIDs[pos]]++] = pos;
+    }
+  }
 
-  // For each sample, drop down the tree and add prediction
-  for (size_t i = 0; i < num_samples_oob; ++i) {
-    size_t nodeID = dropDownSamplePermuted(permuted_varID, oob_sampleIDs[i], permutations[i]);
-    prediction_terminal_nodeIDs[i] = nodeID;
+  // One pass over the level for each variable, in the order of the columns
+  level_values.resize(sampleIDs.size());
+  for (size_t varID = 0; varID < level_nodes_per_variable.size(); ++varID) {
+    const std::vector<size_t>& level_nodes = level_nodes_per_variable[varID];
+    if (level_nodes.empty()) {
+      continue;
+    }
+    level_node_slots.assign(num_level_nodes, NO_LEVEL_NODE);
+    for (size_t slot = 0; slot < level_nodes.size(); ++slot) {
+      level_node_slots[level_nodes[slot]] = slot;
+    }
+    for (auto& pos : level_positions) {
+      if (level_node_slots[position_level_nodes[pos]] != NO_LEVEL_NODE) {
+        level_values[pos] = data->get_x(sampleIDs[pos], varID);
+      }
+    }
+    level_values_varID = varID;
+    findBestSplitValuesLevel(varID, level_nodes);
+    level_values_varID = NO_LEVEL_VARIABLE;
   }
 }
 
-void Tree::bootstrap() {
+void Tree::getAllNodeValues(std::vector<double>& all_values, size_t nodeID, size_t varID) const {
+  if (varID != level_values_varID) {
+    data->getAllValues(all_values, sampleIDs, varID, start_pos[nodeID], end_pos[nodeID]);
+    return;
+  }
+  all_values.assign(level_values.begin() + start_pos[nodeID], level_values.begin() + end_pos[nodeID]);
+  std::sort(all_values.begin(), all_values.end());
+  all_values.erase(std::unique(all_values.begin(), all_values.end()), all_values.end());
+}
 
-  // Use fraction (default 63.21%) of the samples
-  size_t num_samples_inbag = (size_t) num_samples * (*sample_fraction)[0];
+bool Tree::drawExtraTreesSplits(size_t nodeID, size_t varID, std::vector<double>& possible_split_values) {
+  size_t start = start_pos[nodeID];
+  size_t end = end_pos[nodeID];
+  if (start == end) {
+    return false;
+  }
 
-  // Reserve space, reserve a little more to be save)
-  sampleIDs.reserve(num_samples_inbag);
-  oob_sampleIDs.reserve(num_samples * (exp(-(*sample_fraction)[0]) + 0.1));
+  // Get min/max values of covariate in node, integer columns are kept as integers
+  double min;
+  double max;
+  bool integer = data->getIntegerValues(extra_trees_integer_values, sampleIDs, varID, start, end);
+  if (integer) {
+    auto minmax = std::minmax_element(extra_trees_integer_values.begin(), extra_trees_integer_values.end());
+    min = *minmax.first;
+    max = *minmax.second;
+  } else {
+    data->getValues(extra_trees_values, sampleIDs, varID, start, end);
+    min = extra_trees_values[0];
+    max = min;
+    for (double value : extra_trees_values) {
+      if (value < min) {
+        min = value;
+      }
+      if (value > max) {
+        max = value;
+      }
+    }
+  }
 
-  std::uniform_int_distribution<size_t> unif_dist(0, num_samples - 1);
+  // Try next variable if all equal for this
+  if (min == max) {
+    return false;
+  }
 
-  // Start with all samples OOB
-  inbag_counts.resize(num_samples, 0);
+  // Create possible split values: Draw randomly between min and max
+  std::uniform_real_distribution<double> udist(min, max);
+  possible_split_values.reserve(num_random_splits);
+  for (size_t i = 0; i < num_random_splits; ++i) {
+    possible_split_values.push_back(udist(random_number_generator));
+  }
+  if (num_random_splits > 1) {
+    std::sort(possible_split_values.begin(), possible_split_values.end());
+  }
 
-  // Draw num_samples samples with replacement (num_samples_inbag out of n) as inbag and mark as not OOB
-  for (size_t s = 0; s < num_samples_inbag; ++s) {
-    size_t draw = unif_dist(random_number_generator);
-    sampleIDs.push_back(draw);
-    ++inbag_counts[draw];
+  // Bin the samples, the sample is right of that many splits
+  extra_trees_bins.resize(end - start);
+  if (integer) {
+    std::vector<int32_t> split_floors;
+    split_floors.reserve(possible_split_values.size());
+    for (double value : possible_split_values) {
+      split_floors.push_back(floor(value));
+    }
+    computeBins(extra_trees_integer_values.data(), end - start, split_floors.data(), split_floors.size(),
+        extra_trees_bins.data());
+  } else {
+    computeBins(extra_trees_values.data(), end - start, possible_split_values.data(), possible_split_values.size(),
+        extra_trees_bins.data());
   }
+  return true;
+}
 
-  // Save OOB samples
-  for (size_t s = 0; s < inbag_counts.size(); ++s) {
-    if (inbag_counts[s] == 0) {
-      oob_sampleIDs.push_back(s);
+bool Tree::getLevelSplit(size_t nodeID, size_t varID, double& decrease, double& value) const {
+  if (nodeID < level_start || nodeID >= level_start + level_splits.size()) {
+    return false;
+  }
+  for (auto& level_split : level_splits[nodeID - level_start]) {
+    if (level_split.varID == varID) {
+      decrease = level_split.decrease;
+      value = level_split.value;
+      return true;
     }
   }
-  num_samples_oob = oob_sampleIDs.size();
+  return false;
+}
+
+void Tree::setLevelSplit(size_t level_node, size_t varID, double decrease, double value) {
+  level_splits[level_node].push_back( { varID, decrease, value });
+}
 
-  if (!keep_inbag) {
-    inbag_counts.clear();
-    inbag_counts.shrink_to_fit();
+void Tree::presortSampleIDs() {
+  size_t num_samples_inbag = sampleIDs.size();
+  num_presorted_variables = data->getNumCols();
+
+  // For corrected Gini importance add dummy variables
+  if (importance_mode == IMP_GINI_CORRECTED) {
+    num_presorted_variables += data->getNumCols();
+  }
+  presorted_sampleIDs.resize((num_presorted_variables + 1) * num_samples_inbag);
+
+  // Counting sort by the index of the value in the unique values of the variable
+  std::vector<index_t> counts;
+  for (size_t varID = 0; varID < num_presorted_variables; ++varID) {
+    counts.assign(data->getNumUniqueDataValues(varID) + 1, 0);
+    for (auto& sampleID : sampleIDs) {
+      ++counts[data->getIndex(sampleID, varID) + 1];
+    }
+    std::partial_sum(counts.begin(), counts.end(), counts.begin());
+    index_t* sorted_sampleIDs = presorted_sampleIDs.data() + varID * num_samples_inbag;
+    for (auto& sampleID : sampleIDs) {
+      sorted_sampleIDs[counts[data->getIndex(sampleID, varID)]++] = sampleID;
+    }
   }
+
+  // The response has no index, sort by value
+  index_t* sorted_sampleIDs = presorted_sampleIDs.data() + num_presorted_variables * num_samples_inbag;
+  std::copy(sampleIDs.begin(), sampleIDs.end(), sorted_sampleIDs);
+  std::stable_sort(sorted_sampleIDs, sorted_sampleIDs + num_samples_inbag, [&](index_t i1, index_t i2) {
+    return data->get_y(i1, 0) < data->get_y(i2, 0);
+  });
+
+  presorted_buffer.resize(num_samples_inbag);
+  presorted_right_child.assign(num_samples, false);
+  presorted_scores.resize(num_samples);
 }
 
-void Tree::bootstrapWeighted() {
+void Tree::partitionPresortedSampleIDs(size_t nodeID, size_t right_child_nodeID) {
+  // Mark samples of the right child, copies of a bootstrapped sample are all in the same child
+  for (size_t pos = start_pos[right_child_nodeID]; pos < end_pos[right_child_nodeID]; ++pos) {
+    presorted_right_child[sampleIDs[pos]] = true;
+  }
 
-  // Use fraction (default 63.21%) of the samples
-  size_t num_samples_inbag = (size_t) num_samples * (*sample_fraction)[0];
+  // Left samples keep their position, right samples are appended after them in order
+  for (size_t list_idx = 0; list_idx <= num_presorted_variables; ++list_idx) {
+    index_t* sorted_sampleIDs = presorted_sampleIDs.data() + list_idx * sampleIDs.size();
+    size_t left_pos = start_pos[nodeID];
+    size_t num_right = 0;
+    for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+      index_t sampleID = sorted_sampleIDs[pos];
+      if (presorted_right_child[sampleID]) {
+        presorted_buffer[num_right++] = sampleID;
+      } else {
+        sorted_sampleIDs[left_pos++] = sampleID;
+      }
+    }
+    std::copy(presorted_buffer.begin(), presorted_buffer.begin() + num_right, sorted_sampleIDs + left_pos);
+  }
 
-  // Reserve space, reserve a little more to be save)
-  sampleIDs.reserve(num_samples_inbag);
-  oob_sampleIDs.reserve(num_samples * (exp(-(*sample_fraction)[0]) + 0.1));
+  for (size_t pos = start_pos[right_child_nodeID]; pos < end_pos[right_child_nodeID]; ++pos) {
+    presorted_right_child[sampleIDs[pos]] = false;
+  }
+}
 
-  std::discrete_distribution<> weighted_dist(case_weights->begin(), case_weights->end());
+void Tree::setPresortedScores(size_t nodeID, const std::vector<double>& response_ordered_scores) {
+  const index_t* sorted_sampleIDs = getPresortedSampleIDs(num_presorted_variables);
+  for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+    presorted_scores[sorted_sampleIDs[pos]] = response_ordered_scores[pos - start_pos[nodeID]];
+  }
+}
 
-  // Start with all samples OOB
-  inbag_counts.resize(num_samples, 0);
+void Tree::getPresortedValues(size_t nodeID, size_t varID, std::vector<double>& x,
+    std::vector<double>& x_scores) const {
+  const index_t* sorted_sampleIDs = getPresortedSampleIDs(varID);
+  x.clear();
+  x_scores.clear();
+  for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+    size_t sampleID = sorted_sampleIDs[pos];
+    x.push_back(data->get_x(sampleID, varID));
+    x_scores.push_back(presorted_scores[sampleID]);
+  }
+}
 
-  // Draw num_samples samples with replacement (n out of n) as inbag and mark as not OOB
-  for (size_t s = 0; s < num_samples_inbag; ++s) {
-    size_t draw = weighted_dist(random_number_generator);
-    sampleIDs.push_back(draw);
-    ++inbag_counts[draw];
+void Tree::createEmptyNode() {
+  split_varIDs.push_back(0);
+  split_values.push_back(0);
+  child_nodeIDs[0].push_back(0);
+  child_nodeIDs[1].push_back(0);
+  start_pos.push_back(0);
+  end_pos.push_back(0);
+
+  createEmptyNodeInternal();
+}
+
+size_t Tree::dropDownSamplePermuted(size_t permuted_varID, size_t sampleID, size_t permuted_sampleID,
+    size_t start_nodeID) const {
+
+  // Start in start node and drop down
+  size_t nodeID = start_nodeID;
+  while (child_nodeIDs[0][nodeID] != 0 || child_nodeIDs[1][nodeID] != 0) {
+
+    // Permute if variable is permutation variable
+    size_t split_varID = split_varIDs[nodeID];
+    size_t sampleID_final = sampleID;
+    if (split_varID == permuted_varID) {
+      sampleID_final = permuted_sampleID;
+    }
+
+    // Move to child
+    nodeID = getChildNodeID(nodeID, data->get_x(sampleID_final, split_varID));
+  }
+  return nodeID;
+}
+
+void Tree::createOobSampleIDs() {
+  if (has_oob_sampleIDs) {
+    return;
   }
 
   // Save OOB samples. In holdout mode these are the cases with 0 weight.
-  if (holdout) {
-    for (size_t s = 0; s < (*case_weights).size(); ++s) {
+  if (holdout && !case_weights->empty()) {
+    for (size_t s = 0; s < case_weights->size(); ++s) {
       if ((*case_weights)[s] == 0) {
         oob_sampleIDs.push_back(s);
       }
     }
   } else {
-    for (size_t s = 0; s < inbag_counts.size(); ++s) {
-      if (inbag_counts[s] == 0) {
+    // Draw the inbag samples again from the bootstrap stream of the tree seed
+    random_number_generator.seed(seed, BOOTSTRAP_STREAM);
+    drawBootstrapSample();
+
+    std::vector<bool> inbag(num_samples, false);
+    for (auto& sampleID : sampleIDs) {
+      inbag[sampleID] = true;
+    }
+    sampleIDs.clear();
+    sampleIDs.shrink_to_fit();
+    for (size_t s = 0; s < num_samples; ++s) {
+      if (!inbag[s]) {
         oob_sampleIDs.push_back(s);
       }
     }
   }
   num_samples_oob = oob_sampleIDs.size();
+  has_oob_sampleIDs = true;
+}
 
-  if (!keep_inbag) {
-    inbag_counts.clear();
-    inbag_counts.shrink_to_fit();
+void Tree::drawBootstrapSample() {
+  // Bootstrap, dependent if weighted or not and with or without replacement
+  if (!case_weights->empty()) {
+    if (sample_with_replacement) {
+      bootstrapWeighted();
+    } else {
+      bootstrapWithoutReplacementWeighted();
+    }
+  } else if (sample_fraction->size() > 1) {
+    if (sample_with_replacement) {
+      bootstrapClassWise();
+    } else {
+      bootstrapWithoutReplacementClassWise();
+    }
+  } else if (!manual_inbag->empty()) {
+    setManualInbag();
+  } else {
+    if (sample_with_replacement) {
+      bootstrap();
+    } else {
+      bootstrapWithoutReplacement();
+    }
   }
 }
 
-void Tree::bootstrapWithoutReplacement() {
+void Tree::bootstrap() {
 
   // Use fraction (default 63.21%) of the samples
   size_t num_samples_inbag = (size_t) num_samples * (*sample_fraction)[0];
-  shuffleAndSplit(sampleIDs, oob_sampleIDs, num_samples, num_samples_inbag, random_number_generator);
-  num_samples_oob = oob_sampleIDs.size();
+  sampleIDs.reserve(num_samples_inbag);
 
-  if (keep_inbag) {
-    // All observation are 0 or 1 times inbag
-    inbag_counts.resize(num_samples, 1);
-    for (size_t i = 0; i < oob_sampleIDs.size(); i++) {
-      inbag_counts[oob_sampleIDs[i]] = 0;
-    }
+  // Draw num_samples samples with replacement (num_samples_inbag out of n) as inbag
+  for (size_t s = 0; s < num_samples_inbag; ++s) {
+    sampleIDs.push_back(random_number_generator.bounded(num_samples));
   }
 }
 
-void Tree::bootstrapWithoutReplacementWeighted() {
+void Tree::bootstrapWeighted() {
 
   // Use fraction (default 63.21%) of the samples
   size_t num_samples_inbag = (size_t) num_samples * (*sample_fraction)[0];
-  drawWithoutReplacementWeighted(sampleIDs, random_number_generator, num_samples - 1, num_samples_inbag, *case_weights);
+  sampleIDs.reserve(num_samples_inbag);
 
-  // All observation are 0 or 1 times inbag
-  inbag_counts.resize(num_samples, 0);
-  for (auto& sampleID : sampleIDs) {
-    inbag_counts[sampleID] = 1;
+  // Draw num_samples samples with replacement (n out of n) as inbag, from the alias table shared by all trees
+  for (size_t s = 0; s < num_samples_inbag; ++s) {
+    sampleIDs.push_back(case_weights_alias->draw(random_number_generator));
   }
+}
 
-  // Save OOB samples. In holdout mode these are the cases with 0 weight.
-  if (holdout) {
-    for (size_t s = 0; s < (*case_weights).size(); ++s) {
-      if ((*case_weights)[s] == 0) {
-        oob_sampleIDs.push_back(s);
-      }
-    }
-  } else {
-    for (size_t s = 0; s < inbag_counts.size(); ++s) {
-      if (inbag_counts[s] == 0) {
-        oob_sampleIDs.push_back(s);
-      }
-    }
-  }
-  num_samples_oob = oob_sampleIDs.size();
+void Tree::bootstrapWithoutReplacement() {
 
-  if (!keep_inbag) {
-    inbag_counts.clear();
-    inbag_counts.shrink_to_fit();
-  }
+  // Use fraction (default 63.21%) of the samples
+  size_t num_samples_inbag = (size_t) num_samples * (*sample_fraction)[0];
+  drawWithoutReplacementSelection(sampleIDs, num_samples, num_samples_inbag, nullptr, random_number_generator);
+}
+
+void Tree::bootstrapWithoutReplacementWeighted() {
+
+  // Use fraction (default 63.21%) of the samples
+  size_t num_samples_inbag = (size_t) num_samples * (*sample_fraction)[0];
+  drawWithoutReplacementWeighted(sampleIDs, random_number_generator, num_samples - 1, num_samples_inbag, *case_weights);
 }
 
 void Tree::bootstrapClassWise() {
@@ -567,27 +959,15 @@ void Tree::bootstrapWithoutReplacementClassWise() {
 void Tree::setManualInbag() {
   // Select observation as specified in manual_inbag vector
   sampleIDs.reserve(manual_inbag->size());
-  inbag_counts.resize(num_samples, 0);
   for (size_t i = 0; i < manual_inbag->size(); ++i) {
     size_t inbag_count = (*manual_inbag)[i];
-    if ((*manual_inbag)[i] > 0) {
-      for (size_t j = 0; j < inbag_count; ++j) {
-        sampleIDs.push_back(i);
-      }
-      inbag_counts[i] = inbag_count;
-    } else {
-      oob_sampleIDs.push_back(i);
+    for (size_t j = 0; j < inbag_count; ++j) {
+      sampleIDs.push_back(i);
     }
   }
-  num_samples_oob = oob_sampleIDs.size();
 
   // Shuffle samples
   std::shuffle(sampleIDs.begin(), sampleIDs.end(), random_number_generator);
-
-  if (!keep_inbag) {
-    inbag_counts.clear();
-    inbag_counts.shrink_to_fit();
-  }
 }
 
 } // namespace ranger
@@ -16,9 +16,14 @@
 #include <random>
 #include <iostream>
 #include <stdexcept>
+#include <limits>
 
 #include "globals.h"
 #include "Data.h"
+#include "RandomGenerator.h"
+#include "RegularizationState.h"
+#include "RunStats.h"
+#include "Sampling.h"
 
 namespace ranger {
 
@@ -35,13 +40,13 @@ public:
   Tree(const Tree&) = delete;
   Tree& operator=(const Tree&) = delete;
 
-  void init(const Data* data, uint mtry, size_t num_samples, uint seed, std::vector<size_t>* deterministic_varIDs,
+  void init(const Data* data, uint mtry, size_t num_samples, uint64_t seed, std::vector<size_t>* deterministic_varIDs,
       std::vector<double>* split_select_weights, ImportanceMode importance_mode, uint min_node_size,
       bool sample_with_replacement, bool memory_saving_splitting, SplitRule splitrule,
-      std::vector<double>* case_weights, std::vector<size_t>* manual_inbag, bool keep_inbag,
-      std::vector<double>* sample_fraction, double alpha, double minprop, bool holdout, uint num_random_splits,
-      uint max_depth, std::vector<double>* regularization_factor, bool regularization_usedepth,
-      std::vector<bool>* split_varIDs_used);
+      std::vector<double>* case_weights, const AliasTable* case_weights_alias, std::vector<size_t>* manual_inbag,
+      bool keep_inbag, std::vector<double>* sample_fraction, double alpha, double minprop, bool holdout,
+      uint num_random_splits, uint max_depth, std::vector<double>* regularization_factor, bool regularization_usedepth,
+      RegularizationState* regularization_state, size_t tree_idx);
 
   virtual void allocateMemory() = 0;
 
@@ -49,23 +54,42 @@ public:
 
   void predict(const Data* prediction_data, bool oob_prediction);
 
-  void computePermutationImportance(std::vector<double>& forest_importance, std::vector<double>& forest_variance,
-      std::vector<double>& forest_importance_casewise);
+  // Terminal nodes found by the QuickScorer instead of predict(), see Forest::predictQuickScorerInThread()
+  void resetPredictionTerminalNodeIDs(size_t num_samples_predict) {
+    prediction_terminal_nodeIDs.assign(num_samples_predict, 0);
+  }
+  void setPredictionTerminalNodeID(size_t sampleID, size_t nodeID) {
+    prediction_terminal_nodeIDs[sampleID] = nodeID;
+  }
+
+  // Permutation importance of variables start_varID to end_varID-1. Calls for disjoint variable ranges of the same
+  // tree can run in parallel, the permutation of a variable only depends on the tree seed and the variable.
+  void computePermutationImportance(size_t start_varID, size_t end_varID, std::vector<double>& forest_importance,
+      std::vector<double>& forest_variance, std::vector<double>& forest_importance_casewise) const;
 
   void appendToFile(std::ofstream& file);
   virtual void appendToFileInternal(std::ofstream& file) = 0;
 
-  const std::vector<std::vector<size_t>>& getChildNodeIDs() const {
+  const std::vector<std::vector<index_t>>& getChildNodeIDs() const {
     return child_nodeIDs;
   }
   const std::vector<double>& getSplitValues() const {
     return split_values;
   }
-  const std::vector<size_t>& getSplitVarIDs() const {
+  const std::vector<index_t>& getSplitVarIDs() const {
     return split_varIDs;
   }
 
-  const std::vector<size_t>& getOobSampleIDs() const {
+  // OOB samples are not kept while growing, they are recreated from the tree seed. Called by predict() for OOB
+  // prediction.
+  void createOobSampleIDs();
+  void clearOobSampleIDs() {
+    oob_sampleIDs.clear();
+    oob_sampleIDs.shrink_to_fit();
+    has_oob_sampleIDs = false;
+  }
+
+  const std::vector<index_t>& getOobSampleIDs() const {
     return oob_sampleIDs;
   }
   size_t getNumSamplesOob() const {
@@ -76,6 +100,16 @@ public:
     return inbag_counts;
   }
 
+  // Record timings, size and split evaluations while growing
+  void setStats(TreeStats* stats) {
+    this->stats = stats;
+  }
+
+  // Prepare the splits of all nodes of a depth level together, see prepareLevel(). Call before grow().
+  void setLevelWiseGrowth(bool level_wise_growth) {
+    this->level_wise_growth = level_wise_growth;
+  }
+
 protected:
   void createPossibleSplitVarSubset(std::vector<size_t>& result);
 
@@ -85,11 +119,91 @@ protected:
   void createEmptyNode();
   virtual void createEmptyNodeInternal() = 0;
 
-  size_t dropDownSamplePermuted(size_t permuted_varID, size_t sampleID, size_t permuted_sampleID);
-  void permuteAndPredictOobSamples(size_t permuted_varID, std::vector<size_t>& permutations);
+  // True if all samples in the node have the same response, which is then returned in pure_value
+  bool isPureNode(size_t nodeID, double& pure_value) const;
+
+  // Level-wise growth: Before the nodes of a level are split one by one, the split variables of each node are drawn
+  // and, for every variable, one ascending pass over the samples of the level counts the unique value index of each
+  // sample into a histogram of its node. The best split value of each variable and node is saved and used by the
+  // subclasses instead of scanning the node. Only pairs where the histogram is not larger than the node are prepared
+  // (q >= 1, stricter than Q_THRESHOLD which selects the histogram method node by node), others and all unordered
+  // variables are split as before. Both methods find the same split, the trees are the same as with node-wise growth
+  // except for rounding of the response sums in the histogram bins. Not used with regularization.
+  // Memory saving splitting has no index data. Instead, the values of each variable are read for all samples of the
+  // level in one ascending pass into level_values, for out-of-core data a sequential read of the column. The nodes
+  // are then split on these values as node by node, the trees are the same.
+  void prepareLevel(size_t level_start, size_t level_end);
+  void prepareLevelValues(size_t num_level_nodes, const std::vector<std::vector<size_t>>& level_nodes_per_variable);
+
+  // Subclasses splitting ordered variables by value histograms support level-wise growth
+  virtual bool supportsLevelWiseGrowth() const {
+    return false;
+  }
+
+  // Histogram the samples of the given level nodes by the unique value index of varID and save the best split of
+  // each node with setLevelSplit(). The nodes are local indices in the level, level_node_slots maps them to the
+  // histograms. With memory saving splitting, the values of varID are in level_values instead.
+  virtual void findBestSplitValuesLevel(size_t varID, const std::vector<size_t>& level_nodes) {
+  }
+
+  // Value of varID for the sample at position pos of sampleIDs, read from level_values if prepared
+  double getNodeValue(size_t pos, size_t varID) const {
+    if (varID == level_values_varID) {
+      return level_values[pos];
+    }
+    return data->get_x(sampleIDs[pos], varID);
+  }
+
+  // Sorted unique values of varID in a node as Data::getAllValues(), from level_values if prepared
+  void getAllNodeValues(std::vector<double>& all_values, size_t nodeID, size_t varID) const;
+
+  // Extra trees: Draw num_random_splits sorted split values between min and max of varID in the node and bin the node
+  // samples into extra_trees_bins by the number of split values below their value. False if all values are equal.
+  bool drawExtraTreesSplits(size_t nodeID, size_t varID, std::vector<double>& possible_split_values);
+
+  // Best split of a variable in a node of the current level, false if not prepared
+  bool getLevelSplit(size_t nodeID, size_t varID, double& decrease, double& value) const;
+  void setLevelSplit(size_t level_node, size_t varID, double decrease, double value);
+
+  // Child node a sample with value of the split variable moves to
+  size_t getChildNodeID(size_t nodeID, double value) const {
+    size_t split_varID = split_varIDs[nodeID];
+    if (data->isOrderedVariable(split_varID)) {
+      // Left is <= splitval
+      if (value <= split_values[nodeID]) {
+        return child_nodeIDs[0][nodeID];
+      } else {
+        return child_nodeIDs[1][nodeID];
+      }
+    } else {
+      size_t factorID = floor(value) - 1;
+      size_t splitID = floor(split_values[nodeID]);
+
+      // Left if 0 found at position factorID
+      if (!(splitID & (1ULL << factorID))) {
+        return child_nodeIDs[0][nodeID];
+      } else {
+        return child_nodeIDs[1][nodeID];
+      }
+    }
+  }
+
+  // Drop sample down from start node, use permuted sample for splits on permuted variable
+  size_t dropDownSamplePermuted(size_t permuted_varID, size_t sampleID, size_t permuted_sampleID,
+      size_t start_nodeID) const;
+
+  // OOB sample in permutation importance with first node splitting on the permuted variable
+  struct PermutedPath {
+    index_t oob_idx;
+    index_t nodeID;
+  };
 
-  virtual double computePredictionAccuracyInternal(std::vector<double>* prediction_error_casewise) = 0;
+  virtual double computePredictionAccuracyInternal(const std::vector<index_t>& terminal_nodeIDs,
+      std::vector<double>* prediction_error_casewise) const = 0;
   
+  // Draw the inbag samples to sampleIDs, dependent if weighted or not and with or without replacement
+  void drawBootstrapSample();
+
   void bootstrap();
   void bootstrapWithoutReplacement();
 
@@ -103,13 +217,33 @@ protected:
 
   virtual void cleanUpInternal() = 0;
 
+  // Presorted samples for the MAXSTAT splitrule: One list for each variable and, last, one for the first response
+  // column. The samples of a node are at start_pos..end_pos of each list, ordered by value. The lists are sorted once
+  // per tree and partitioned stably into the child nodes, so no sorting is needed in the nodes.
+  void presortSampleIDs();
+  void partitionPresortedSampleIDs(size_t nodeID, size_t right_child_nodeID);
+  const index_t* getPresortedSampleIDs(size_t list_idx) const {
+    return presorted_sampleIDs.data() + list_idx * sampleIDs.size();
+  }
+
+  // Class of the sample at each position of sampleIDs in sample_classIDs, partitioned together with sampleIDs so that
+  // the classes of a node are contiguous. Overridden by trees with class responses.
+  virtual void initSampleClassIDs() {
+  }
+
+  // Save scores of the samples in a node, given in the order of the response list
+  void setPresortedScores(size_t nodeID, const std::vector<double>& response_ordered_scores);
+
+  // Values of a variable in ascending order and the saved scores of the same samples
+  void getPresortedValues(size_t nodeID, size_t varID, std::vector<double>& x, std::vector<double>& x_scores) const;
+
   void regularize(double& decrease, size_t varID) {
     if (regularization) {
       if (importance_mode == IMP_GINI_CORRECTED) {
         varID = data->getUnpermutedVarID(varID);
       }
       if ((*regularization_factor)[varID] != 1) {
-        if (!(*split_varIDs_used)[varID]) {
+        if (!split_varIDs_used[varID] && !regularization_state->isUsed(varID, tree_idx)) {
           if (regularization_usedepth) {
             decrease *= std::pow((*regularization_factor)[varID], depth + 1);
           } else {
@@ -126,7 +260,7 @@ protected:
           varID = data->getUnpermutedVarID(varID);
         }
         if ((*regularization_factor)[varID] != 1) {
-          if (!(*split_varIDs_used)[varID]) {
+          if (!split_varIDs_used[varID] && !regularization_state->isUsed(varID, tree_idx)) {
             if (regularization_usedepth) {
               decrease /= std::pow((*regularization_factor)[varID], depth + 1);
             } else {
@@ -137,13 +271,22 @@ protected:
       }
     }
 
+  // Count candidate variables evaluated for splitting a node
+  void countSplitEvaluations(const std::vector<size_t>& possible_split_varIDs) {
+    if (stats) {
+      for (auto& varID : possible_split_varIDs) {
+        ++stats->split_evaluations[data->getUnpermutedVarID(varID)];
+      }
+    }
+  }
+
   void saveSplitVarID(size_t varID) {
     if (regularization) {
       if (importance_mode == IMP_GINI_CORRECTED) {
-        (*split_varIDs_used)[data->getUnpermutedVarID(varID)] = true;
-      } else {
-        (*split_varIDs_used)[varID] = true;
+        varID = data->getUnpermutedVarID(varID);
       }
+      split_varIDs_used[varID] = true;
+      regularization_state->setUsed(varID, tree_idx);
     }
   }
 
@@ -165,29 +308,39 @@ protected:
 
   // Bootstrap weights
   const std::vector<double>* case_weights;
+  const AliasTable* case_weights_alias;
 
   // Pre-selected bootstrap samples
   const std::vector<size_t>* manual_inbag;
 
   // Splitting variable for each node
-  std::vector<size_t> split_varIDs;
+  std::vector<index_t> split_varIDs;
 
   // Value to split at for each node, for now only binary split
   // For terminal nodes the prediction value is saved here
   std::vector<double> split_values;
 
   // Vector of left and right child node IDs, 0 for no child
-  std::vector<std::vector<size_t>> child_nodeIDs;
+  std::vector<std::vector<index_t>> child_nodeIDs;
 
   // All sampleIDs in the tree, will be re-ordered while splitting
-  std::vector<size_t> sampleIDs;
+  std::vector<index_t> sampleIDs;
 
   // For each node a vector with start and end positions
-  std::vector<size_t> start_pos;
-  std::vector<size_t> end_pos;
+  std::vector<index_t> start_pos;
+  std::vector<index_t> end_pos;
+
+  // Presorted samples, empty if not used
+  std::vector<index_t> presorted_sampleIDs;
+  std::vector<index_t> sample_classIDs;
+  size_t num_presorted_variables;
+  std::vector<index_t> presorted_buffer;
+  std::vector<bool> presorted_right_child;
+  std::vector<double> presorted_scores;
 
   // IDs of OOB individuals, sorted
-  std::vector<size_t> oob_sampleIDs;
+  std::vector<index_t> oob_sampleIDs;
+  bool has_oob_sampleIDs;
 
   // Holdout mode
   bool holdout;
@@ -196,8 +349,13 @@ protected:
   bool keep_inbag;
   std::vector<size_t> inbag_counts;
 
-  // Random number generator
-  std::mt19937_64 random_number_generator;
+  // Random number generator, reseeded from the tree seed with one stream for the bootstrap, one for each node and
+  // one for each permuted variable
+  RandomGenerator random_number_generator;
+  uint64_t seed;
+  static constexpr uint64_t BOOTSTRAP_STREAM = 0;
+  static constexpr uint64_t NODE_STREAM_START = 1;
+  static constexpr uint64_t VARIABLE_STREAM_START = 1ULL << 32;
 
   // Pointer to original data
   const Data* data;
@@ -206,7 +364,11 @@ protected:
   bool regularization;
   std::vector<double>* regularization_factor;
   bool regularization_usedepth;
-  std::vector<bool>* split_varIDs_used;
+  RegularizationState* regularization_state;
+  size_t tree_idx;
+
+  // Variables used by this tree, splits of other trees are in the shared state
+  std::vector<bool> split_varIDs_used;
   
   // Variable importance for all variables
   std::vector<double>* variable_importance;
@@ -214,7 +376,7 @@ protected:
 
   // When growing here the OOB set is used
   // Terminal nodeIDs for prediction samples
-  std::vector<size_t> prediction_terminal_nodeIDs;
+  std::vector<index_t> prediction_terminal_nodeIDs;
 
   bool sample_with_replacement;
   const std::vector<double>* sample_fraction;
@@ -227,6 +389,40 @@ protected:
   uint max_depth;
   uint depth;
   size_t last_left_nodeID;
+
+  // Level-wise growth, see prepareLevel()
+  bool level_wise_growth;
+  size_t level_start;
+  static constexpr index_t NO_LEVEL_NODE = std::numeric_limits<index_t>::max();
+
+  // Samples of the prepared level nodes in ascending order, with the local node and the inbag count of each sample
+  std::vector<index_t> level_sampleIDs;
+  std::vector<index_t> level_node_of_sample;
+  std::vector<index_t> level_sample_counts;
+
+  // Histogram of each local node for the current variable, NO_LEVEL_NODE if not prepared
+  std::vector<index_t> level_node_slots;
+
+  // Memory saving splitting: Values of level_values_varID at each position of sampleIDs in the prepared level nodes
+  static constexpr size_t NO_LEVEL_VARIABLE = std::numeric_limits<size_t>::max();
+  size_t level_values_varID;
+  std::vector<double> level_values;
+
+  // Extra trees: Values of the node samples, gathered once per variable, and the bin of each sample
+  std::vector<double> extra_trees_values;
+  std::vector<int32_t> extra_trees_integer_values;
+  std::vector<uint32_t> extra_trees_bins;
+
+  // Prepared splits of each local node
+  struct LevelSplit {
+    size_t varID;
+    double decrease;
+    double value;
+  };
+  std::vector<std::vector<LevelSplit>> level_splits;
+
+  // Run statistics, nullptr if not recorded
+  TreeStats* stats;
 };
 
 } // namespace ranger
@@ -12,11 +12,13 @@
 #include <unordered_map>
 #include <random>
 #include <algorithm>
+#include <numeric>
 #include <iostream>
 #include <iterator>
 
 #include "TreeClassification.h"
 #include "utility.h"
+#include "Simd.h"
 #include "Data.h"
 
 namespace ranger {
@@ -40,9 +42,9 @@ void TreeClassification::allocateMemory() {
     size_t num_classes = class_values->size();
     size_t max_num_splits = data->getMaxNumUniqueValues();
 
-    // Use number of random splits for extratrees
-    if (splitrule == EXTRATREES && num_random_splits > max_num_splits) {
-      max_num_splits = num_random_splits;
+    // Use number of random splits for extratrees, plus one for samples left of all splits
+    if (splitrule == EXTRATREES && num_random_splits + 1 > max_num_splits) {
+      max_num_splits = num_random_splits + 1;
     }
 
     counter.resize(max_num_splits);
@@ -84,23 +86,14 @@ bool TreeClassification::splitNodeInternal(size_t nodeID, std::vector<size_t>& p
   }
 
   // Check if node is pure and set split_value to estimate and stop if pure
-  bool pure = true;
-  double pure_value = 0;
-  for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-    size_t sampleID = sampleIDs[pos];
-    double value = data->get_y(sampleID, 0);
-    if (pos != start_pos[nodeID] && value != pure_value) {
-      pure = false;
-      break;
-    }
-    pure_value = value;
-  }
-  if (pure) {
+  double pure_value;
+  if (isPureNode(nodeID, pure_value)) {
     split_values[nodeID] = pure_value;
     return true;
   }
 
   // Find best split, stop if no decrease of impurity
+  countSplitEvaluations(possible_split_varIDs);
   bool stop;
   if (splitrule == EXTRATREES) {
     stop = findBestSplitExtraTrees(nodeID, possible_split_varIDs);
@@ -116,16 +109,24 @@ bool TreeClassification::splitNodeInternal(size_t nodeID, std::vector<size_t>& p
   return false;
 }
 
+void TreeClassification::initSampleClassIDs() {
+  sample_classIDs.resize(sampleIDs.size());
+  for (size_t pos = 0; pos < sampleIDs.size(); ++pos) {
+    sample_classIDs[pos] = (*response_classIDs)[sampleIDs[pos]];
+  }
+}
+
 void TreeClassification::createEmptyNodeInternal() {
   // Empty on purpose
 }
 
-double TreeClassification::computePredictionAccuracyInternal(std::vector<double>* prediction_error_casewise) {
+double TreeClassification::computePredictionAccuracyInternal(const std::vector<index_t>& terminal_nodeIDs,
+    std::vector<double>* prediction_error_casewise) const {
 
-  size_t num_predictions = prediction_terminal_nodeIDs.size();
+  size_t num_predictions = terminal_nodeIDs.size();
   size_t num_missclassifications = 0;
   for (size_t i = 0; i < num_predictions; ++i) {
-    size_t terminal_nodeID = prediction_terminal_nodeIDs[i];
+    size_t terminal_nodeID = terminal_nodeIDs[i];
     double predicted_value = split_values[terminal_nodeID];
     double real_value = data->get_y(oob_sampleIDs[i], 0);
     if (predicted_value != real_value) {
@@ -161,7 +162,15 @@ bool TreeClassification::findBestSplit(size_t nodeID, std::vector<size_t>& possi
   // For all possible split variables
   for (auto& varID : possible_split_varIDs) {
     // Find best split value, if ordered consider all values as split values, else all 2-partitions
-    if (data->isOrderedVariable(varID)) {
+    double level_decrease, level_value;
+    if (getLevelSplit(nodeID, varID, level_decrease, level_value)) {
+      // Prepared for all nodes of the level
+      if (level_decrease > best_decrease) {
+        best_value = level_value;
+        best_varID = varID;
+        best_decrease = level_decrease;
+      }
+    } else if (data->isOrderedVariable(varID)) {
 
       // Use memory saving method if option set
       if (memory_saving_splitting) {
@@ -210,7 +219,7 @@ void TreeClassification::findBestSplitValueSmallQ(size_t nodeID, size_t varID, s
 
   // Create possible split values
   std::vector<double> possible_split_values;
-  data->getAllValues(possible_split_values, sampleIDs, varID, start_pos[nodeID], end_pos[nodeID]);
+  getAllNodeValues(possible_split_values, nodeID, varID);
 
   // Try next variable if all equal for this
   if (possible_split_values.size() < 2) {
@@ -239,7 +248,7 @@ void TreeClassification::findBestSplitValueSmallQ(size_t nodeID, size_t varID, s
     size_t sampleID = sampleIDs[pos];
     uint sample_classID = (*response_classIDs)[sampleID];
     size_t idx = std::lower_bound(possible_split_values.begin(), possible_split_values.end(),
-        data->get_x(sampleID, varID)) - possible_split_values.begin();
+        getNodeValue(pos, varID)) - possible_split_values.begin();
 
     ++counter_per_class[idx * num_classes + sample_classID];
     ++counter[idx];
@@ -319,19 +328,29 @@ void TreeClassification::findBestSplitValueLargeQ(size_t nodeID, size_t varID, s
 
   // Set counters to 0
   size_t num_unique = data->getNumUniqueDataValues(varID);
-  std::fill_n(counter_per_class.begin(), num_unique * num_classes, 0);
-  std::fill_n(counter.begin(), num_unique, 0);
-
-  // Count values
-  for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-    size_t sampleID = sampleIDs[pos];
-    size_t index = data->getIndex(sampleID, varID);
-    size_t classID = (*response_classIDs)[sampleID];
+  size_t num_keys = num_unique * num_classes;
+  std::fill_n(counter_per_class.begin(), num_keys, 0);
+
+  // Count values and classes from the contiguous node samples
+  node_indexes.resize(std::max(node_indexes.size(), num_samples_node));
+  counter_per_class_copies.resize(std::max(counter_per_class_copies.size(), 3 * num_keys));
+  data->getIndexes(sampleIDs, varID, start_pos[nodeID], end_pos[nodeID], node_indexes.data());
+  countClassHistogram(node_indexes.data(), sample_classIDs.data() + start_pos[nodeID], num_samples_node, num_classes,
+      num_keys, counter_per_class_copies.data(), counter_per_class.data());
+  for (size_t i = 0; i < num_unique; ++i) {
+    counter[i] = std::accumulate(counter_per_class.begin() + i * num_classes,
+        counter_per_class.begin() + (i + 1) * num_classes, (size_t) 0);
+  }
+
+  findBestSplitValueLargeQ(varID, num_classes, class_counts, num_samples_node, best_value, best_varID, best_decrease,
+      counter.data(), counter_per_class.data());
+}
 
-    ++counter[index];
-    ++counter_per_class[index * num_classes + classID];
-  }
+void TreeClassification::findBestSplitValueLargeQ(size_t varID, size_t num_classes, const std::vector<size_t>& class_counts,
+    size_t num_samples_node, double& best_value, size_t& best_varID, double& best_decrease, const size_t* counter,
+    const size_t* counter_per_class) {
 
+  size_t num_unique = data->getNumUniqueDataValues(varID);
   size_t n_left = 0;
   std::vector<size_t> class_counts_left(num_classes);
 
@@ -406,6 +425,76 @@ void TreeClassification::findBestSplitValueLargeQ(size_t nodeID, size_t varID, s
   }
 }
 
+void TreeClassification::findBestSplitValuesLevel(size_t varID, const std::vector<size_t>& level_nodes) {
+  size_t num_classes = class_values->size();
+
+  // Memory saving splitting: Split each node on the values read for the level, as in findBestSplit()
+  if (memory_saving_splitting) {
+    std::vector<size_t> class_counts(num_classes);
+    for (auto& level_node : level_nodes) {
+      size_t nodeID = level_start + level_node;
+      std::fill(class_counts.begin(), class_counts.end(), 0);
+      for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+        ++class_counts[(*response_classIDs)[sampleIDs[pos]]];
+      }
+      double best_value = 0;
+      size_t best_varID = 0;
+      double best_decrease = -1;
+      findBestSplitValueSmallQ(nodeID, varID, num_classes, class_counts, end_pos[nodeID] - start_pos[nodeID],
+          best_value, best_varID, best_decrease);
+      setLevelSplit(level_node, varID, best_decrease, best_value);
+    }
+    return;
+  }
+
+  size_t num_unique = data->getNumUniqueDataValues(varID);
+
+  // Histograms of all nodes side by side, grow the counters if needed
+  size_t num_bins = level_nodes.size() * num_unique;
+  if (counter.size() < num_bins) {
+    counter.resize(num_bins);
+    counter_per_class.resize(num_bins * num_classes);
+  }
+  std::fill_n(counter.begin(), num_bins, 0);
+  std::fill_n(counter_per_class.begin(), num_bins * num_classes, 0);
+
+  // Count values, samples in ascending order
+  for (auto& sampleID : level_sampleIDs) {
+    size_t slot = level_node_slots[level_node_of_sample[sampleID]];
+    if (slot == NO_LEVEL_NODE) {
+      continue;
+    }
+    size_t index = slot * num_unique + data->getIndex(sampleID, varID);
+    size_t classID = (*response_classIDs)[sampleID];
+    size_t count = level_sample_counts[sampleID];
+
+    counter[index] += count;
+    counter_per_class[index * num_classes + classID] += count;
+  }
+
+  // Find best split value of each node
+  std::vector<size_t> class_counts(num_classes);
+  for (size_t slot = 0; slot < level_nodes.size(); ++slot) {
+    const size_t* node_counter = counter.data() + slot * num_unique;
+    const size_t* node_counter_per_class = counter_per_class.data() + slot * num_unique * num_classes;
+    std::fill(class_counts.begin(), class_counts.end(), 0);
+    for (size_t i = 0; i < num_unique; ++i) {
+      for (size_t j = 0; j < num_classes; ++j) {
+        class_counts[j] += node_counter_per_class[i * num_classes + j];
+      }
+    }
+
+    size_t nodeID = level_start + level_nodes[slot];
+    size_t num_samples_node = end_pos[nodeID] - start_pos[nodeID];
+    double best_value = 0;
+    size_t best_varID = 0;
+    double best_decrease = -1;
+    findBestSplitValueLargeQ(varID, num_classes, class_counts, num_samples_node, best_value, best_varID,
+        best_decrease, node_counter, node_counter_per_class);
+    setLevelSplit(level_nodes[slot], varID, best_decrease, best_value);
+  }
+}
+
 void TreeClassification::findBestSplitValueUnordered(size_t nodeID, size_t varID, size_t num_classes,
     const std::vector<size_t>& class_counts, size_t num_samples_node, double& best_value, size_t& best_varID,
     double& best_decrease) {
@@ -548,35 +637,20 @@ void TreeClassification::findBestSplitValueExtraTrees(size_t nodeID, size_t varI
     const std::vector<size_t>& class_counts, size_t num_samples_node, double& best_value, size_t& best_varID,
     double& best_decrease) {
 
-  // Get min/max values of covariate in node
-  double min;
-  double max;
-  data->getMinMaxValues(min, max, sampleIDs, varID, start_pos[nodeID], end_pos[nodeID]);
-
-  // Try next variable if all equal for this
-  if (min == max) {
-    return;
-  }
-
-  // Create possible split values: Draw randomly between min and max
+  // Draw split values and bin the samples, try next variable if all equal for this
   std::vector<double> possible_split_values;
-  std::uniform_real_distribution<double> udist(min, max);
-  possible_split_values.reserve(num_random_splits);
-  for (size_t i = 0; i < num_random_splits; ++i) {
-    possible_split_values.push_back(udist(random_number_generator));
-  }
-  if (num_random_splits > 1) {
-    std::sort(possible_split_values.begin(), possible_split_values.end());
+  if (!drawExtraTreesSplits(nodeID, varID, possible_split_values)) {
+    return;
   }
 
   const size_t num_splits = possible_split_values.size();
   if (memory_saving_splitting) {
-    std::vector<size_t> class_counts_right(num_splits * num_classes), n_right(num_splits);
+    std::vector<size_t> class_counts_right((num_splits + 1) * num_classes), n_right(num_splits + 1);
     findBestSplitValueExtraTrees(nodeID, varID, num_classes, class_counts, num_samples_node, best_value, best_varID,
         best_decrease, possible_split_values, class_counts_right, n_right);
   } else {
-    std::fill_n(counter_per_class.begin(), num_splits * num_classes, 0);
-    std::fill_n(counter.begin(), num_splits, 0);
+    std::fill_n(counter_per_class.begin(), (num_splits + 1) * num_classes, 0);
+    std::fill_n(counter.begin(), num_splits + 1, 0);
     findBestSplitValueExtraTrees(nodeID, varID, num_classes, class_counts, num_samples_node, best_value, best_varID,
         best_decrease, possible_split_values, counter_per_class, counter);
   }
@@ -588,20 +662,19 @@ void TreeClassification::findBestSplitValueExtraTrees(size_t nodeID, size_t varI
     std::vector<size_t>& n_right) {
   const size_t num_splits = possible_split_values.size();
 
-  // Count samples in right child per class and possbile split
-  for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-    size_t sampleID = sampleIDs[pos];
-    double value = data->get_x(sampleID, varID);
-    uint sample_classID = (*response_classIDs)[sampleID];
+  // Count per class by bin, the number of split values below the sample value
+  const size_t start = start_pos[nodeID];
+  for (size_t pos = start; pos < end_pos[nodeID]; ++pos) {
+    size_t idx = extra_trees_bins[pos - start];
+    ++n_right[idx];
+    ++class_counts_right[idx * num_classes + (*response_classIDs)[sampleIDs[pos]]];
+  }
 
-    // Count samples until split_value reached
-    for (size_t i = 0; i < num_splits; ++i) {
-      if (value > possible_split_values[i]) {
-        ++n_right[i];
-        ++class_counts_right[i * num_classes + sample_classID];
-      } else {
-        break;
-      }
+  // Cumulate from the right, position i + 1 then holds the samples right of split i
+  for (size_t i = num_splits; i > 0; --i) {
+    n_right[i - 1] += n_right[i];
+    for (size_t j = 0; j < num_classes; ++j) {
+      class_counts_right[(i - 1) * num_classes + j] += class_counts_right[i * num_classes + j];
     }
   }
 
@@ -609,8 +682,8 @@ void TreeClassification::findBestSplitValueExtraTrees(size_t nodeID, size_t varI
   for (size_t i = 0; i < num_splits; ++i) {
 
     // Stop if one child empty
-    size_t n_left = num_samples_node - n_right[i];
-    if (n_left == 0 || n_right[i] == 0) {
+    size_t n_left = num_samples_node - n_right[i + 1];
+    if (n_left == 0 || n_right[i + 1] == 0) {
       continue;
     }
 
@@ -618,7 +691,7 @@ void TreeClassification::findBestSplitValueExtraTrees(size_t nodeID, size_t varI
     double sum_left = 0;
     double sum_right = 0;
     for (size_t j = 0; j < num_classes; ++j) {
-      size_t class_count_right = class_counts_right[i * num_classes + j];
+      size_t class_count_right = class_counts_right[(i + 1) * num_classes + j];
       size_t class_count_left = class_counts[j] - class_count_right;
 
       sum_right += (*class_weights)[j] * class_count_right * class_count_right;
@@ -626,7 +699,7 @@ void TreeClassification::findBestSplitValueExtraTrees(size_t nodeID, size_t varI
     }
 
     // Decrease of impurity
-    double decrease = sum_left / (double) n_left + sum_right / (double) n_right[i];
+    double decrease = sum_left / (double) n_left + sum_right / (double) n_right[i + 1];
 
     // Regularization
     regularize(decrease, varID);
@@ -786,44 +859,20 @@ void TreeClassification::addGiniImportance(size_t nodeID, size_t varID, double d
 void TreeClassification::bootstrapClassWise() {
   // Number of samples is sum of sample fraction * number of samples
   size_t num_samples_inbag = 0;
-  double sum_sample_fraction = 0;
   for (auto& s : *sample_fraction) {
     num_samples_inbag += (size_t) num_samples * s;
-    sum_sample_fraction += s;
   }
-
-  // Reserve space, reserve a little more to be save)
   sampleIDs.reserve(num_samples_inbag);
-  oob_sampleIDs.reserve(num_samples * (exp(-sum_sample_fraction) + 0.1));
-
-  // Start with all samples OOB
-  inbag_counts.resize(num_samples, 0);
 
   // Draw samples for each class
   for (size_t i = 0; i < sample_fraction->size(); ++i) {
-    // Draw samples of class with replacement as inbag and mark as not OOB
+    // Draw samples of class with replacement as inbag
     size_t num_samples_class = (*sampleIDs_per_class)[i].size();
     size_t num_samples_inbag_class = round(num_samples * (*sample_fraction)[i]);
-    std::uniform_int_distribution<size_t> unif_dist(0, num_samples_class - 1);
     for (size_t s = 0; s < num_samples_inbag_class; ++s) {
-      size_t draw = (*sampleIDs_per_class)[i][unif_dist(random_number_generator)];
-      sampleIDs.push_back(draw);
-      ++inbag_counts[draw];
+      sampleIDs.push_back((*sampleIDs_per_class)[i][random_number_generator.bounded(num_samples_class)]);
     }
   }
-
-  // Save OOB samples
-  for (size_t s = 0; s < inbag_counts.size(); ++s) {
-    if (inbag_counts[s] == 0) {
-      oob_sampleIDs.push_back(s);
-    }
-  }
-  num_samples_oob = oob_sampleIDs.size();
-
-  if (!keep_inbag) {
-    inbag_counts.clear();
-    inbag_counts.shrink_to_fit();
-  }
 }
 
 void TreeClassification::bootstrapWithoutReplacementClassWise() {
@@ -832,17 +881,8 @@ void TreeClassification::bootstrapWithoutReplacementClassWise() {
     size_t num_samples_class = (*sampleIDs_per_class)[i].size();
     size_t num_samples_inbag_class = round(num_samples * (*sample_fraction)[i]);
 
-    shuffleAndSplitAppend(sampleIDs, oob_sampleIDs, num_samples_class, num_samples_inbag_class,
-        (*sampleIDs_per_class)[i], random_number_generator);
-  }
-  num_samples_oob = oob_sampleIDs.size();
-
-  if (keep_inbag) {
-    // All observation are 0 or 1 times inbag
-    inbag_counts.resize(num_samples, 1);
-    for (size_t i = 0; i < oob_sampleIDs.size(); i++) {
-      inbag_counts[oob_sampleIDs[i]] = 0;
-    }
+    drawWithoutReplacementSelection(sampleIDs, num_samples_class, num_samples_inbag_class,
+        &(*sampleIDs_per_class)[i], random_number_generator);
   }
 }
 
@@ -58,7 +58,8 @@ private:
   bool splitNodeInternal(size_t nodeID, std::vector<size_t>& possible_split_varIDs) override;
   void createEmptyNodeInternal() override;
 
-  double computePredictionAccuracyInternal(std::vector<double>* prediction_error_casewise) override;
+  double computePredictionAccuracyInternal(const std::vector<index_t>& terminal_nodeIDs,
+      std::vector<double>* prediction_error_casewise) const override;
   
   // Called by splitNodeInternal(). Sets split_varIDs and split_values.
   bool findBestSplit(size_t nodeID, std::vector<size_t>& possible_split_varIDs);
@@ -72,10 +73,21 @@ private:
   void findBestSplitValueLargeQ(size_t nodeID, size_t varID, size_t num_classes,
       const std::vector<size_t>& class_counts, size_t num_samples_node, double& best_value, size_t& best_varID,
       double& best_decrease);
+  void findBestSplitValueLargeQ(size_t varID, size_t num_classes, const std::vector<size_t>& class_counts,
+      size_t num_samples_node, double& best_value, size_t& best_varID, double& best_decrease, const size_t* counter,
+      const size_t* counter_per_class);
   void findBestSplitValueUnordered(size_t nodeID, size_t varID, size_t num_classes,
       const std::vector<size_t>& class_counts, size_t num_samples_node, double& best_value, size_t& best_varID,
       double& best_decrease);
 
+  void initSampleClassIDs() override;
+
+  // Level-wise growth, see Tree::prepareLevel()
+  bool supportsLevelWiseGrowth() const override {
+    return splitrule != EXTRATREES;
+  }
+  void findBestSplitValuesLevel(size_t varID, const std::vector<size_t>& level_nodes) override;
+
   bool findBestSplitExtraTrees(size_t nodeID, std::vector<size_t>& possible_split_varIDs);
   void findBestSplitValueExtraTrees(size_t nodeID, size_t varID, size_t num_classes,
       const std::vector<size_t>& class_counts, size_t num_samples_node, double& best_value, size_t& best_varID,
@@ -98,6 +110,10 @@ private:
     counter.shrink_to_fit();
     counter_per_class.clear();
     counter_per_class.shrink_to_fit();
+    node_indexes.clear();
+    node_indexes.shrink_to_fit();
+    counter_per_class_copies.clear();
+    counter_per_class_copies.shrink_to_fit();
   }
 
   // Classes of the dependent variable and classIDs for responses
@@ -113,6 +129,10 @@ private:
 
   std::vector<size_t> counter;
   std::vector<size_t> counter_per_class;
+
+  // Value indices of the node samples and copies of the histogram for countClassHistogram()
+  std::vector<index_t> node_indexes;
+  std::vector<size_t> counter_per_class_copies;
 };
 
 } // namespace ranger
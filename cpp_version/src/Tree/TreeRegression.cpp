@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <numeric>
 
 #include <ctime>
 
@@ -31,9 +32,9 @@ void TreeRegression::allocateMemory() {
   if (!memory_saving_splitting) {
     size_t max_num_splits = data->getMaxNumUniqueValues();
 
-    // Use number of random splits for extratrees
-    if (splitrule == EXTRATREES && num_random_splits > max_num_splits) {
-      max_num_splits = num_random_splits;
+    // Use number of random splits for extratrees, plus one for samples left of all splits
+    if (splitrule == EXTRATREES && num_random_splits + 1 > max_num_splits) {
+      max_num_splits = num_random_splits + 1;
     }
 
     counter.resize(max_num_splits);
@@ -68,23 +69,14 @@ bool TreeRegression::splitNodeInternal(size_t nodeID, std::vector<size_t>& possi
   }
 
   // Check if node is pure and set split_value to estimate and stop if pure
-  bool pure = true;
-  double pure_value = 0;
-  for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-    size_t sampleID = sampleIDs[pos];
-    double value = data->get_y(sampleID, 0);
-    if (pos != start_pos[nodeID] && value != pure_value) {
-      pure = false;
-      break;
-    }
-    pure_value = value;
-  }
-  if (pure) {
+  double pure_value;
+  if (isPureNode(nodeID, pure_value)) {
     split_values[nodeID] = pure_value;
     return true;
   }
 
   // Find best split, stop if no decrease of impurity
+  countSplitEvaluations(possible_split_varIDs);
   bool stop;
   if (splitrule == MAXSTAT) {
     stop = findBestSplitMaxstat(nodeID, possible_split_varIDs);
@@ -108,12 +100,13 @@ void TreeRegression::createEmptyNodeInternal() {
   // Empty on purpose
 }
 
-double TreeRegression::computePredictionAccuracyInternal(std::vector<double>* prediction_error_casewise) {
+double TreeRegression::computePredictionAccuracyInternal(const std::vector<index_t>& terminal_nodeIDs,
+    std::vector<double>* prediction_error_casewise) const {
 
-  size_t num_predictions = prediction_terminal_nodeIDs.size();
+  size_t num_predictions = terminal_nodeIDs.size();
   double sum_of_squares = 0;
   for (size_t i = 0; i < num_predictions; ++i) {
-    size_t terminal_nodeID = prediction_terminal_nodeIDs[i];
+    size_t terminal_nodeID = terminal_nodeIDs[i];
     double predicted_value = split_values[terminal_nodeID];
     double real_value = data->get_y(oob_sampleIDs[i], 0);
     if (predicted_value != real_value) {
@@ -122,6 +115,8 @@ double TreeRegression::computePredictionAccuracyInternal(std::vector<double>* pr
         (*prediction_error_casewise)[i] = diff;
       }
       sum_of_squares += diff;
+    } else if (prediction_error_casewise) {
+      (*prediction_error_casewise)[i] = 0;
     }
   }
   return (1.0 - sum_of_squares / (double) num_predictions);
@@ -145,7 +140,15 @@ bool TreeRegression::findBestSplit(size_t nodeID, std::vector<size_t>& possible_
   for (auto& varID : possible_split_varIDs) {
 
     // Find best split value, if ordered consider all values as split values, else all 2-partitions
-    if (data->isOrderedVariable(varID)) {
+    double level_decrease, level_value;
+    if (getLevelSplit(nodeID, varID, level_decrease, level_value)) {
+      // Prepared for all nodes of the level
+      if (level_decrease > best_decrease) {
+        best_value = level_value;
+        best_varID = varID;
+        best_decrease = level_decrease;
+      }
+    } else if (data->isOrderedVariable(varID)) {
 
       // Use memory saving method if option set
       if (memory_saving_splitting) {
@@ -189,7 +192,7 @@ void TreeRegression::findBestSplitValueSmallQ(size_t nodeID, size_t varID, doubl
 
   // Create possible split values
   std::vector<double> possible_split_values;
-  data->getAllValues(possible_split_values, sampleIDs, varID, start_pos[nodeID], end_pos[nodeID]);
+  getAllNodeValues(possible_split_values, nodeID, varID);
 
   // Try next variable if all equal for this
   if (possible_split_values.size() < 2) {
@@ -211,13 +214,13 @@ void TreeRegression::findBestSplitValueSmallQ(size_t nodeID, size_t varID, doubl
 }
 
 void TreeRegression::findBestSplitValueSmallQ(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
-    double& best_value, size_t& best_varID, double& best_decrease, std::vector<double> possible_split_values,
+    double& best_value, size_t& best_varID, double& best_decrease, const std::vector<double>& possible_split_values,
     std::vector<double>& sums, std::vector<size_t>& counter) {
 
   for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
     size_t sampleID = sampleIDs[pos];
     size_t idx = std::lower_bound(possible_split_values.begin(), possible_split_values.end(),
-        data->get_x(sampleID, varID)) - possible_split_values.begin();
+        getNodeValue(pos, varID)) - possible_split_values.begin();
 
     sums[idx] += data->get_y(sampleID, 0);
     ++counter[idx];
@@ -280,6 +283,14 @@ void TreeRegression::findBestSplitValueLargeQ(size_t nodeID, size_t varID, doubl
     ++counter[index];
   }
 
+  findBestSplitValueLargeQ(varID, sum_node, num_samples_node, best_value, best_varID, best_decrease, sums.data(),
+      counter.data());
+}
+
+void TreeRegression::findBestSplitValueLargeQ(size_t varID, double sum_node, size_t num_samples_node,
+    double& best_value, size_t& best_varID, double& best_decrease, const double* sums, const size_t* counter) {
+
+  size_t num_unique = data->getNumUniqueDataValues(varID);
   size_t n_left = 0;
   double sum_left = 0;
 
@@ -327,6 +338,71 @@ void TreeRegression::findBestSplitValueLargeQ(size_t nodeID, size_t varID, doubl
   }
 }
 
+void TreeRegression::findBestSplitValuesLevel(size_t varID, const std::vector<size_t>& level_nodes) {
+
+  // Memory saving splitting: Split each node on the values read for the level, as in findBestSplit()
+  if (memory_saving_splitting) {
+    for (auto& level_node : level_nodes) {
+      size_t nodeID = level_start + level_node;
+      double sum_node = 0;
+      for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+        sum_node += data->get_y(sampleIDs[pos], 0);
+      }
+      double best_value = 0;
+      size_t best_varID = 0;
+      double best_decrease = -1;
+      findBestSplitValueSmallQ(nodeID, varID, sum_node, end_pos[nodeID] - start_pos[nodeID], best_value, best_varID,
+          best_decrease);
+      setLevelSplit(level_node, varID, best_decrease, best_value);
+    }
+    return;
+  }
+
+  size_t num_unique = data->getNumUniqueDataValues(varID);
+
+  // Histograms of all nodes side by side, grow the counters if needed
+  size_t num_bins = level_nodes.size() * num_unique;
+  if (counter.size() < num_bins) {
+    counter.resize(num_bins);
+    sums.resize(num_bins);
+  }
+  std::fill_n(counter.begin(), num_bins, 0);
+  std::fill_n(sums.begin(), num_bins, 0);
+
+  // Sum responses, samples in ascending order
+  for (auto& sampleID : level_sampleIDs) {
+    size_t slot = level_node_slots[level_node_of_sample[sampleID]];
+    if (slot == NO_LEVEL_NODE) {
+      continue;
+    }
+    size_t index = slot * num_unique + data->getIndex(sampleID, varID);
+    size_t count = level_sample_counts[sampleID];
+
+    sums[index] += count * data->get_y(sampleID, 0);
+    counter[index] += count;
+  }
+
+  // Find best split value of each node
+  for (size_t slot = 0; slot < level_nodes.size(); ++slot) {
+    const double* node_sums = sums.data() + slot * num_unique;
+    const size_t* node_counter = counter.data() + slot * num_unique;
+    size_t nodeID = level_start + level_nodes[slot];
+    size_t num_samples_node = end_pos[nodeID] - start_pos[nodeID];
+
+    // Sum of responses in node as in findBestSplit()
+    double sum_node = 0;
+    for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+      sum_node += data->get_y(sampleIDs[pos], 0);
+    }
+    double best_value = 0;
+    size_t best_varID = 0;
+    double best_decrease = -1;
+    findBestSplitValueLargeQ(varID, sum_node, num_samples_node, best_value, best_varID, best_decrease, node_sums,
+        node_counter);
+    setLevelSplit(level_nodes[slot], varID, best_decrease, best_value);
+  }
+}
+
 void TreeRegression::findBestSplitValueUnordered(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
     double& best_value, size_t& best_varID, double& best_decrease) {
 
@@ -396,15 +472,29 @@ void TreeRegression::findBestSplitValueUnordered(size_t nodeID, size_t varID, do
 bool TreeRegression::findBestSplitMaxstat(size_t nodeID, std::vector<size_t>& possible_split_varIDs) {
 
   size_t num_samples_node = end_pos[nodeID] - start_pos[nodeID];
+  bool presorted = !presorted_sampleIDs.empty();
+
+  // Positions in order for presorted samples
+  std::vector<size_t> in_order;
+  if (presorted) {
+    in_order.resize(num_samples_node);
+    std::iota(in_order.begin(), in_order.end(), 0);
+  }
 
   // Compute ranks
+  const index_t* response_sampleIDs = presorted ? getPresortedSampleIDs(num_presorted_variables) : sampleIDs.data();
   std::vector<double> response;
   response.reserve(num_samples_node);
   for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-    size_t sampleID = sampleIDs[pos];
+    size_t sampleID = response_sampleIDs[pos];
     response.push_back(data->get_y(sampleID, 0));
   }
-  std::vector<double> ranks = rank(response);
+  std::vector<double> ranks;
+  if (presorted) {
+    setPresortedScores(nodeID, rank(response, in_order));
+  } else {
+    ranks = rank(response);
+  }
 
   // Save split stats
   std::vector<double> pvalues;
@@ -419,28 +509,31 @@ bool TreeRegression::findBestSplitMaxstat(size_t nodeID, std::vector<size_t>& po
   // Compute p-values
   for (auto& varID : possible_split_varIDs) {
 
-    // Get all observations
+    // Get all observations, ordered by x
     std::vector<double> x;
-    x.reserve(num_samples_node);
-    for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-      size_t sampleID = sampleIDs[pos];
-      x.push_back(data->get_x(sampleID, varID));
+    std::vector<double> x_ranks;
+    std::vector<size_t> node_order;
+    if (presorted) {
+      getPresortedValues(nodeID, varID, x, x_ranks);
+    } else {
+      x.reserve(num_samples_node);
+      for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+        size_t sampleID = sampleIDs[pos];
+        x.push_back(data->get_x(sampleID, varID));
+      }
+      node_order = order(x, false);
     }
-
-    // Order by x
-    std::vector<size_t> indices = order(x, false);
-    //std::vector<size_t> indices = orderInData(data, sampleIDs[nodeID], varID, false);
+    const std::vector<double>& scores = presorted ? x_ranks : ranks;
+    const std::vector<size_t>& indices = presorted ? in_order : node_order;
 
     // Compute maximally selected rank statistics
     double best_maxstat;
     double best_split_value;
-    maxstat(ranks, x, indices, best_maxstat, best_split_value, minprop, 1 - minprop);
-    //maxstatInData(scores, data, sampleIDs[nodeID], varID, indices, best_maxstat, best_split_value, minprop, 1 - minprop);
+    maxstat(scores, x, indices, best_maxstat, best_split_value, minprop, 1 - minprop);
 
     if (best_maxstat > -1) {
       // Compute number of samples left of cutpoints
       std::vector<size_t> num_samples_left = numSamplesLeftOfCutpoint(x, indices);
-      //std::vector<size_t> num_samples_left = numSamplesLeftOfCutpointInData(data, sampleIDs[nodeID], varID, indices);
 
       // Compute p-values
       double pvalue_lau92 = maxstatPValueLau92(best_maxstat, minprop, 1 - minprop);
@@ -545,75 +638,57 @@ bool TreeRegression::findBestSplitExtraTrees(size_t nodeID, std::vector<size_t>&
 void TreeRegression::findBestSplitValueExtraTrees(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
     double& best_value, size_t& best_varID, double& best_decrease) {
 
-  // Get min/max values of covariate in node
-  double min;
-  double max;
-  data->getMinMaxValues(min, max, sampleIDs, varID, start_pos[nodeID], end_pos[nodeID]);
-
-  // Try next variable if all equal for this
-  if (min == max) {
-    return;
-  }
-
-  // Create possible split values: Draw randomly between min and max
+  // Draw split values and bin the samples, try next variable if all equal for this
   std::vector<double> possible_split_values;
-  std::uniform_real_distribution<double> udist(min, max);
-  possible_split_values.reserve(num_random_splits);
-  for (size_t i = 0; i < num_random_splits; ++i) {
-    possible_split_values.push_back(udist(random_number_generator));
-  }
-  if (num_random_splits > 1) {
-    std::sort(possible_split_values.begin(), possible_split_values.end());
+  if (!drawExtraTreesSplits(nodeID, varID, possible_split_values)) {
+    return;
   }
 
   const size_t num_splits = possible_split_values.size();
   if (memory_saving_splitting) {
-    std::vector<double> sums_right(num_splits);
-    std::vector<size_t> n_right(num_splits);
+    std::vector<double> sums_right(num_splits + 1);
+    std::vector<size_t> n_right(num_splits + 1);
     findBestSplitValueExtraTrees(nodeID, varID, sum_node, num_samples_node, best_value, best_varID, best_decrease,
         possible_split_values, sums_right, n_right);
   } else {
-    std::fill_n(sums.begin(), num_splits, 0);
-    std::fill_n(counter.begin(), num_splits, 0);
+    std::fill_n(sums.begin(), num_splits + 1, 0);
+    std::fill_n(counter.begin(), num_splits + 1, 0);
     findBestSplitValueExtraTrees(nodeID, varID, sum_node, num_samples_node, best_value, best_varID, best_decrease,
         possible_split_values, sums, counter);
   }
 }
 
 void TreeRegression::findBestSplitValueExtraTrees(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
-    double& best_value, size_t& best_varID, double& best_decrease, std::vector<double> possible_split_values,
+    double& best_value, size_t& best_varID, double& best_decrease, const std::vector<double>& possible_split_values,
     std::vector<double>& sums_right, std::vector<size_t>& n_right) {
   const size_t num_splits = possible_split_values.size();
 
-  // Sum in right child and possbile split
-  for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-    size_t sampleID = sampleIDs[pos];
-    double value = data->get_x(sampleID, varID);
-    double response = data->get_y(sampleID, 0);
+  // Sum by bin, the number of split values below the sample value
+  const size_t start = start_pos[nodeID];
+  for (size_t pos = start; pos < end_pos[nodeID]; ++pos) {
+    size_t idx = extra_trees_bins[pos - start];
+    ++n_right[idx];
+    sums_right[idx] += data->get_y(sampleIDs[pos], 0);
+  }
 
-    // Count samples until split_value reached
-    for (size_t i = 0; i < num_splits; ++i) {
-      if (value > possible_split_values[i]) {
-        ++n_right[i];
-        sums_right[i] += response;
-      } else {
-        break;
-      }
-    }
+  // Cumulate from the right, position i + 1 then holds the samples right of split i
+  for (size_t i = num_splits; i > 0; --i) {
+    n_right[i - 1] += n_right[i];
+    sums_right[i - 1] += sums_right[i];
   }
 
   // Compute decrease of impurity for each possible split
   for (size_t i = 0; i < num_splits; ++i) {
 
     // Stop if one child empty
-    size_t n_left = num_samples_node - n_right[i];
-    if (n_left == 0 || n_right[i] == 0) {
+    size_t n_left = num_samples_node - n_right[i + 1];
+    if (n_left == 0 || n_right[i + 1] == 0) {
       continue;
     }
 
-    double sum_right = sums_right[i];
+    double sum_right = sums_right[i + 1];
     double sum_left = sum_node - sum_right;
-    double decrease = sum_left * sum_left / (double) n_left + sum_right * sum_right / (double) n_right[i];
+    double decrease = sum_left * sum_left / (double) n_left + sum_right * sum_right / (double) n_right[i + 1];
 
     // Regularization
     regularize(decrease, varID);
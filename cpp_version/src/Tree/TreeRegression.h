@@ -51,27 +51,36 @@ private:
   bool splitNodeInternal(size_t nodeID, std::vector<size_t>& possible_split_varIDs) override;
   void createEmptyNodeInternal() override;
 
-  double computePredictionAccuracyInternal(std::vector<double>* prediction_error_casewise) override;
+  double computePredictionAccuracyInternal(const std::vector<index_t>& terminal_nodeIDs,
+      std::vector<double>* prediction_error_casewise) const override;
   
   // Called by splitNodeInternal(). Sets split_varIDs and split_values.
   bool findBestSplit(size_t nodeID, std::vector<size_t>& possible_split_varIDs);
   void findBestSplitValueSmallQ(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
       double& best_value, size_t& best_varID, double& best_decrease);
   void findBestSplitValueSmallQ(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
-      double& best_value, size_t& best_varID, double& best_decrease, std::vector<double> possible_split_values,
+      double& best_value, size_t& best_varID, double& best_decrease, const std::vector<double>& possible_split_values,
       std::vector<double>& sums, std::vector<size_t>& counter);
   void findBestSplitValueLargeQ(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
       double& best_value, size_t& best_varID, double& best_decrease);
+  void findBestSplitValueLargeQ(size_t varID, double sum_node, size_t num_samples_node, double& best_value,
+      size_t& best_varID, double& best_decrease, const double* sums, const size_t* counter);
   void findBestSplitValueUnordered(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
       double& best_value, size_t& best_varID, double& best_decrease);
 
+  // Level-wise growth, see Tree::prepareLevel()
+  bool supportsLevelWiseGrowth() const override {
+    return splitrule != MAXSTAT && splitrule != EXTRATREES && splitrule != BETA;
+  }
+  void findBestSplitValuesLevel(size_t varID, const std::vector<size_t>& level_nodes) override;
+
   bool findBestSplitMaxstat(size_t nodeID, std::vector<size_t>& possible_split_varIDs);
 
   bool findBestSplitExtraTrees(size_t nodeID, std::vector<size_t>& possible_split_varIDs);
   void findBestSplitValueExtraTrees(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
       double& best_value, size_t& best_varID, double& best_decrease);
   void findBestSplitValueExtraTrees(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
-      double& best_value, size_t& best_varID, double& best_decrease, std::vector<double> possible_split_values,
+      double& best_value, size_t& best_varID, double& best_decrease, const std::vector<double>& possible_split_values,
       std::vector<double>& sums_right, std::vector<size_t>& n_right);
   void findBestSplitValueExtraTreesUnordered(size_t nodeID, size_t varID, double sum_node, size_t num_samples_node,
       double& best_value, size_t& best_varID, double& best_decrease);
@@ -73,12 +73,13 @@ void TreeSurvival::computeSurvival(size_t nodeID) {
   chf[nodeID] = chf_temp;
 }
 
-double TreeSurvival::computePredictionAccuracyInternal(std::vector<double>* prediction_error_casewise) {
+double TreeSurvival::computePredictionAccuracyInternal(const std::vector<index_t>& terminal_nodeIDs,
+    std::vector<double>* prediction_error_casewise) const {
 
   // Compute summed chf for samples
   std::vector<double> sum_chf;
-  for (size_t i = 0; i < prediction_terminal_nodeIDs.size(); ++i) {
-    size_t terminal_nodeID = prediction_terminal_nodeIDs[i];
+  for (size_t i = 0; i < terminal_nodeIDs.size(); ++i) {
+    size_t terminal_nodeID = terminal_nodeIDs[i];
     sum_chf.push_back(std::accumulate(chf[terminal_nodeID].begin(), chf[terminal_nodeID].end(), 0.0));
   }
 
@@ -109,6 +110,7 @@ bool TreeSurvival::splitNodeInternal(size_t nodeID, std::vector<size_t>& possibl
     return true;
   }
 
+  countSplitEvaluations(possible_split_varIDs);
   if (splitrule == MAXSTAT) {
     return findBestSplitMaxstat(nodeID, possible_split_varIDs);
   } else if (splitrule == EXTRATREES) {
@@ -185,17 +187,32 @@ bool TreeSurvival::findBestSplitMaxstat(size_t nodeID, std::vector<size_t>& poss
     return true;
   }
 
+  bool presorted = !presorted_sampleIDs.empty();
+
+  // Positions in order for presorted samples
+  std::vector<size_t> in_order;
+  if (presorted) {
+    in_order.resize(num_samples_node);
+    std::iota(in_order.begin(), in_order.end(), 0);
+  }
+
   // Compute scores
+  const index_t* response_sampleIDs = presorted ? getPresortedSampleIDs(num_presorted_variables) : sampleIDs.data();
   std::vector<double> time;
   time.reserve(num_samples_node);
   std::vector<double> status;
   status.reserve(num_samples_node);
   for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-    size_t sampleID = sampleIDs[pos];
+    size_t sampleID = response_sampleIDs[pos];
     time.push_back(data->get_y(sampleID, 0));
     status.push_back(data->get_y(sampleID, 1));
   }
-  std::vector<double> scores = logrankScores(time, status);
+  std::vector<double> node_scores;
+  if (presorted) {
+    setPresortedScores(nodeID, logrankScores(time, status, in_order));
+  } else {
+    node_scores = logrankScores(time, status);
+  }
 
   // Save split stats
   std::vector<double> pvalues;
@@ -210,28 +227,31 @@ bool TreeSurvival::findBestSplitMaxstat(size_t nodeID, std::vector<size_t>& poss
   // Compute p-values
   for (auto& varID : possible_split_varIDs) {
 
-    // Get all observations
+    // Get all observations, ordered by x
     std::vector<double> x;
-    x.reserve(num_samples_node);
-    for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
-      size_t sampleID = sampleIDs[pos];
-      x.push_back(data->get_x(sampleID, varID));
+    std::vector<double> x_scores;
+    std::vector<size_t> node_order;
+    if (presorted) {
+      getPresortedValues(nodeID, varID, x, x_scores);
+    } else {
+      x.reserve(num_samples_node);
+      for (size_t pos = start_pos[nodeID]; pos < end_pos[nodeID]; ++pos) {
+        size_t sampleID = sampleIDs[pos];
+        x.push_back(data->get_x(sampleID, varID));
+      }
+      node_order = order(x, false);
     }
-
-    // Order by x
-    std::vector<size_t> indices = order(x, false);
-    //std::vector<size_t> indices = orderInData(data, sampleIDs[nodeID], varID, false);
+    const std::vector<double>& scores = presorted ? x_scores : node_scores;
+    const std::vector<size_t>& indices = presorted ? in_order : node_order;
 
     // Compute maximally selected rank statistics
     double best_maxstat;
     double best_split_value;
     maxstat(scores, x, indices, best_maxstat, best_split_value, minprop, 1 - minprop);
-    //maxstatInData(scores, data, sampleIDs[nodeID], varID, indices, best_maxstat, best_split_value, minprop, 1 - minprop);
 
     if (best_maxstat > -1) {
       // Compute number of samples left of cutpoints
       std::vector<size_t> num_samples_left = numSamplesLeftOfCutpoint(x, indices);
-      //std::vector<size_t> num_samples_left = numSamplesLeftOfCutpointInData(data, sampleIDs[nodeID], varID, indices);
 
       // Remove largest cutpoint (all observations left)
       num_samples_left.pop_back();
@@ -55,7 +55,8 @@ private:
 
   void createEmptyNodeInternal() override;
   void computeSurvival(size_t nodeID);
-  double computePredictionAccuracyInternal(std::vector<double>* prediction_error_casewise) override;
+  double computePredictionAccuracyInternal(const std::vector<index_t>& terminal_nodeIDs,
+      std::vector<double>* prediction_error_casewise) const override;
   
   bool splitNodeInternal(size_t nodeID, std::vector<size_t>& possible_split_varIDs) override;
 
@@ -12,6 +12,8 @@ R package "ranger" under GPL3 license.
 #ifndef GLOBALS_H_
 #define GLOBALS_H_
 
+#include <cstdint>
+
 namespace ranger {
 
 #ifndef M_PI
@@ -29,6 +31,15 @@ namespace ranger {
 
 typedef unsigned int uint;
 
+// Index type for sampleIDs and nodeIDs stored in trees. 32 bit indices halve the memory
+// traffic of the sample and node arrays compared to size_t; compile with RANGER_64BIT_INDEX
+// for data with more than 4 billion samples.
+#ifdef RANGER_64BIT_INDEX
+typedef uint64_t index_t;
+#else
+typedef uint32_t index_t;
+#endif
+
 // Tree types, probability is not selected by ID
 enum TreeType {
   TREE_CLASSIFICATION = 1,
@@ -42,9 +53,12 @@ enum MemoryMode {
   MEM_DOUBLE = 0,
   MEM_FLOAT = 1,
   MEM_CHAR = 2,
-  MEM_INT = 3
+  MEM_INT = 3,
+  MEM_UINT8 = 4,
+  MEM_HALF = 5,
+  MEM_ADAPTIVE = 6
 };
-const uint MAX_MEM_MODE = 3;
+const uint MAX_MEM_MODE = 6;
 
 // Mask and Offset to store 2 bit values in bytes
 static const int mask[4] = {192,48,12,3};
@@ -79,6 +93,12 @@ enum PredictionType {
   TERMINALNODES = 2
 };
 
+// Prediction backend
+enum PredictionBackend {
+  BACKEND_TRAVERSAL = 1,
+  BACKEND_QUICKSCORER = 2
+};
+
 // Default values
 const uint DEFAULT_NUM_TREE = 500;
 const uint DEFAULT_NUM_THREADS = 0;
@@ -95,17 +115,25 @@ const double DEFAULT_MINPROP = 0.1;
 
 const uint DEFAULT_MAXDEPTH = 0;
 const PredictionType DEFAULT_PREDICTIONTYPE = RESPONSE;
+const PredictionBackend DEFAULT_PREDICTION_BACKEND = BACKEND_TRAVERSAL;
 const uint DEFAULT_NUM_RANDOM_SPLITS = 1;
 
 const double DEFAULT_SAMPLE_FRACTION_REPLACE = 1;
 const double DEFAULT_SAMPLE_FRACTION_NOREPLACE = 0.632;
 
+// Regularization: splits of a tree are taken into account from this many trees later on, so that trees can be grown
+// in parallel with results independent of the number of threads
+const uint REGULARIZATION_TREE_LAG = 16;
+
 // Interval to print progress in seconds
 const double STATUS_INTERVAL = 30.0;
 
 // Threshold for q value split method switch
 const double Q_THRESHOLD = 0.02;
 
+// Maximal value range of integer variables sorted by counting instead of comparison sort
+const double MAX_COUNTING_SORT_RANGE = 65536;
+
 } // namespace ranger
 
 #endif /* GLOBALS_H_ */
@@ -21,6 +21,7 @@
 #include "ForestRegression.h"
 #include "ForestSurvival.h"
 #include "ForestProbability.h"
+#include "PredictionServer.h"
 #include "utility.h"
 
 using namespace ranger;
@@ -52,6 +53,11 @@ void run_ranger(const ArgumentHandler& arg_handler, std::ostream& verbose_out) {
     forest = make_unique_ranger<ForestProbability>();
     break;
   }
+  if (arg_handler.stats) {
+    forest->enableRunStats();
+  }
+  forest->setOutOfCoreFile(arg_handler.outofcore);
+  forest->setLevelWiseGrowth(arg_handler.levelwise);
   verbose_out<<"About to initialize forest" <<std::endl;
   // Call Ranger
   verbose_out <<"Initializing forest." <<std::endl;
@@ -63,13 +69,37 @@ void run_ranger(const ArgumentHandler& arg_handler, std::ostream& verbose_out) {
       arg_handler.alpha, arg_handler.minprop, arg_handler.holdout, arg_handler.predictiontype,
       arg_handler.randomsplits, arg_handler.maxdepth, arg_handler.regcoef, arg_handler.usedepth, arg_handler.writetoimg,
       arg_handler.imgwidth, arg_handler.imgheight, arg_handler.batchtrain, arg_handler.kernelsize);
+  forest->setPredictionBackend(arg_handler.backend);
+  forest->setFixedPointPrediction(arg_handler.fixedpoint, arg_handler.fixedpointcheck);
+
+  // Keep the forest loaded and answer prediction requests
+  if (!arg_handler.serve.empty()) {
+    PredictionServer server(*forest, arg_handler.writetoimg, &verbose_out);
+    if (arg_handler.serve == "-") {
+      server.serveStream(std::cin, std::cout);
+    } else {
+      server.serveSocket(arg_handler.serve);
+    }
+    forest->writeRunStats();
+    verbose_out << "Finished Ranger." << std::endl;
+    return;
+  }
+
   verbose_out <<"Calling forest.run()"<<std::endl;
   forest->run(true, !arg_handler.skipoob);
 
   if (arg_handler.write) {
-    forest->saveToFile();
+    if (arg_handler.compactforest) {
+      forest->saveToCompactFile(arg_handler.quantize);
+    } else {
+      forest->saveToFile();
+    }
+  }
+  if (arg_handler.exportcpp) {
+    forest->exportToCpp();
   }
   forest->writeOutput();
+  forest->writeRunStats();
   verbose_out << "Finished Ranger." << std::endl;
 }
 
@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <cstdlib>
+#include <new>
+
+#include "RunStats.h"
+
+#ifndef R_BUILD
+// Count allocated bytes, only while a RunStats object exists
+void* operator new(size_t size) {
+  ranger::RunStats::countAllocation(size);
+  void* ptr = std::malloc(size > 0 ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+#endif
@@ -16,6 +16,7 @@
 #include "ArgumentHandler.h"
 #include "version.h"
 #include "utility.h"
+#include "CompactForest.h"
 
 // relevant STB headers
 //#define STB_IMAGE_IMPLEMENTATION
@@ -24,12 +25,14 @@
 namespace ranger {
 
 ArgumentHandler::ArgumentHandler(int argc, char **argv) :
-    caseweights(""), depvarname(""),  fraction(0), holdout(false), kernelsize(3), batchtrain(false), memmode(MEM_DOUBLE), savemem(false), skipoob(false), predict(
-        ""), predictiontype(DEFAULT_PREDICTIONTYPE), randomsplits(DEFAULT_NUM_RANDOM_SPLITS), splitweights(""), nthreads(
-        DEFAULT_NUM_THREADS), predall(false), alpha(DEFAULT_ALPHA), minprop(DEFAULT_MINPROP), maxdepth(
-        DEFAULT_MAXDEPTH), file(""), mask(""), impmeasure(DEFAULT_IMPORTANCE_MODE), targetpartitionsize(0), mtry(0), outprefix(
+    batchtrain(false), caseweights(""), depvarname(""), kernelsize(3), serve(""), fraction(0), compactforest(false), quantize(
+        false), exportcpp(false), holdout(false), fixedpoint(false), fixedpointcheck(false), memmode(MEM_DOUBLE), savemem(false), skipoob(false), predict(
+        ""), predictiontype(DEFAULT_PREDICTIONTYPE), backend(DEFAULT_PREDICTION_BACKEND), randomsplits(
+        DEFAULT_NUM_RANDOM_SPLITS), splitweights(""), stats(false), nthreads(DEFAULT_NUM_THREADS), outofcore(""), predall(
+        false), levelwise(false), alpha(DEFAULT_ALPHA), minprop(DEFAULT_MINPROP), maxdepth(DEFAULT_MAXDEPTH), file(""), imgheight(
+        0), imgwidth(0), mask(""), impmeasure(DEFAULT_IMPORTANCE_MODE), targetpartitionsize(0), mtry(0), outprefix(
         "ranger_out"), probability(false), splitrule(DEFAULT_SPLITRULE), statusvarname(""), ntree(DEFAULT_NUM_TREE), replace(
-        true), verbose(false), writetoimg(false), write(false), treetype(TREE_CLASSIFICATION), seed(0), usedepth(false), imgwidth(0), imgheight(0) {
+        true), verbose(false), writetoimg(false), write(false), treetype(TREE_CLASSIFICATION), seed(0), usedepth(false) {
   this->argc = argc;
   this->argv = argv;
 }
@@ -37,7 +40,7 @@ ArgumentHandler::ArgumentHandler(int argc, char **argv) :
 int ArgumentHandler::processArguments() {
 
   // short options
-  char const *short_options = "A:BC:D:F:HK:M:NOP:Q:R:S:U:WXZa:b:c:d:e:f:hi:j:kl:m:o:pr:s:t:uvwy:z:";
+  char const *short_options = "A:BC:D:E:F:GHIJK:L:M:NOP:Q:R:S:TU:V:WXYZa:b:c:d:e:f:hi:j:kl:m:o:pqr:s:t:uvwxy:z:";
 
 // long options: longname, no/optional/required argument?, flag(not used!), shortname
     const struct option long_options[] = {
@@ -47,8 +50,14 @@ int ArgumentHandler::processArguments() {
       { "caseweights",          required_argument,  0, 'C'},
       { "depvarname",           required_argument,  0, 'D'},
       { "fraction",             required_argument,  0, 'F'},
+      { "backend",              required_argument,  0, 'E'},
+      { "compactforest",        no_argument,        0, 'G'},
+      { "quantize",             no_argument,        0, 'q'},
       { "holdout",              no_argument,        0, 'H'},
+      { "fixedpoint",           no_argument,        0, 'I'},
+      { "fixedpointcheck",      no_argument,        0, 'J'},
       { "kernelsize",           required_argument,  0, 'K'},
+      { "serve",                required_argument,  0, 'L'},
       { "memmode",              required_argument,  0, 'M'},
       { "savemem",              no_argument,        0, 'N'},
       { "skipoob",              no_argument,        0, 'O'},
@@ -56,9 +65,12 @@ int ArgumentHandler::processArguments() {
       { "predictiontype",       required_argument,  0, 'Q'},
       { "randomsplits",         required_argument,  0, 'R'},
       { "splitweights",         required_argument,  0, 'S'},
+      { "stats",                no_argument,        0, 'T'},
       { "nthreads",             required_argument,  0, 'U'},
+      { "outofcore",            required_argument,  0, 'V'},
       { "writetoimg",           no_argument,        0, 'W'},
       { "predall",              no_argument,        0, 'X'},
+      { "levelwise",            no_argument,        0, 'Y'},
       { "version",              no_argument,        0, 'Z'},
 
       { "alpha",                required_argument,  0, 'a'},
@@ -81,6 +93,7 @@ int ArgumentHandler::processArguments() {
       { "noreplace",            no_argument,        0, 'u'},
       { "verbose",              no_argument,        0, 'v'},
       { "write",                no_argument,        0, 'w'},
+      { "exportcpp",            no_argument,        0, 'x'},
       { "treetype",             required_argument,  0, 'y'},
       { "seed",                 required_argument,  0, 'z'},
 
@@ -127,10 +140,44 @@ int ArgumentHandler::processArguments() {
       }
       break;
 
+    case 'E':
+      try {
+        switch (std::stoi(optarg)) {
+        case 1:
+          backend = BACKEND_TRAVERSAL;
+          break;
+        case 2:
+          backend = BACKEND_QUICKSCORER;
+          break;
+        default:
+          throw std::runtime_error("");
+          break;
+        }
+      } catch (...) {
+        throw std::runtime_error("Illegal prediction backend selected. See '--help' for details.");
+      }
+      break;
+
+    case 'G':
+      compactforest = true;
+      break;
+
+    case 'q':
+      quantize = true;
+      break;
+
     case 'H':
       holdout = true;
       break;
 
+    case 'I':
+      fixedpoint = true;
+      break;
+
+    case 'J':
+      fixedpointcheck = true;
+      break;
+
     case 'K':
       kernelsize = atoi(optarg);
       break;
@@ -191,10 +238,18 @@ int ArgumentHandler::processArguments() {
       }
       break;
 
+    case 'L':
+      serve = optarg;
+      break;
+
     case 'S':
       splitweights = optarg;
       break;
 
+    case 'T':
+      stats = true;
+      break;
+
     case 'U':
       try {
         int temp = std::stoi(optarg);
@@ -209,6 +264,10 @@ int ArgumentHandler::processArguments() {
       }
       break;
 
+    case 'V':
+      outofcore = optarg;
+      break;
+
     case 'W':
       writetoimg = true;
       break;
@@ -217,6 +276,10 @@ int ArgumentHandler::processArguments() {
       predall = true;
       break;
 
+    case 'Y':
+      levelwise = true;
+      break;
+
     case 'Z':
       displayVersion();
       return -1;
@@ -401,6 +464,10 @@ int ArgumentHandler::processArguments() {
       write = true;
       break;
 
+    case 'x':
+      exportcpp = true;
+      break;
+
     case 'y':
       try {
         switch (std::stoi(optarg)) {
@@ -512,7 +579,9 @@ void ArgumentHandler::checkArguments() {
   }
 
   // Get treetype for prediction
-  if (!predict.empty()) {
+  if (!predict.empty() && CompactForest::isCompactForestFile(predict)) {
+    treetype = CompactForest(predict).getTreeType();
+  } else if (!predict.empty()) {
     std::ifstream infile;
     infile.open(predict, std::ios::binary);
     if (!infile.good()) {
@@ -548,6 +617,53 @@ void ArgumentHandler::checkArguments() {
     throw std::runtime_error("Writing to an image is supported for classification forests only (including probability forests). \n Please select a different forest type with '--treetype' or a different filename with '--file'. \n See '--help' for details. ");
   }
 
+  if (compactforest && !write) {
+    throw std::runtime_error("Option '--compactforest' requires '--write'.");
+  }
+  if (compactforest && treetype == TREE_SURVIVAL) {
+    throw std::runtime_error("Option '--compactforest' is not supported for survival forests.");
+  }
+  if (backend != BACKEND_TRAVERSAL && predict.empty()) {
+    throw std::runtime_error("Option '--backend' requires '--predict'.");
+  }
+  if (backend != BACKEND_TRAVERSAL && treetype == TREE_SURVIVAL) {
+    throw std::runtime_error("Option '--backend' is not supported for survival forests.");
+  }
+  if (fixedpointcheck && !fixedpoint) {
+    throw std::runtime_error("Option '--fixedpointcheck' requires '--fixedpoint'.");
+  }
+  if (fixedpoint && predict.empty()) {
+    throw std::runtime_error("Option '--fixedpoint' requires '--predict'.");
+  }
+  if (fixedpoint && treetype != TREE_CLASSIFICATION && treetype != TREE_PROBABILITY) {
+    throw std::runtime_error("Option '--fixedpoint' is only available for classification and probability forests.");
+  }
+  if (fixedpoint && backend == BACKEND_QUICKSCORER) {
+    throw std::runtime_error("Option '--fixedpoint' cannot be combined with '--backend 2'.");
+  }
+  if (!serve.empty() && predict.empty()) {
+    throw std::runtime_error("Option '--serve' requires '--predict'.");
+  }
+  if (serve == "-" && verbose) {
+    throw std::runtime_error("Option '--serve -' answers on standard output and cannot be combined with '--verbose'.");
+  }
+  if (exportcpp && !predict.empty() && CompactForest::isCompactForestFile(predict)) {
+    throw std::runtime_error("Option '--exportcpp' is not supported for version 2 forest files.");
+  }
+  if (quantize && !compactforest) {
+    throw std::runtime_error("Option '--quantize' requires '--compactforest'.");
+  }
+  if (!outofcore.empty() && !predict.empty()) {
+    throw std::runtime_error("Option '--outofcore' is only available for training.");
+  }
+  if (!outofcore.empty() && (memmode == MEM_HALF || memmode == MEM_ADAPTIVE)) {
+    throw std::runtime_error("Option '--outofcore' is not available for memory modes 5 and 6.");
+  }
+
+  if (levelwise && !predict.empty()) {
+    throw std::runtime_error("Option '--levelwise' is only available for training.");
+  }
+
   if (predict.empty() && predall) {
     throw std::runtime_error("Option '--predall' only available in prediction mode.");
   }
@@ -579,8 +695,8 @@ void ArgumentHandler::checkArguments() {
   }
 
   // Memory save option not allowed in unordered extratrees mode
-  if (splitrule == EXTRATREES && !catvars.empty() && savemem) {
-    throw std::runtime_error("savemem option not possible in extraTrees mode with unordered predictors.");
+  if (splitrule == EXTRATREES && !catvars.empty() && (savemem || !outofcore.empty())) {
+    throw std::runtime_error("savemem and outofcore options not possible in extraTrees mode with unordered predictors.");
   }
 
   // Corrected impurity importance not allowed if split weights used
@@ -598,11 +714,6 @@ void ArgumentHandler::checkArguments() {
         throw std::runtime_error("The regularization coefficients must be positive.");
       }
     }
-
-    if (nthreads != 1) {
-      std::cout << "Warning: Parallelization deactivated (regularization used)." << std::endl;
-      nthreads = 1;
-    }
   }
 }
 
@@ -615,6 +726,9 @@ void ArgumentHandler::displayHelp() {
   std::cout << "    " << "--help                        Print this help." << std::endl;
   std::cout << "    " << "--version                     Print version and citation information." << std::endl;
   std::cout << "    " << "--verbose                     Turn on verbose mode." << std::endl;
+  std::cout << "    " << "--stats                       Save wall and CPU time per phase, allocated bytes, tree sizes and split"
+      << std::endl;
+  std::cout << "    " << "                              evaluations per variable to <outprefix>.stats.json." << std::endl;
   std::cout << "    " << "--batch                       Batch load data (load all files in the folder indicated by '--file'). Supported for training only." << std::endl;
   std::cout << "    " << "--file FILE                   Filename of input data. Only numerical values and images are supported."
       << std::endl;
@@ -667,6 +781,15 @@ void ArgumentHandler::displayHelp() {
   std::cout << "    "
       << "                              Categorical variables must contain only positive integer values." << std::endl;
   std::cout << "    " << "--write                       Save forest to file <outprefix>.forest." << std::endl;
+  std::cout << "    " << "--compactforest               Save forest in compact version 2 format with 32 bit thresholds. The file is"
+      << std::endl;
+  std::cout << "    " << "                              memory mapped for prediction. Use with --write." << std::endl;
+  std::cout << "    " << "--quantize                    Additionally store 8 bit thresholds in the compact forest if all split variables"
+      << std::endl;
+  std::cout << "    " << "                              are integers in 0..255, e.g. image data. Use with --compactforest." << std::endl;
+  std::cout << "    " << "--exportcpp                   Write forest as C++ source file <outprefix>.cpp with constants compiled in."
+      << std::endl;
+  std::cout << "    " << "                              Predictions of the generated predict() are identical to ranger." << std::endl;
   std::cout << "    "
       << "--predict FILE                Load forest from FILE and predict with new data. The new data is expected in the exact same "
       << std::endl;
@@ -686,6 +809,33 @@ void ArgumentHandler::displayHelp() {
   std::cout << "    "
       << "                              TYPE = 2: Return terminal node IDs per tree for new observations." << std::endl;
   std::cout << "    " << "                              (Default: 1)" << std::endl;
+  std::cout << "    " << "--backend TYPE                Set engine to find terminal nodes in prediction mode to:" << std::endl;
+  std::cout << "    " << "                              TYPE = 1: Traverse each tree." << std::endl;
+  std::cout << "    "
+      << "                              TYPE = 2: QuickScorer, evaluate split nodes of all trees grouped by variable"
+      << std::endl;
+  std::cout << "    " << "                                        with 64 bit leaf bitvectors. Trees with more than 64 leaves are"
+      << std::endl;
+  std::cout << "    " << "                                        scored on their upper levels and traversed below." << std::endl;
+  std::cout << "    " << "                              (Default: 1)" << std::endl;
+  std::cout << "    " << "--fixedpoint                  Predict with 8 bit thresholds and fixed point leaf probabilities, without floating"
+      << std::endl;
+  std::cout << "    " << "                              point operations in tree traversal and aggregation. All split variables have to"
+      << std::endl;
+  std::cout << "    " << "                              be integers in 0..255." << std::endl;
+  std::cout << "    " << "--fixedpointcheck             With '--fixedpoint', also compute the floating point prediction and report"
+      << std::endl;
+  std::cout << "    " << "                              the maximum deviation from it." << std::endl;
+  std::cout << "    " << "--serve SOCKET                Keep the forest of '--predict' loaded and answer prediction requests on the"
+      << std::endl;
+  std::cout << "    " << "                              Unix domain socket SOCKET, or on standard input and output if SOCKET is '-'."
+      << std::endl;
+  std::cout << "    " << "                              '--file' is loaded at startup to check the forest. Requests, one per line:"
+      << std::endl;
+  std::cout << "    " << "                              predict FILE PREFIX: Predict FILE, write PREFIX.prediction or PREFIX.png."
+      << std::endl;
+  std::cout << "    " << "                              values N: Predict the following N lines of variable values." << std::endl;
+  std::cout << "    " << "                              quit: Stop the server." << std::endl;
   std::cout << "    " << "--impmeasure TYPE             Set importance mode to:" << std::endl;
   std::cout << "    " << "                              TYPE = 0: none." << std::endl;
   std::cout << "    "
@@ -754,8 +904,28 @@ void ArgumentHandler::displayHelp() {
   std::cout << "    " << "                              MODE = 1: float." << std::endl;
   std::cout << "    " << "                              MODE = 2: char." << std::endl;
   std::cout << "    " << "                              MODE = 3: int." << std::endl;
+  std::cout << "    " << "                              MODE = 4: unsigned 8 bit integer (0..255)." << std::endl;
+  std::cout << "    " << "                              MODE = 5: half precision." << std::endl;
+  std::cout << "    " << "                              MODE = 6: adaptive, narrowest exact type for each variable"
+      << std::endl;
+  std::cout << "    " << "                                        (bits, 8 or 16 bit integer, half, float or double)."
+      << std::endl;
   std::cout << "    " << "                              (Default: 0)" << std::endl;
   std::cout << "    " << "--savemem                     Use memory saving (but slower) splitting mode." << std::endl;
+  std::cout << "    " << "--outofcore FILE              Keep the training data in the memory-mapped file FILE instead of memory, for"
+      << std::endl;
+  std::cout << "    " << "                              data larger than the main memory. The file is overwritten and removed,"
+      << std::endl;
+  std::cout << "    " << "                              its disk space is released at exit. Implies '--savemem'. With"
+      << std::endl;
+  std::cout << "    " << "                              '--levelwise' the columns are read sequentially." << std::endl;
+  std::cout << "    " << "--levelwise                   Grow the trees level by level, the histograms of all nodes of a level are"
+      << std::endl;
+  std::cout << "    " << "                              built in one pass over the samples. With '--savemem' and '--outofcore'"
+      << std::endl;
+  std::cout << "    " << "                              the values of the level are read in one pass instead. Not used with"
+      << std::endl;
+  std::cout << "    " << "                              '--regcoef' and the extratrees, maxstat and beta splitrules." << std::endl;
   std::cout << std::endl;
 
   std::cout << "See README file for details and examples." << std::endl;
@@ -53,17 +53,27 @@ public:
   std::string caseweights;
   std::string depvarname;
   int kernelsize;
+  std::string serve;
   double fraction;
+  bool compactforest;
+  bool quantize;
+  bool exportcpp;
   bool holdout;
+  bool fixedpoint;
+  bool fixedpointcheck;
   MemoryMode memmode;
   bool savemem;
   bool skipoob;
   std::string predict;
   PredictionType predictiontype;
+  PredictionBackend backend;
   uint randomsplits;
   std::string splitweights;
+  bool stats;
   uint nthreads;
+  std::string outofcore;
   bool predall;
+  bool levelwise;
 
   // All command line arguments as member: Small letters
   double alpha;
@@ -15,9 +15,13 @@
 #include <algorithm>
 #include <iterator>
 #include <dirent.h>
+#ifndef OLD_WIN_R_BUILD
+#include <thread>
+#endif
 
 #include "Data.h"
 #include "utility.h"
+#include "Simd.h"
 
 // relevant STB headers
 #define STB_IMAGE_IMPLEMENTATION
@@ -30,8 +34,8 @@
 namespace ranger {
 
 Data::Data() :
-    num_rows(0), num_rows_rounded(0), num_cols(0), snp_data(0), num_cols_no_snp(0), externalData(true), index_data(0), max_num_unique_values(
-        0), order_snps(false) {
+    num_rows(0), num_rows_rounded(0), num_cols(0), snp_data(0), num_cols_no_snp(0), externalData(true), index_data_width(0), max_num_unique_values(
+        0), num_shadow_cols(0), order_snps(false) {
 }
 
 size_t Data::getVariableID(const std::string& variable_name) const {
@@ -341,6 +345,28 @@ bool Data::loadFromFileAlex(std::string filename, std::string mask_filename, std
   }
 }
 
+bool Data::loadFromValues(const std::vector<std::string>& variable_names, const std::vector<double>& values,
+    size_t num_rows) {
+  if (values.size() != num_rows * variable_names.size()) {
+    throw std::runtime_error("Number of values is not equal to number of rows times number of variables.");
+  }
+
+  this->variable_names = variable_names;
+  this->num_rows = num_rows;
+  num_cols = variable_names.size();
+  num_cols_no_snp = num_cols;
+  reserveMemory(0);
+
+  bool error = false;
+  for (size_t row = 0; row < num_rows; ++row) {
+    for (size_t col = 0; col < num_cols; ++col) {
+      set_x(col, row, values[row * num_cols + col], error);
+    }
+  }
+  externalData = false;
+  return error;
+}
+
 bool Data::loadFromFileWhitespaceAlex(std::ifstream& input_file, std::string header_line,
     std::vector<std::string>& dependent_variable_names, size_t row_start) {
   size_t num_dependent_variables = dependent_variable_names.size();
@@ -497,47 +523,58 @@ bool Data::loadFromImg(std::string img_path, std::string mask_path, size_t kerne
   uint8_t *img = stbi_load(img_path.c_str(), &width_load, &height_load, &channels_load, 0);
   //TODO: check if dims match?
   //std::cout<<"WxHxC="<<width_load<<"x"<<height_load<<"x"<<channels_load<<"\n";
-  size_t row = row_start;
   bool error = false;
   int max_offset = std::floor(kernel_size/2);
-  for(int i = 0; i < width; i++) {
-    for (int j = 0; j < height; j++) {
-      size_t column_x = 0;
-      //Loop over image kernel
-      for(int k = i-max_offset; k <= i+max_offset; k++) {
-        for(int l = j-max_offset; l <= j+max_offset; l++) {
-          //Ensure we stay in bounds of the img
-          int kcol = k;
-          int lrow = l;
-          if(k < 0) {
-            kcol = 0;
-          } else if (k >=width) {
-            kcol = width-1;
-          }
-          if(l < 0) {
-            lrow = 0;
-          } else if (l >= height) {
-            lrow = height-1;
+
+  // Split channels into planes, transposed to the order of the rows (x outer, y inner)
+  std::vector<uint8_t> planes(3 * width * height);
+  std::vector<uint8_t> line(3 * width);
+  for (size_t j = 0; j < height; ++j) {
+    deinterleavePixels(img + channels * width * j, width, channels, line.data(), line.data() + width,
+        line.data() + 2 * width);
+    for (size_t c = 0; c < 3; ++c) {
+      uint8_t* plane = planes.data() + c * width * height;
+      for (size_t i = 0; i < width; ++i) {
+        plane[i * height + j] = line[c * width + i];
+      }
+    }
+  }
+
+  // For each image column and kernel position the values of all rows of a column in the data are a shifted image
+  // column, repeat the edge pixels to stay in bounds of the img
+  std::vector<uint8_t> column_values(height);
+  for (int i = 0; i < (int) width; i++) {
+    size_t column_x = 0;
+    for (int k = i - max_offset; k <= i + max_offset; k++) {
+      int kcol = std::min(std::max(k, 0), (int) width - 1);
+      for (int l = -max_offset; l <= max_offset; l++) {
+        int first = std::min(std::max(-l, 0), (int) height);
+        int last = std::max(std::min((int) height - l, (int) height), first);
+        for (size_t c = 0; c < 3; ++c) {
+          const uint8_t* image_column = planes.data() + c * width * height + kcol * height;
+          std::fill(column_values.begin(), column_values.begin() + first, image_column[0]);
+          if (last > first) {
+            std::copy(image_column + first + l, image_column + last + l, column_values.begin() + first);
           }
-          //Assume 3 channels for R, G, B
-          //std::cout<<"num_rows="<<num_rows<<", num_cols="<<num_cols<<"\n";
-          int offset = (channels) * ((width * lrow) + kcol);
-          int r_px = img[offset];
-          set_x(column_x, row, r_px, error);
-          column_x += 1;
-          int g_px = img[offset + 1];
-          set_x(column_x, row, g_px, error);
-          column_x += 1;
-          int b_px = img[offset + 2];
-          set_x(column_x, row, b_px, error);
+          std::fill(column_values.begin() + last, column_values.end(), image_column[height - 1]);
+          set_x_column(column_x, row_start + i * height, column_values.data(), height, error);
           column_x += 1;
-          //std::cout<<"Set x with column_x="<<column_x<<", row="<<row<<", b_px="<<b_px<<"\n";
         }
       }
-      row += 1;
     }
   }
+  size_t row = row_start + width * height;
   num_rows = row;
+
+  // Name variables by channel and kernel position (R00, G00, B00, R01, ..) like the CSV exports
+  if (variable_names.size() != num_cols) {
+    variable_names.clear();
+    for (size_t col = 0; col < num_cols; ++col) {
+      size_t kernel_pos = col / 3;
+      variable_names.push_back(
+          std::string(1, "RGB"[col % 3]) + (kernel_pos < 10 ? "0" : "") + std::to_string(kernel_pos));
+    }
+  }
   //std::cout<<"about to free img\n";
   stbi_image_free(img);
   //std::cout<<"freed img\n";
@@ -812,7 +849,7 @@ bool Data::loadFromFileOtherAlex(std::ifstream& input_file, std::string header_l
 }
 // #nocov end
 
-void Data::getAllValues(std::vector<double>& all_values, std::vector<size_t>& sampleIDs, size_t varID, size_t start,
+void Data::getAllValues(std::vector<double>& all_values, const std::vector<index_t>& sampleIDs, size_t varID, size_t start,
     size_t end) const {
 
   // All values for varID (no duplicates) for given sampleIDs
@@ -830,7 +867,7 @@ void Data::getAllValues(std::vector<double>& all_values, std::vector<size_t>& sa
   }
 }
 
-void Data::getMinMaxValues(double& min, double&max, std::vector<size_t>& sampleIDs, size_t varID, size_t start,
+void Data::getMinMaxValues(double& min, double&max, const std::vector<index_t>& sampleIDs, size_t varID, size_t start,
     size_t end) const {
   if (sampleIDs.size() > 0) {
     min = get_x(sampleIDs[start], varID);
@@ -847,34 +884,138 @@ void Data::getMinMaxValues(double& min, double&max, std::vector<size_t>& sampleI
   }
 }
 
-void Data::sort() {
+void Data::getValues(std::vector<double>& values, const std::vector<index_t>& sampleIDs, size_t varID, size_t start,
+    size_t end) const {
+  values.resize(end - start);
+  for (size_t pos = start; pos < end; ++pos) {
+    values[pos - start] = get_x(sampleIDs[pos], varID);
+  }
+}
+
+bool Data::isUint8Variable(size_t varID) const {
+  for (size_t row = 0; row < num_rows; ++row) {
+    double value = get_x(row, varID);
+    if (!(value >= 0 && value <= 255) || value != floor(value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Data::sort(uint num_threads) {
+
+  // For all columns, get unique values
+  unique_data_values.clear();
+  unique_data_values.resize(num_cols_no_snp);
+  forEachColumn(num_threads, [this](size_t col) {findUniqueValues(col);});
+  for (auto& unique_values : unique_data_values) {
+    if (unique_values.size() > max_num_unique_values) {
+      max_num_unique_values = unique_values.size();
+    }
+  }
+
+  // Use the narrowest index type for all unique values and save index for each observation
+  if (max_num_unique_values <= 256) {
+    index_data_width = 1;
+    index_data_8.resize(num_cols_no_snp * num_rows);
+    forEachColumn(num_threads, [this](size_t col) {fillIndexData(col, index_data_8);});
+  } else if (max_num_unique_values <= 65536) {
+    index_data_width = 2;
+    index_data_16.resize(num_cols_no_snp * num_rows);
+    forEachColumn(num_threads, [this](size_t col) {fillIndexData(col, index_data_16);});
+  } else {
+    index_data_width = sizeof(index_t);
+    index_data_wide.resize(num_cols_no_snp * num_rows);
+    forEachColumn(num_threads, [this](size_t col) {fillIndexData(col, index_data_wide);});
+  }
+}
 
-  // Reserve memory
-  index_data.resize(num_cols_no_snp * num_rows);
+void Data::materializeShadowColumns(uint num_threads) {
+  // Index data only exists if sorted
+  switch (index_data_width) {
+  case 0:
+    break;
+  case 1:
+    appendPermutedColumns(index_data_8, num_threads);
+    break;
+  case 2:
+    appendPermutedColumns(index_data_16, num_threads);
+    break;
+  default:
+    appendPermutedColumns(index_data_wide, num_threads);
+  }
+  num_shadow_cols = num_cols_no_snp;
+}
 
-  // For all columns, get unique values and save index for each observation
+void Data::forEachColumn(uint num_threads, const std::function<void(size_t)>& function) const {
+  if (num_cols_no_snp == 0) {
+    return;
+  }
+#ifdef OLD_WIN_R_BUILD
   for (size_t col = 0; col < num_cols_no_snp; ++col) {
+    function(col);
+  }
+#else
+  if (num_threads <= 1) {
+    for (size_t col = 0; col < num_cols_no_snp; ++col) {
+      function(col);
+    }
+    return;
+  }
+  std::vector<uint> col_ranges;
+  equalSplit(col_ranges, 0, num_cols_no_snp - 1, num_threads);
+  std::vector<std::thread> threads;
+  threads.reserve(col_ranges.size() - 1);
+  for (size_t i = 0; i + 1 < col_ranges.size(); ++i) {
+    threads.emplace_back([&function, &col_ranges, i]() {
+      for (size_t col = col_ranges[i]; col < col_ranges[i + 1]; ++col) {
+        function(col);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+#endif
+}
 
-    // Get all unique values
-    std::vector<double> unique_values(num_rows);
-    for (size_t row = 0; row < num_rows; ++row) {
-      unique_values[row] = get_x(row, col);
+void Data::findUniqueValues(size_t col) {
+  std::vector<double>& unique_values = unique_data_values[col];
+  if (num_rows == 0) {
+    return;
+  }
+
+  // Integer variables with small range (e.g. image channels) are sorted by counting
+  double min = get_x(0, col);
+  double max = min;
+  bool integer = true;
+  for (size_t row = 0; row < num_rows; ++row) {
+    double value = get_x(row, col);
+    if (value != floor(value)) {
+      integer = false;
+      break;
     }
-    std::sort(unique_values.begin(), unique_values.end());
-    unique_values.erase(unique(unique_values.begin(), unique_values.end()), unique_values.end());
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
 
-    // Get index of unique value
+  if (integer && max - min < MAX_COUNTING_SORT_RANGE) {
+    std::vector<bool> found(max - min + 1, false);
     for (size_t row = 0; row < num_rows; ++row) {
-      size_t idx = std::lower_bound(unique_values.begin(), unique_values.end(), get_x(row, col))
-          - unique_values.begin();
-      index_data[col * num_rows + row] = idx;
+      found[get_x(row, col) - min] = true;
     }
-
-    // Save unique values
-    unique_data_values.push_back(unique_values);
-    if (unique_values.size() > max_num_unique_values) {
-      max_num_unique_values = unique_values.size();
+    for (size_t i = 0; i < found.size(); ++i) {
+      if (found[i]) {
+        unique_values.push_back(min + i);
+      }
     }
+  } else {
+    unique_values.resize(num_rows);
+    for (size_t row = 0; row < num_rows; ++row) {
+      unique_values[row] = get_x(row, col);
+    }
+    std::sort(unique_values.begin(), unique_values.end());
+    unique_values.erase(unique(unique_values.begin(), unique_values.end()), unique_values.end());
   }
 }
 
@@ -13,12 +13,16 @@
 #define DATA_H_
 
 #include <vector>
+#include <cmath>
 #include <iostream>
 #include <numeric>
 #include <random>
 #include <algorithm>
+#include <functional>
+#include <type_traits>
 
 #include "globals.h"
+#include "RandomGenerator.h"
 
 namespace ranger {
 
@@ -39,8 +43,19 @@ public:
   virtual void reserveMemory(size_t y_cols) = 0;
 
   virtual void set_x(size_t col, size_t row, double value, bool& error) = 0;
+
+  // Set a column from 8 bit values, starting at row_start
+  virtual void set_x_column(size_t col, size_t row_start, const uint8_t* values, size_t num_values, bool& error) {
+    for (size_t i = 0; i < num_values; ++i) {
+      set_x(col, row_start + i, values[i], error);
+    }
+  }
   virtual void set_y(size_t col, size_t row, double value, bool& error) = 0;
 
+  // Called once after all values are set
+  virtual void packColumns() {
+  }
+
   void addSnpData(unsigned char* snp_data, size_t num_cols_snp);
 
   bool batchDataLoader(std::string dirpath, std::string mask_dirpath, std::vector<std::string>& dependent_variable_names,
@@ -52,6 +67,9 @@ public:
       std::vector<std::string>& dependent_variable_names, char seperator);
   bool loadFromFileAlex(std::string filename, std::string eval_filename, std::vector<std::string>& dependent_variable_names,
       bool batch_data, size_t kernel_size);
+  // Load values of independent variables only, row-major with one row per sample
+  bool loadFromValues(const std::vector<std::string>& variable_names, const std::vector<double>& values,
+      size_t num_rows);
   bool loadFromImg(std::string img_path, std::string mask_path, size_t kernel_size, size_t width,
       size_t height, size_t channels, size_t row_start);
   bool loadFromFileWhitespaceAlex(std::ifstream& input_file, std::string header_line,
@@ -63,27 +81,66 @@ public:
       std::vector<std::string>& dependent_variable_names, char separator, bool whitespace);
   std::tuple<size_t, size_t, size_t> getImgDims(std::string img_path);
 
-  void getAllValues(std::vector<double>& all_values, std::vector<size_t>& sampleIDs, size_t varID, size_t start,
-      size_t end) const;
+  virtual void getAllValues(std::vector<double>& all_values, const std::vector<index_t>& sampleIDs, size_t varID,
+      size_t start, size_t end) const;
+
+  virtual void getMinMaxValues(double& min, double&max, const std::vector<index_t>& sampleIDs, size_t varID,
+      size_t start, size_t end) const;
 
-  void getMinMaxValues(double& min, double&max, std::vector<size_t>& sampleIDs, size_t varID, size_t start,
-      size_t end) const;
+  // Values of varID for the samples at positions start to end of sampleIDs, in that order
+  virtual void getValues(std::vector<double>& values, const std::vector<index_t>& sampleIDs, size_t varID,
+      size_t start, size_t end) const;
+
+  // As getValues() for columns stored as integers of up to 16 bits, false for other columns
+  virtual bool getIntegerValues(std::vector<int32_t>& values, const std::vector<index_t>& sampleIDs, size_t varID,
+      size_t start, size_t end) const {
+    return false;
+  }
 
   size_t getIndex(size_t row, size_t col) const {
-    // Use permuted data for corrected impurity importance
+    // Use permuted data for corrected impurity importance, stored after the data if materialized
     size_t col_permuted = col;
-    if (col >= num_cols) {
+    if (col >= num_cols + num_shadow_cols) {
       col = getUnpermutedVarID(col);
       row = getPermutedSampleID(row);
     }
 
-    if (col < num_cols_no_snp) {
-      return index_data[col * num_rows + row];
+    if (col < num_cols_no_snp || col >= num_cols) {
+      size_t idx = col * num_rows + row;
+      switch (index_data_width) {
+      case 1:
+        return index_data_8[idx];
+      case 2:
+        return index_data_16[idx];
+      default:
+        return index_data_wide[idx];
+      }
     } else {
       return getSnp(row, col, col_permuted);
     }
   }
 
+  // Indices of the samples sampleIDs[start..end) in a contiguous array, the index width is resolved once
+  void getIndexes(const std::vector<index_t>& sampleIDs, size_t col, size_t start, size_t end, index_t* result) const {
+    if (col >= num_cols_no_snp && (col < num_cols || col >= num_cols + num_shadow_cols)) {
+      for (size_t pos = start; pos < end; ++pos) {
+        *result++ = getIndex(sampleIDs[pos], col);
+      }
+      return;
+    }
+    switch (index_data_width) {
+    case 1:
+      gatherIndexes(index_data_8.data() + col * num_rows, sampleIDs, start, end, result);
+      break;
+    case 2:
+      gatherIndexes(index_data_16.data() + col * num_rows, sampleIDs, start, end, result);
+      break;
+    default:
+      gatherIndexes(index_data_wide.data() + col * num_rows, sampleIDs, start, end, result);
+      break;
+    }
+  }
+
   // #nocov start (cannot be tested anymore because GenABEL not on CRAN)
   size_t getSnp(size_t row, size_t col, size_t col_permuted) const {
     // Get data out of snp storage. -1 because of GenABEL coding.
@@ -135,7 +192,11 @@ public:
     }
   }
 
-  void sort();
+  // True if all values of the variable are integers in 0..255
+  bool isUint8Variable(size_t varID) const;
+
+  // Get unique values and index of each observation, columns are split between threads
+  void sort(uint num_threads);
 
   void orderSnpLevels(bool corrected_importance);
 
@@ -175,6 +236,11 @@ public:
     this->is_ordered_variable = is_ordered_variable;
   }
 
+  // SNP variables have the values 0, 1 and 2
+  bool isSnpVariable(size_t varID) const {
+    return getUnpermutedVarID(varID) >= num_cols_no_snp;
+  }
+
   bool isOrderedVariable(size_t varID) const {
     // Use permuted data for corrected impurity importance
     if (varID >= num_cols) {
@@ -183,12 +249,17 @@ public:
     return is_ordered_variable[varID];
   }
 
-  void permuteSampleIDs(std::mt19937_64 random_number_generator) {
+  void permuteSampleIDs(RandomGenerator random_number_generator) {
     permuted_sampleIDs.resize(num_rows);
     std::iota(permuted_sampleIDs.begin(), permuted_sampleIDs.end(), 0);
     std::shuffle(permuted_sampleIDs.begin(), permuted_sampleIDs.end(), random_number_generator);
   }
 
+  // Store the permuted columns (except SNPs) after the data and the index data, the shadow variables are then read
+  // sequentially instead of through permuted_sampleIDs. Doubles the memory for the data, columns are split between
+  // threads.
+  virtual void materializeShadowColumns(uint num_threads);
+
   size_t getPermutedSampleID(size_t sampleID) const {
     return permuted_sampleIDs[sampleID];
   }
@@ -212,6 +283,87 @@ public:
   // #nocov end
 
 protected:
+  // Integers 0..255 are stored exactly, other values are rounded and saturated and set the error
+  static uint8_t toUint8(double value, bool& error) {
+    if (value >= 0 && value <= 255 && value == floor(value)) {
+      return value;
+    }
+    error = true;
+    if (value > 255) {
+      return 255;
+    } else if (value >= 0) {
+      return std::round(value);
+    } else {
+      return 0;
+    }
+  }
+
+  // Convert to the value type of a template data class, unsigned 8 bit values are checked with toUint8
+  template<typename T>
+  static typename std::enable_if<!std::is_same<T, uint8_t>::value, T>::type convertValue(double value, bool& error) {
+    return value;
+  }
+  template<typename T>
+  static typename std::enable_if<std::is_same<T, uint8_t>::value, T>::type convertValue(double value, bool& error) {
+    return toUint8(value, error);
+  }
+
+  // Call function for each column in num_threads threads
+  void forEachColumn(uint num_threads, const std::function<void(size_t)>& function) const;
+
+  void findUniqueValues(size_t col);
+
+  // Append the permuted copy of each non-SNP column, column-major with num_rows values per column
+  template<typename T>
+  void appendPermutedColumns(std::vector<T>& values, uint num_threads) {
+    values.resize((num_cols + num_cols_no_snp) * num_rows);
+    forEachColumn(num_threads, [this, &values](size_t col) {
+      const T* column = values.data() + col * num_rows;
+      T* permuted_column = values.data() + (num_cols + col) * num_rows;
+      for (size_t row = 0; row < num_rows; ++row) {
+        permuted_column[row] = column[permuted_sampleIDs[row]];
+      }
+    });
+  }
+
+  template<typename T>
+  static void gatherIndexes(const T* column, const std::vector<index_t>& sampleIDs, size_t start, size_t end,
+      index_t* result) {
+    for (size_t pos = start; pos < end; ++pos) {
+      *result++ = column[sampleIDs[pos]];
+    }
+  }
+
+  template<typename T>
+  void fillIndexData(size_t col, std::vector<T>& index_data) {
+    const std::vector<double>& unique_values = unique_data_values[col];
+    T* col_index_data = index_data.data() + col * num_rows;
+    if (unique_values.empty()) {
+      return;
+    }
+
+    // Lookup table for integer variables with small range, binary search otherwise
+    double min = unique_values.front();
+    bool small_integer_range = unique_values.back() - min < MAX_COUNTING_SORT_RANGE;
+    for (size_t i = 0; small_integer_range && i < unique_values.size(); ++i) {
+      small_integer_range = unique_values[i] == floor(unique_values[i]);
+    }
+    if (small_integer_range) {
+      std::vector<T> lookup(unique_values.back() - min + 1, 0);
+      for (size_t i = 0; i < unique_values.size(); ++i) {
+        lookup[unique_values[i] - min] = i;
+      }
+      for (size_t row = 0; row < num_rows; ++row) {
+        col_index_data[row] = lookup[get_x(row, col) - min];
+      }
+    } else {
+      for (size_t row = 0; row < num_rows; ++row) {
+        col_index_data[row] = std::lower_bound(unique_values.begin(), unique_values.end(), get_x(row, col))
+            - unique_values.begin();
+      }
+    }
+  }
+
   std::vector<std::string> variable_names;
   size_t num_rows;
   size_t num_rows_rounded;
@@ -222,7 +374,12 @@ protected:
 
   bool externalData;
 
-  std::vector<size_t> index_data;
+  // Index of the unique value for each observation. Only one of the vectors is used, depending on the
+  // number of bytes needed for max_num_unique_values (index_data_width)
+  std::vector<uint8_t> index_data_8;
+  std::vector<uint16_t> index_data_16;
+  std::vector<index_t> index_data_wide;
+  uint index_data_width;
   std::vector<std::vector<double>> unique_data_values;
   size_t max_num_unique_values;
 
@@ -232,6 +389,9 @@ protected:
   // Permuted samples for corrected impurity importance
   std::vector<size_t> permuted_sampleIDs;
 
+  // Number of permuted columns stored after the data, 0 if not materialized
+  size_t num_shadow_cols;
+
   // Order of 0/1/2 for ordered splitting
   std::vector<std::vector<size_t>> snp_order;
   bool order_snps;
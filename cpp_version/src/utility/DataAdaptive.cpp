@@ -0,0 +1,272 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include "DataAdaptive.h"
+
+namespace ranger {
+
+const size_t DataAdaptive::NUM_COLUMN_TYPES;
+
+void DataAdaptive::packColumns() {
+  // Choose types and offsets in the vector of each type
+  size_t num_words = (num_rows + 63) / 64;
+  size_t num_values[NUM_COLUMN_TYPES] = { 0, 0, 0, 0, 0, 0 };
+  for (size_t col = 0; col < num_cols_no_snp; ++col) {
+    ColumnType type = findColumnType(x_double.data() + col * num_rows);
+    column_types[col] = type;
+    column_offsets[col] = num_values[type];
+    num_values[type] += (type == COLUMN_BIT) ? num_words : num_rows;
+  }
+
+  // Copy, double columns are moved to the front of a new vector
+  std::vector<double> packed_double;
+  packed_double.reserve(num_values[COLUMN_DOUBLE]);
+  x_bits.assign(num_values[COLUMN_BIT], 0);
+  x_uint8.resize(num_values[COLUMN_UINT8]);
+  x_uint16.resize(num_values[COLUMN_UINT16]);
+  x_half.resize(num_values[COLUMN_HALF]);
+  x_float.resize(num_values[COLUMN_FLOAT]);
+  for (size_t col = 0; col < num_cols_no_snp; ++col) {
+    const double* values = x_double.data() + col * num_rows;
+    size_t offset = column_offsets[col];
+    switch (column_types[col]) {
+    case COLUMN_BIT:
+      for (size_t row = 0; row < num_rows; ++row) {
+        x_bits[offset + row / 64] |= (uint64_t) values[row] << (row % 64);
+      }
+      break;
+    case COLUMN_UINT8:
+      for (size_t row = 0; row < num_rows; ++row) {
+        x_uint8[offset + row] = values[row];
+      }
+      break;
+    case COLUMN_UINT16:
+      for (size_t row = 0; row < num_rows; ++row) {
+        x_uint16[offset + row] = values[row];
+      }
+      break;
+    case COLUMN_HALF:
+      for (size_t row = 0; row < num_rows; ++row) {
+        x_half[offset + row] = floatToHalf(values[row]);
+      }
+      break;
+    case COLUMN_FLOAT:
+      for (size_t row = 0; row < num_rows; ++row) {
+        x_float[offset + row] = values[row];
+      }
+      break;
+    default:
+      packed_double.insert(packed_double.end(), values, values + num_rows);
+    }
+  }
+  x_double.swap(packed_double);
+}
+
+void DataAdaptive::getAllValues(std::vector<double>& all_values, const std::vector<index_t>& sampleIDs, size_t varID,
+    size_t start, size_t end) const {
+  if (varID >= num_cols_no_snp) {
+    Data::getAllValues(all_values, sampleIDs, varID, start, end);
+    return;
+  }
+
+  size_t offset = column_offsets[varID];
+  switch (column_types[varID]) {
+  case COLUMN_BIT: {
+    const uint64_t* words = x_bits.data() + offset;
+    getAllIntegerValues(all_values, 1, [words](size_t row) {return (words[row / 64] >> (row % 64)) & 1;}, sampleIDs,
+        start, end);
+    break;
+  }
+  case COLUMN_UINT8: {
+    const uint8_t* column = x_uint8.data() + offset;
+    getAllIntegerValues(all_values, 255, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_UINT16: {
+    const uint16_t* column = x_uint16.data() + offset;
+    getAllValuesSorted(all_values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_HALF: {
+    const uint16_t* column = x_half.data() + offset;
+    getAllValuesSorted(all_values, [column](size_t row) {return halfToFloat(column[row]);}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_FLOAT: {
+    const float* column = x_float.data() + offset;
+    getAllValuesSorted(all_values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  default: {
+    const double* column = x_double.data() + offset;
+    getAllValuesSorted(all_values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+  }
+  }
+}
+
+void DataAdaptive::getMinMaxValues(double& min, double& max, const std::vector<index_t>& sampleIDs, size_t varID,
+    size_t start, size_t end) const {
+  if (varID >= num_cols_no_snp) {
+    Data::getMinMaxValues(min, max, sampleIDs, varID, start, end);
+    return;
+  }
+
+  size_t offset = column_offsets[varID];
+  switch (column_types[varID]) {
+  case COLUMN_BIT: {
+    const uint64_t* words = x_bits.data() + offset;
+    findMinMax(min, max, [words](size_t row) {return (words[row / 64] >> (row % 64)) & 1;}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_UINT8: {
+    const uint8_t* column = x_uint8.data() + offset;
+    findMinMax(min, max, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_UINT16: {
+    const uint16_t* column = x_uint16.data() + offset;
+    findMinMax(min, max, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_HALF: {
+    const uint16_t* column = x_half.data() + offset;
+    findMinMax(min, max, [column](size_t row) {return halfToFloat(column[row]);}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_FLOAT: {
+    const float* column = x_float.data() + offset;
+    findMinMax(min, max, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  default: {
+    const double* column = x_double.data() + offset;
+    findMinMax(min, max, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+  }
+  }
+}
+
+void DataAdaptive::getValues(std::vector<double>& values, const std::vector<index_t>& sampleIDs, size_t varID,
+    size_t start, size_t end) const {
+  if (varID >= num_cols_no_snp) {
+    Data::getValues(values, sampleIDs, varID, start, end);
+    return;
+  }
+
+  size_t offset = column_offsets[varID];
+  switch (column_types[varID]) {
+  case COLUMN_BIT: {
+    const uint64_t* words = x_bits.data() + offset;
+    gatherValues(values, [words](size_t row) {return (words[row / 64] >> (row % 64)) & 1;}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_UINT8: {
+    const uint8_t* column = x_uint8.data() + offset;
+    gatherValues(values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_UINT16: {
+    const uint16_t* column = x_uint16.data() + offset;
+    gatherValues(values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_HALF: {
+    const uint16_t* column = x_half.data() + offset;
+    gatherValues(values, [column](size_t row) {return halfToFloat(column[row]);}, sampleIDs, start, end);
+    break;
+  }
+  case COLUMN_FLOAT: {
+    const float* column = x_float.data() + offset;
+    gatherValues(values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    break;
+  }
+  default: {
+    const double* column = x_double.data() + offset;
+    gatherValues(values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+  }
+  }
+}
+
+bool DataAdaptive::getIntegerValues(std::vector<int32_t>& values, const std::vector<index_t>& sampleIDs,
+    size_t varID, size_t start, size_t end) const {
+  if (varID >= num_cols_no_snp) {
+    return false;
+  }
+
+  size_t offset = column_offsets[varID];
+  switch (column_types[varID]) {
+  case COLUMN_BIT: {
+    const uint64_t* words = x_bits.data() + offset;
+    gatherValues(values, [words](size_t row) {return (words[row / 64] >> (row % 64)) & 1;}, sampleIDs, start, end);
+    return true;
+  }
+  case COLUMN_UINT8: {
+    const uint8_t* column = x_uint8.data() + offset;
+    gatherValues(values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    return true;
+  }
+  case COLUMN_UINT16: {
+    const uint16_t* column = x_uint16.data() + offset;
+    gatherValues(values, [column](size_t row) {return column[row];}, sampleIDs, start, end);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+DataAdaptive::ColumnType DataAdaptive::findColumnType(const double* values) const {
+  bool is_bit = true;
+  bool is_integer = true;
+  double max_integer = 0;
+  bool is_half = true;
+  bool is_float = true;
+  for (size_t row = 0; row < num_rows && is_float; ++row) {
+    double value = values[row];
+    if (value != value) {
+      // NaN is kept in half and float
+      is_bit = false;
+      is_integer = false;
+      continue;
+    }
+    if (is_integer) {
+      if (value >= 0 && value <= 65535 && value == floor(value)) {
+        is_bit = is_bit && value <= 1;
+        max_integer = std::max(max_integer, value);
+      } else {
+        is_bit = false;
+        is_integer = false;
+      }
+    }
+    float value_float = value;
+    if (value_float != value) {
+      is_float = false;
+      is_half = false;
+    } else if (is_half && halfToFloat(floatToHalf(value_float)) != value_float) {
+      is_half = false;
+    }
+  }
+
+  if (is_bit) {
+    return COLUMN_BIT;
+  } else if (is_integer && max_integer <= 255) {
+    return COLUMN_UINT8;
+  } else if (is_integer) {
+    return COLUMN_UINT16;
+  } else if (is_half) {
+    return COLUMN_HALF;
+  } else if (is_float) {
+    return COLUMN_FLOAT;
+  } else {
+    return COLUMN_DOUBLE;
+  }
+}
+
+} // namespace ranger
@@ -0,0 +1,192 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef DATAADAPTIVE_H_
+#define DATAADAPTIVE_H_
+
+#include <vector>
+#include <utility>
+
+#include "globals.h"
+#include "utility.h"
+#include "Data.h"
+#include "Simd.h"
+
+namespace ranger {
+
+// Values are loaded as double, then each column is stored in the narrowest type that represents all of its values
+// exactly: bits for 0/1 variables, unsigned 8 or 16 bit integers, half, float or double. No rounding occurs.
+class DataAdaptive: public Data {
+public:
+  enum ColumnType {
+    COLUMN_BIT = 0,
+    COLUMN_UINT8 = 1,
+    COLUMN_UINT16 = 2,
+    COLUMN_HALF = 3,
+    COLUMN_FLOAT = 4,
+    COLUMN_DOUBLE = 5
+  };
+  static const size_t NUM_COLUMN_TYPES = 6;
+
+  DataAdaptive() = default;
+
+  DataAdaptive(const DataAdaptive&) = delete;
+  DataAdaptive& operator=(const DataAdaptive&) = delete;
+
+  virtual ~DataAdaptive() override = default;
+
+  double get_x(size_t row, size_t col) const override {
+    // Use permuted data for corrected impurity importance
+    size_t col_permuted = col;
+    if (col >= num_cols) {
+      col = getUnpermutedVarID(col);
+      row = getPermutedSampleID(row);
+    }
+
+    if (col < num_cols_no_snp) {
+      size_t offset = column_offsets[col];
+      switch (column_types[col]) {
+      case COLUMN_BIT:
+        return (x_bits[offset + row / 64] >> (row % 64)) & 1;
+      case COLUMN_UINT8:
+        return x_uint8[offset + row];
+      case COLUMN_UINT16:
+        return x_uint16[offset + row];
+      case COLUMN_HALF:
+        return halfToFloat(x_half[offset + row]);
+      case COLUMN_FLOAT:
+        return x_float[offset + row];
+      default:
+        return x_double[offset + row];
+      }
+    } else {
+      return getSnp(row, col, col_permuted);
+    }
+  }
+
+  double get_y(size_t row, size_t col) const override {
+    return y[col * num_rows + row];
+  }
+
+  // All columns are double until packed
+  void reserveMemory(size_t y_cols) override {
+    x_double.resize(num_cols * num_rows);
+    y.resize(y_cols * num_rows);
+    column_types.assign(num_cols, COLUMN_DOUBLE);
+    column_offsets.resize(num_cols);
+    for (size_t col = 0; col < num_cols; ++col) {
+      column_offsets[col] = col * num_rows;
+    }
+  }
+
+  // Only before packing
+  void set_x(size_t col, size_t row, double value, bool& error) override {
+    x_double[col * num_rows + row] = value;
+  }
+
+  void set_x_column(size_t col, size_t row_start, const uint8_t* values, size_t num_values, bool& error) override {
+    convertBytes(values, num_values, x_double.data() + col * num_rows + row_start);
+  }
+
+  void set_y(size_t col, size_t row, double value, bool& error) override {
+    y[col * num_rows + row] = value;
+  }
+
+  void packColumns() override;
+
+  // Typed loops over the samples, the column type is selected once per call
+  void getAllValues(std::vector<double>& all_values, const std::vector<index_t>& sampleIDs, size_t varID,
+      size_t start, size_t end) const override;
+  void getMinMaxValues(double& min, double&max, const std::vector<index_t>& sampleIDs, size_t varID, size_t start,
+      size_t end) const override;
+  void getValues(std::vector<double>& values, const std::vector<index_t>& sampleIDs, size_t varID, size_t start,
+      size_t end) const override;
+  bool getIntegerValues(std::vector<int32_t>& values, const std::vector<index_t>& sampleIDs, size_t varID,
+      size_t start, size_t end) const override;
+
+  ColumnType getColumnType(size_t col) const {
+    return column_types[col];
+  }
+
+private:
+  // Narrowest type for the values of a column
+  ColumnType findColumnType(const double* values) const;
+
+  // Sorted unique values of integer columns by marking the values present
+  template<typename Read>
+  void getAllIntegerValues(std::vector<double>& all_values, size_t max_value, Read read,
+      const std::vector<index_t>& sampleIDs, size_t start, size_t end) const {
+    std::vector<bool> present(max_value + 1, false);
+    for (size_t pos = start; pos < end; ++pos) {
+      present[read(sampleIDs[pos])] = true;
+    }
+    for (size_t value = 0; value <= max_value; ++value) {
+      if (present[value]) {
+        all_values.push_back(value);
+      }
+    }
+  }
+
+  template<typename Read>
+  void getAllValuesSorted(std::vector<double>& all_values, Read read, const std::vector<index_t>& sampleIDs,
+      size_t start, size_t end) const {
+    all_values.reserve(end - start);
+    for (size_t pos = start; pos < end; ++pos) {
+      all_values.push_back(read(sampleIDs[pos]));
+    }
+    std::sort(all_values.begin(), all_values.end());
+    all_values.erase(std::unique(all_values.begin(), all_values.end()), all_values.end());
+  }
+
+  template<typename T, typename Read>
+  void gatherValues(std::vector<T>& values, Read read, const std::vector<index_t>& sampleIDs, size_t start,
+      size_t end) const {
+    values.resize(end - start);
+    for (size_t pos = start; pos < end; ++pos) {
+      values[pos - start] = read(sampleIDs[pos]);
+    }
+  }
+
+  template<typename Read>
+  void findMinMax(double& min, double& max, Read read, const std::vector<index_t>& sampleIDs, size_t start,
+      size_t end) const {
+    if (sampleIDs.size() > 0) {
+      min = read(sampleIDs[start]);
+      max = min;
+    }
+    for (size_t pos = start; pos < end; ++pos) {
+      double value = read(sampleIDs[pos]);
+      if (value < min) {
+        min = value;
+      }
+      if (value > max) {
+        max = value;
+      }
+    }
+  }
+
+  std::vector<ColumnType> column_types;
+
+  // Offset of each column in the vector of its type, in words for bits
+  std::vector<size_t> column_offsets;
+
+  std::vector<uint64_t> x_bits;
+  std::vector<uint8_t> x_uint8;
+  std::vector<uint16_t> x_uint16;
+  std::vector<uint16_t> x_half;
+  std::vector<float> x_float;
+  std::vector<double> x_double;
+  std::vector<double> y;
+};
+
+} // namespace ranger
+
+#endif /* DATAADAPTIVE_H_ */
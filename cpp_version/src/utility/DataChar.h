@@ -33,14 +33,14 @@ public:
   virtual ~DataChar() override = default;
 
   double get_x(size_t row, size_t col) const override {
-    // Use permuted data for corrected impurity importance
+    // Use permuted data for corrected impurity importance, stored after the data if materialized
     size_t col_permuted = col;
-    if (col >= num_cols) {
+    if (col >= num_cols + num_shadow_cols) {
       col = getUnpermutedVarID(col);
       row = getPermutedSampleID(row);
     }
 
-    if (col < num_cols_no_snp) {
+    if (col < num_cols_no_snp || col >= num_cols) {
       return x[col * num_rows + row];
     } else {
       return getSnp(row, col, col_permuted);
@@ -64,6 +64,11 @@ public:
     y[col * num_rows + row] = value;
   }
 
+  void materializeShadowColumns(uint num_threads) override {
+    appendPermutedColumns(x, num_threads);
+    Data::materializeShadowColumns(num_threads);
+  }
+
 private:
   std::vector<char> x;
   std::vector<char> y;
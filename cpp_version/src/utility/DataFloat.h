@@ -20,6 +20,7 @@
 #include "globals.h"
 #include "utility.h"
 #include "Data.h"
+#include "Simd.h"
 
 namespace ranger {
 
@@ -33,14 +34,14 @@ public:
   virtual ~DataFloat() override = default;
 
   double get_x(size_t row, size_t col) const override {
-    // Use permuted data for corrected impurity importance
+    // Use permuted data for corrected impurity importance, stored after the data if materialized
     size_t col_permuted = col;
-    if (col >= num_cols) {
+    if (col >= num_cols + num_shadow_cols) {
       col = getUnpermutedVarID(col);
       row = getPermutedSampleID(row);
     }
 
-    if (col < num_cols_no_snp) {
+    if (col < num_cols_no_snp || col >= num_cols) {
       return x[col * num_rows + row];
     } else {
       return getSnp(row, col, col_permuted);
@@ -60,10 +61,19 @@ public:
     x[col * num_rows + row] = value;
   }
 
+  void set_x_column(size_t col, size_t row_start, const uint8_t* values, size_t num_values, bool& error) override {
+    convertBytes(values, num_values, x.data() + col * num_rows + row_start);
+  }
+
   void set_y(size_t col, size_t row, double value, bool& error) override {
     y[col * num_rows + row] = value;
   }
 
+  void materializeShadowColumns(uint num_threads) override {
+    appendPermutedColumns(x, num_threads);
+    Data::materializeShadowColumns(num_threads);
+  }
+
 private:
   std::vector<float> x;
   std::vector<float> y;
@@ -0,0 +1,91 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef DATAHALF_H_
+#define DATAHALF_H_
+
+#include <vector>
+#include <utility>
+
+#include "globals.h"
+#include "utility.h"
+#include "Data.h"
+#include "Simd.h"
+
+namespace ranger {
+
+// Independent variables in IEEE half precision (11 significant bits, integers exact up to 2048). Values that change
+// by rounding are reported as rounding error. The dependent variables are stored as double.
+class DataHalf: public Data {
+public:
+  DataHalf() = default;
+
+  DataHalf(const DataHalf&) = delete;
+  DataHalf& operator=(const DataHalf&) = delete;
+
+  virtual ~DataHalf() override = default;
+
+  double get_x(size_t row, size_t col) const override {
+    // Use permuted data for corrected impurity importance, stored after the data if materialized
+    size_t col_permuted = col;
+    if (col >= num_cols + num_shadow_cols) {
+      col = getUnpermutedVarID(col);
+      row = getPermutedSampleID(row);
+    }
+
+    if (col < num_cols_no_snp || col >= num_cols) {
+      return halfToFloat(x[col * num_rows + row]);
+    } else {
+      return getSnp(row, col, col_permuted);
+    }
+  }
+
+  double get_y(size_t row, size_t col) const override {
+    return y[col * num_rows + row];
+  }
+
+  void reserveMemory(size_t y_cols) override {
+    x.resize(num_cols * num_rows);
+    y.resize(y_cols * num_rows);
+  }
+
+  void set_x(size_t col, size_t row, double value, bool& error) override {
+    uint16_t half = floatToHalf(value);
+    if (halfToFloat(half) != value && value == value) {
+      error = true;
+    }
+    x[col * num_rows + row] = half;
+  }
+
+  void set_x_column(size_t col, size_t row_start, const uint8_t* values, size_t num_values, bool& error) override {
+    uint16_t* column = x.data() + col * num_rows + row_start;
+    for (size_t i = 0; i < num_values; ++i) {
+      column[i] = floatToHalf(values[i]);
+    }
+  }
+
+  void set_y(size_t col, size_t row, double value, bool& error) override {
+    y[col * num_rows + row] = value;
+  }
+
+  void materializeShadowColumns(uint num_threads) override {
+    appendPermutedColumns(x, num_threads);
+    Data::materializeShadowColumns(num_threads);
+  }
+
+private:
+  std::vector<uint16_t> x;
+  std::vector<double> y;
+};
+
+} // namespace ranger
+
+#endif /* DATAHALF_H_ */
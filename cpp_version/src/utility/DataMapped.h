@@ -0,0 +1,179 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef DATAMAPPED_H_
+#define DATAMAPPED_H_
+
+#include <vector>
+#include <string>
+#include <type_traits>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#include "globals.h"
+#include "utility.h"
+#include "Data.h"
+#include "MappedFile.h"
+
+namespace ranger {
+
+// Independent variables in a memory-mapped file for out-of-core training, column-major as in the other data classes.
+// Only the pages in use are held in memory, so the data can be larger than the main memory. Rows are loaded
+// sequentially, each row only touches the current page of every column. T is the value type of the corresponding
+// memory mode. The dependent variables are kept in memory with the type of the in-memory class.
+// Files larger than max_mapping bytes (32 bit processes) are accessed through windows: each thread maps one window
+// per column, which is moved when a value outside of it is accessed. Sequential reads of a column, as in level-wise
+// growth, move it rarely.
+template<typename T>
+class DataMapped: public Data {
+public:
+  explicit DataMapped(const std::string& filename, uint64_t max_mapping = MAX_FULL_MAPPING) :
+      filename(filename), max_mapping(max_mapping), x(nullptr), window_length(0) {
+  }
+
+  DataMapped(const DataMapped&) = delete;
+  DataMapped& operator=(const DataMapped&) = delete;
+
+  // Windows of other threads are released when the threads end
+  virtual ~DataMapped() override {
+    if (window_cache.fileID == file.getFileID()) {
+      window_cache.clear();
+    }
+  }
+
+  double get_x(size_t row, size_t col) const override {
+    // Use permuted data for corrected impurity importance
+    size_t col_permuted = col;
+    if (col >= num_cols) {
+      col = getUnpermutedVarID(col);
+      row = getPermutedSampleID(row);
+    }
+
+    if (col < num_cols_no_snp) {
+      if (x) {
+        return x[col * num_rows + row];
+      }
+      return *getWindowValue(col, row);
+    } else {
+      return getSnp(row, col, col_permuted);
+    }
+  }
+
+  double get_y(size_t row, size_t col) const override {
+    return y[col * num_rows + row];
+  }
+
+  void reserveMemory(size_t y_cols) override {
+    // File size in 64 bit, also for 32 bit size_t
+    if (num_rows > 0 && num_cols > UINT64_MAX / sizeof(T) / num_rows) {
+      throw std::runtime_error("Data too large for out-of-core file " + filename + ".");
+    }
+    file.create(filename, (uint64_t) num_cols * num_rows * sizeof(T), max_mapping);
+    x = static_cast<T*>(file.getAddress());
+
+    // The windows of all columns of a thread use at most 1/16 of max_mapping
+    uint64_t page_size = MappedFile::getPageSize();
+    uint64_t length = std::min<uint64_t>(max_mapping, 1ULL << 30) / 16 / std::max<size_t>(num_cols, 1);
+    window_length = std::max(page_size, length / page_size * page_size);
+
+    y.resize(y_cols * num_rows);
+  }
+
+  void set_x(size_t col, size_t row, double value, bool& error) override {
+    T converted = convertValue<T>(value, error);
+    if (x) {
+      x[col * num_rows + row] = converted;
+    } else {
+      *getWindowValue(col, row) = converted;
+    }
+  }
+
+  void set_y(size_t col, size_t row, double value, bool& error) override {
+    y[col * num_rows + row] = value;
+  }
+
+  // Shadow variables are read through the permutation, the file is not duplicated
+  void materializeShadowColumns(uint num_threads) override {
+  }
+
+private:
+  // Mapped part of the file, values with index begin to end - 1 (col * num_rows + row)
+  struct Window {
+    uint64_t begin;
+    uint64_t end;
+    T* values;
+  };
+
+  // Windows of a thread, one for each column of the file fileID
+  struct WindowCache {
+    uint64_t fileID = 0;
+    std::vector<Window> windows;
+
+    ~WindowCache() {
+      clear();
+    }
+
+    void clear() {
+      for (auto& window : windows) {
+        if (window.values != nullptr) {
+          MappedFile::unmapWindow(window.values, (window.end - window.begin) * sizeof(T));
+        }
+      }
+      windows.clear();
+      fileID = 0;
+    }
+  };
+
+  // Value in the window of the column of this thread, the window is moved if it does not contain the value
+  T* getWindowValue(size_t col, size_t row) const {
+    WindowCache& cache = window_cache;
+    if (cache.fileID != file.getFileID()) {
+      cache.clear();
+      cache.windows.assign(num_cols, { 0, 0, nullptr });
+      cache.fileID = file.getFileID();
+    }
+
+    uint64_t index = (uint64_t) col * num_rows + row;
+    Window& window = cache.windows[col];
+    if (index < window.begin || index >= window.end) {
+      if (window.values != nullptr) {
+        MappedFile::unmapWindow(window.values, (window.end - window.begin) * sizeof(T));
+        window = { 0, 0, nullptr };
+      }
+      uint64_t offset = index * sizeof(T) / window_length * window_length;
+      size_t length = std::min(window_length, file.getSize() - offset);
+      window.values = static_cast<T*>(file.mapWindow(offset, length));
+      window.begin = offset / sizeof(T);
+      window.end = (offset + length) / sizeof(T);
+    }
+    return window.values + (index - window.begin);
+  }
+
+  std::string filename;
+  uint64_t max_mapping;
+  MappedFile file;
+
+  // Whole file, nullptr if accessed through windows of window_length bytes
+  T* x;
+  uint64_t window_length;
+  static thread_local WindowCache window_cache;
+
+  // DataUint8 keeps the dependent variables as double
+  std::vector<typename std::conditional<std::is_same<T, uint8_t>::value, double, T>::type> y;
+};
+
+template<typename T>
+thread_local typename DataMapped<T>::WindowCache DataMapped<T>::window_cache;
+
+} // namespace ranger
+
+#endif /* DATAMAPPED_H_ */
@@ -0,0 +1,90 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef DATAROWMAJOR_H_
+#define DATAROWMAJOR_H_
+
+#include <vector>
+
+#include "globals.h"
+#include "utility.h"
+#include "Data.h"
+
+namespace ranger {
+
+// Independent variables stored row-major, all values of a sample are contiguous. Used for prediction, where each
+// sample is dropped down the trees and reads a different variable at every node. Splitting reads columns and should
+// use the column-major classes. T is the value type of the corresponding memory mode, the half and adaptive modes
+// are not available row-major.
+template<typename T>
+class DataRowMajor: public Data {
+public:
+  DataRowMajor() :
+      row_length(0) {
+  }
+
+  DataRowMajor(const DataRowMajor&) = delete;
+  DataRowMajor& operator=(const DataRowMajor&) = delete;
+
+  virtual ~DataRowMajor() override = default;
+
+  double get_x(size_t row, size_t col) const override {
+    // Use permuted data for corrected impurity importance
+    size_t col_permuted = col;
+    if (col >= num_cols) {
+      col = getUnpermutedVarID(col);
+      row = getPermutedSampleID(row);
+    }
+
+    if (col < num_cols_no_snp) {
+      return x[row * row_length + col];
+    } else {
+      return getSnp(row, col, col_permuted);
+    }
+  }
+
+  double get_y(size_t row, size_t col) const override {
+    return y[col * num_rows + row];
+  }
+
+  void reserveMemory(size_t y_cols) override {
+    row_length = num_cols;
+    x.resize(row_length * num_rows);
+    y.resize(y_cols * num_rows);
+  }
+
+  void set_x(size_t col, size_t row, double value, bool& error) override {
+    x[row * row_length + col] = convertValue<T>(value, error);
+  }
+
+  void set_x_column(size_t col, size_t row_start, const uint8_t* values, size_t num_values, bool& error) override {
+    T* value = x.data() + row_start * row_length + col;
+    for (size_t i = 0; i < num_values; ++i) {
+      *value = values[i];
+      value += row_length;
+    }
+  }
+
+  void set_y(size_t col, size_t row, double value, bool& error) override {
+    y[col * num_rows + row] = value;
+  }
+
+private:
+  // Number of values per row, fixed when memory is reserved
+  size_t row_length;
+
+  std::vector<T> x;
+  std::vector<T> y;
+};
+
+} // namespace ranger
+
+#endif /* DATAROWMAJOR_H_ */
@@ -0,0 +1,97 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef DATAUINT8_H_
+#define DATAUINT8_H_
+
+#include <cstring>
+#include <vector>
+#include <utility>
+
+#include "globals.h"
+#include "utility.h"
+#include "Data.h"
+
+namespace ranger {
+
+// Independent variables as unsigned 8 bit integers, e.g. pixel values. Other values are rounded to 0..255 and reported
+// as rounding error. The dependent variables are stored as double.
+class DataUint8: public Data {
+public:
+  DataUint8() = default;
+
+  DataUint8(const DataUint8&) = delete;
+  DataUint8& operator=(const DataUint8&) = delete;
+
+  virtual ~DataUint8() override = default;
+
+  double get_x(size_t row, size_t col) const override {
+    // Use permuted data for corrected impurity importance, stored after the data if materialized
+    size_t col_permuted = col;
+    if (col >= num_cols + num_shadow_cols) {
+      col = getUnpermutedVarID(col);
+      row = getPermutedSampleID(row);
+    }
+
+    if (col < num_cols_no_snp || col >= num_cols) {
+      return x[col * num_rows + row];
+    } else {
+      return getSnp(row, col, col_permuted);
+    }
+  }
+
+  bool getIntegerValues(std::vector<int32_t>& values, const std::vector<index_t>& sampleIDs, size_t varID,
+      size_t start, size_t end) const override {
+    if (varID >= num_cols_no_snp) {
+      return false;
+    }
+    values.resize(end - start);
+    const uint8_t* column = x.data() + varID * num_rows;
+    for (size_t pos = start; pos < end; ++pos) {
+      values[pos - start] = column[sampleIDs[pos]];
+    }
+    return true;
+  }
+
+  double get_y(size_t row, size_t col) const override {
+    return y[col * num_rows + row];
+  }
+
+  void reserveMemory(size_t y_cols) override {
+    x.resize(num_cols * num_rows);
+    y.resize(y_cols * num_rows);
+  }
+
+  void set_x(size_t col, size_t row, double value, bool& error) override {
+    x[col * num_rows + row] = toUint8(value, error);
+  }
+
+  void set_x_column(size_t col, size_t row_start, const uint8_t* values, size_t num_values, bool& error) override {
+    std::memcpy(x.data() + col * num_rows + row_start, values, num_values);
+  }
+
+  void set_y(size_t col, size_t row, double value, bool& error) override {
+    y[col * num_rows + row] = value;
+  }
+
+  void materializeShadowColumns(uint num_threads) override {
+    appendPermutedColumns(x, num_threads);
+    Data::materializeShadowColumns(num_threads);
+  }
+
+private:
+  std::vector<uint8_t> x;
+  std::vector<double> y;
+};
+
+} // namespace ranger
+
+#endif /* DATAUINT8_H_ */
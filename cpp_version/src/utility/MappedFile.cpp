@@ -0,0 +1,115 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+// 64 bit file offsets on 32 bit systems, before any system header
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <limits>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+namespace ranger {
+
+// Identifies files in window caches, also after the address of a MappedFile is reused
+static std::atomic<uint64_t> next_fileID(1);
+
+void MappedFile::create(const std::string& filename, uint64_t size, uint64_t max_mapping) {
+  close();
+#ifdef _WIN32
+  throw std::runtime_error("Memory-mapped files are not supported on this platform.");
+#else
+  if (size > (uint64_t) std::numeric_limits<off_t>::max()) {
+    throw std::runtime_error("File " + filename + " is too large for this platform.");
+  }
+  int file = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (file < 0) {
+    throw std::runtime_error("Could not create file " + filename + ": " + std::strerror(errno) + ".");
+  }
+
+  // Reserve the size without writing, the file stays usable after removing it
+  if (size > 0 && ftruncate(file, (off_t) size) != 0) {
+    int error = errno;
+    ::close(file);
+    unlink(filename.c_str());
+    throw std::runtime_error("Could not resize file " + filename + ": " + std::strerror(error) + ".");
+  }
+  unlink(filename.c_str());
+  this->file = file;
+  this->size = size;
+  fileID = next_fileID++;
+
+  // The mapping of the whole file stays valid after closing it
+  if (size > 0 && size <= max_mapping) {
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    int error = errno;
+    ::close(file);
+    this->file = -1;
+    if (mapped == MAP_FAILED) {
+      this->size = 0;
+      throw std::runtime_error("Could not map file " + filename + ": " + std::strerror(error) + ".");
+    }
+    address = mapped;
+  }
+#endif
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+  if (address != nullptr) {
+    munmap(address, size);
+  }
+  if (file >= 0) {
+    ::close(file);
+  }
+#endif
+  address = nullptr;
+  size = 0;
+  file = -1;
+}
+
+void* MappedFile::mapWindow(uint64_t offset, size_t length) const {
+#ifdef _WIN32
+  throw std::runtime_error("Memory-mapped files are not supported on this platform.");
+#else
+  void* window = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, file, (off_t) offset);
+  if (window == MAP_FAILED) {
+    throw std::runtime_error(std::string("Could not map window of data file: ") + std::strerror(errno) + ".");
+  }
+  return window;
+#endif
+}
+
+void MappedFile::unmapWindow(void* window, size_t length) {
+#ifndef _WIN32
+  munmap(window, length);
+#endif
+}
+
+size_t MappedFile::getPageSize() {
+#ifdef _WIN32
+  return 4096;
+#else
+  return sysconf(_SC_PAGESIZE);
+#endif
+}
+
+} // namespace ranger
@@ -0,0 +1,73 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace ranger {
+
+// Largest file mapped as a whole. 32 bit processes have about 3 GB of address space, larger files are mapped in
+// windows.
+const uint64_t MAX_FULL_MAPPING = sizeof(void*) > 4 ? UINT64_MAX : (1ULL << 30);
+
+// Scratch file mapped into memory, pages are read from and written back to disk by the operating system. The file
+// is removed directly after creation, its disk space is released when it is closed or the process ends. Files up to
+// max_mapping bytes are mapped as a whole, otherwise the file stays open and windows of it are mapped on demand.
+class MappedFile {
+public:
+  MappedFile() :
+      address(nullptr), size(0), file(-1), fileID(0) {
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    close();
+  }
+
+  // Create the file with the given size in bytes, an existing file is overwritten
+  void create(const std::string& filename, uint64_t size, uint64_t max_mapping = MAX_FULL_MAPPING);
+  void close();
+
+  // Address of the whole file, nullptr if mapped in windows
+  void* getAddress() const {
+    return address;
+  }
+  uint64_t getSize() const {
+    return size;
+  }
+
+  // Different for every created file, also after closing
+  uint64_t getFileID() const {
+    return fileID;
+  }
+
+  // Map length bytes at offset, a multiple of getPageSize(). Windows stay valid after closing the file and are
+  // released with unmapWindow().
+  void* mapWindow(uint64_t offset, size_t length) const;
+  static void unmapWindow(void* window, size_t length);
+  static size_t getPageSize();
+
+private:
+  void* address;
+  uint64_t size;
+  int file;
+  uint64_t fileID;
+};
+
+} // namespace ranger
+
+#endif /* MAPPEDFILE_H_ */
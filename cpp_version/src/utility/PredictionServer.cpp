@@ -0,0 +1,226 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "PredictionServer.h"
+#include "utility.h"
+
+namespace ranger {
+
+#ifndef _WIN32
+// Buffered stream on a connected socket
+class SocketStreamBuffer: public std::streambuf {
+public:
+  explicit SocketStreamBuffer(int fd) :
+      fd(fd) {
+    setg(input_buffer, input_buffer, input_buffer);
+    setp(output_buffer, output_buffer + sizeof(output_buffer));
+  }
+
+  ~SocketStreamBuffer() override {
+    sync();
+  }
+
+protected:
+  int_type underflow() override {
+    ssize_t num_bytes;
+    do {
+      num_bytes = read(fd, input_buffer, sizeof(input_buffer));
+    } while (num_bytes < 0 && errno == EINTR);
+    if (num_bytes <= 0) {
+      return traits_type::eof();
+    }
+    setg(input_buffer, input_buffer, input_buffer + num_bytes);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  int_type overflow(int_type c) override {
+    if (sync() != 0) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override {
+    char* start = pbase();
+    while (start < pptr()) {
+      ssize_t num_bytes = write(fd, start, pptr() - start);
+      if (num_bytes < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -1;
+      }
+      start += num_bytes;
+    }
+    setp(output_buffer, output_buffer + sizeof(output_buffer));
+    return 0;
+  }
+
+private:
+  int fd;
+  char input_buffer[4096];
+  char output_buffer[4096];
+};
+#endif
+
+PredictionServer::PredictionServer(Forest& forest, bool write_to_img, std::ostream* verbose_out) :
+    forest(forest), write_to_img(write_to_img), verbose_out(verbose_out) {
+}
+
+bool PredictionServer::serveStream(std::istream& requests, std::ostream& replies) {
+  std::string request_line;
+  while (getline(requests, request_line)) {
+    if (request_line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    bool quit = false;
+    try {
+      quit = handleRequest(request_line, requests, replies);
+    } catch (std::exception& e) {
+      replies << "error " << e.what() << std::endl;
+    }
+    replies.flush();
+    if (quit) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// #nocov start
+void PredictionServer::serveSocket(const std::string& socket_path) {
+#ifdef _WIN32
+  throw std::runtime_error("Unix domain sockets are not supported on this platform.");
+#else
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + socket_path + ".");
+  }
+  std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+  // Remove socket of a previous server, but no other files
+  struct stat file_status;
+  if (stat(socket_path.c_str(), &file_status) == 0) {
+    if (!S_ISSOCK(file_status.st_mode)) {
+      throw std::runtime_error("Could not create socket, file exists: " + socket_path + ".");
+    }
+    unlink(socket_path.c_str());
+  }
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    throw std::runtime_error("Could not create socket: " + socket_path + ".");
+  }
+  if (bind(listen_fd, (sockaddr*) &address, sizeof(address)) != 0 || listen(listen_fd, 8) != 0) {
+    close(listen_fd);
+    throw std::runtime_error("Could not listen on socket: " + socket_path + ".");
+  }
+
+  // Clients closing the connection early should not stop the server
+  signal(SIGPIPE, SIG_IGN);
+  if (verbose_out)
+    *verbose_out << "Listening on socket " << socket_path << "." << std::endl;
+
+  bool quit = false;
+  while (!quit) {
+    int connection_fd = accept(listen_fd, 0, 0);
+    if (connection_fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      close(listen_fd);
+      unlink(socket_path.c_str());
+      throw std::runtime_error("Could not accept connection on socket: " + socket_path + ".");
+    }
+    {
+      SocketStreamBuffer buffer(connection_fd);
+      std::iostream connection(&buffer);
+      quit = serveStream(connection, connection);
+    }
+    close(connection_fd);
+  }
+
+  close(listen_fd);
+  unlink(socket_path.c_str());
+#endif
+}
+// #nocov end
+
+bool PredictionServer::handleRequest(const std::string& request_line, std::istream& requests,
+    std::ostream& replies) {
+  std::stringstream request_stream(request_line);
+  std::string command;
+  request_stream >> command;
+
+  if (command == "predict") {
+    std::string input_file;
+    std::string output_prefix;
+    if (!(request_stream >> input_file >> output_prefix)) {
+      throw std::runtime_error("Usage: predict <input file> <output prefix>");
+    }
+    forest.predictFile(input_file, output_prefix);
+    forest.writeOutput();
+    replies << "ok " << output_prefix << (write_to_img ? ".png" : ".prediction") << std::endl;
+  } else if (command == "values") {
+    size_t num_rows = 0;
+    if (!(request_stream >> num_rows) || num_rows == 0) {
+      throw std::runtime_error("Usage: values <number of rows>, followed by the rows");
+    }
+
+    // Read all rows before checking them to stay in sync with the next request
+    std::vector<double> values;
+    for (size_t row = 0; row < num_rows; ++row) {
+      std::string line;
+      if (!getline(requests, line)) {
+        throw std::runtime_error("Expected " + std::to_string(num_rows) + " rows of values.");
+      }
+      std::stringstream line_stream(line);
+      double value;
+      while (readFromStream(line_stream, value)) {
+        values.push_back(value);
+      }
+    }
+    forest.predictValues(values, num_rows);
+
+    std::stringstream prediction_stream;
+    forest.writePredictions(prediction_stream);
+    std::string predictions = prediction_stream.str();
+    replies << "ok " << std::count(predictions.begin(), predictions.end(), '\n') << std::endl << predictions;
+  } else if (command == "quit") {
+    replies << "ok" << std::endl;
+    return true;
+  } else {
+    throw std::runtime_error("Unknown request: " + command + ".");
+  }
+  return false;
+}
+
+} // namespace ranger
@@ -0,0 +1,53 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef PREDICTIONSERVER_H_
+#define PREDICTIONSERVER_H_
+
+#include <iostream>
+#include <string>
+
+#include "globals.h"
+#include "Forest.h"
+
+namespace ranger {
+
+// Answers prediction requests with a forest loaded once. Requests are text lines:
+//   predict <input file> <output prefix>  Predict a CSV file or image, write <output prefix>.prediction or .png
+//   values <n>                            Followed by n lines with the values of the independent variables
+//   quit                                  Stop the server
+// Replies are "ok <output file>" for predict, "ok <m>" and m lines in prediction file format for values, "ok" for
+// quit and "error <message>" if a request failed. The forest stays loaded after errors.
+class PredictionServer {
+public:
+  PredictionServer(Forest& forest, bool write_to_img, std::ostream* verbose_out);
+
+  PredictionServer(const PredictionServer&) = delete;
+  PredictionServer& operator=(const PredictionServer&) = delete;
+
+  // Answer requests until end of input or quit, returns true after quit
+  bool serveStream(std::istream& requests, std::ostream& replies);
+
+  // Answer requests on a Unix domain socket, one connection at a time, until quit
+  void serveSocket(const std::string& socket_path);
+
+private:
+  // Returns true for quit
+  bool handleRequest(const std::string& request_line, std::istream& requests, std::ostream& replies);
+
+  Forest& forest;
+  bool write_to_img;
+  std::ostream* verbose_out;
+};
+
+} // namespace ranger
+
+#endif /* PREDICTIONSERVER_H_ */
@@ -0,0 +1,89 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef RANDOMGENERATOR_H_
+#define RANDOMGENERATOR_H_
+
+#include <cstdint>
+#include <limits>
+
+namespace ranger {
+
+// Counter-based random number generator (SplitMix64 output function applied to key + counter * gamma). The state is
+// 16 bytes, seeding is two mix operations, so an independent generator can be created for each tree, node or
+// variable. Each (seed, stream) pair gives its own sequence, results do not depend on the order in which streams are
+// used or on the number of threads. Satisfies UniformRandomBitGenerator, so it works with the std distributions.
+class RandomGenerator {
+public:
+  typedef uint64_t result_type;
+
+  RandomGenerator() {
+    seed(0);
+  }
+  explicit RandomGenerator(uint64_t seed, uint64_t stream = 0) {
+    this->seed(seed, stream);
+  }
+
+  void seed(uint64_t seed, uint64_t stream = 0) {
+    key = mix(mix(seed) ^ (stream * GAMMA + GAMMA));
+    counter = 0;
+  }
+
+  // Seed for an independent generator, only depends on the seed of this generator and the stream
+  uint64_t streamSeed(uint64_t stream) const {
+    return mix(key ^ mix(stream + GAMMA));
+  }
+
+  static constexpr result_type min() {
+    return 0;
+  }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() {
+    return mix(key + (++counter) * GAMMA);
+  }
+
+  void discard(uint64_t num_draws) {
+    counter += num_draws;
+  }
+
+  // Uniform double in [0, 1) from the upper 53 bits
+  double uniform() {
+    return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  // Uniform integer in [0, range) by multiply and shift (Lemire), the bias for ranges far below 2^64 is negligible
+  uint64_t bounded(uint64_t range) {
+#ifdef __SIZEOF_INT128__
+    return (uint64_t) (((unsigned __int128) (*this)() * range) >> 64);
+#else
+    return (uint64_t) (uniform() * range);
+#endif
+  }
+
+private:
+  static constexpr uint64_t GAMMA = 0x9E3779B97F4A7C15ULL;
+
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t key;
+  uint64_t counter;
+};
+
+} // namespace ranger
+
+#endif /* RANDOMGENERATOR_H_ */
@@ -0,0 +1,68 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include "RegularizationState.h"
+
+namespace ranger {
+
+constexpr size_t RegularizationState::NOT_USED;
+
+void RegularizationState::init(size_t num_variables, size_t num_trees, size_t lag) {
+  this->num_variables = num_variables;
+  this->num_trees = num_trees;
+  this->lag = lag;
+
+  first_visible.reset(new std::atomic<size_t>[num_variables]);
+  for (size_t i = 0; i < num_variables; ++i) {
+    first_visible[i].store(NOT_USED, std::memory_order_relaxed);
+  }
+  grown.assign(num_trees, false);
+  num_grown = 0;
+}
+
+void RegularizationState::waitForTree(size_t tree_idx) {
+  if (tree_idx < lag) {
+    return;
+  }
+#ifndef OLD_WIN_R_BUILD
+  std::unique_lock<std::mutex> lock(mutex);
+  while (num_grown + lag <= tree_idx) {
+    condition_variable.wait(lock);
+  }
+#endif
+}
+
+void RegularizationState::setGrown(size_t tree_idx) {
+#ifndef OLD_WIN_R_BUILD
+  std::unique_lock<std::mutex> lock(mutex);
+#endif
+  grown[tree_idx] = true;
+  if (tree_idx == num_grown) {
+    while (num_grown < num_trees && grown[num_grown]) {
+      ++num_grown;
+    }
+#ifndef OLD_WIN_R_BUILD
+    condition_variable.notify_all();
+#endif
+  }
+}
+
+// #nocov start
+void RegularizationState::release() {
+#ifndef OLD_WIN_R_BUILD
+  std::unique_lock<std::mutex> lock(mutex);
+  num_grown = num_trees;
+  condition_variable.notify_all();
+#endif
+}
+// #nocov end
+
+} // namespace ranger
@@ -0,0 +1,88 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef REGULARIZATIONSTATE_H_
+#define REGULARIZATIONSTATE_H_
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+#ifndef OLD_WIN_R_BUILD
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#include "globals.h"
+
+namespace ranger {
+
+// Variables used for splitting by the trees of a forest, shared by all growing threads. A split of tree j on a
+// variable becomes visible to trees j + lag and later, independent of which thread grows which tree and when. Tree i
+// waits until trees 0..i-lag are grown, so the result only depends on the lag, not on the number of threads.
+// Variables used in the tree itself are tracked by the tree.
+class RegularizationState {
+public:
+  RegularizationState() :
+      num_variables(0), num_trees(0), lag(1), num_grown(0) {
+  }
+
+  RegularizationState(const RegularizationState&) = delete;
+  RegularizationState& operator=(const RegularizationState&) = delete;
+
+  void init(size_t num_variables, size_t num_trees, size_t lag);
+
+  // Block until all trees the given tree depends on are grown
+  void waitForTree(size_t tree_idx);
+  void setGrown(size_t tree_idx);
+
+  // Stop waiting for trees, used if growing is interrupted
+  void release();
+
+  // Used by one of the trees 0..tree_idx-lag
+  bool isUsed(size_t varID, size_t tree_idx) const {
+    return first_visible[varID].load(std::memory_order_relaxed) <= tree_idx;
+  }
+
+  // Lock-free minimum, the flag only changes the first time a variable is used by an earlier tree
+  void setUsed(size_t varID, size_t tree_idx) {
+    size_t visible = tree_idx + lag;
+    size_t current = first_visible[varID].load(std::memory_order_relaxed);
+    while (visible < current && !first_visible[varID].compare_exchange_weak(current, visible,
+        std::memory_order_relaxed)) {
+    }
+  }
+
+  size_t getLag() const {
+    return lag;
+  }
+
+private:
+  size_t num_variables;
+  size_t num_trees;
+  size_t lag;
+
+  // First tree that sees each variable as used, NOT_USED for unused variables
+  static constexpr size_t NOT_USED = std::numeric_limits<size_t>::max();
+  std::unique_ptr<std::atomic<size_t>[]> first_visible;
+
+  // Trees 0..num_grown-1 are grown
+  std::vector<bool> grown;
+  size_t num_grown;
+#ifndef OLD_WIN_R_BUILD
+  std::mutex mutex;
+  std::condition_variable condition_variable;
+#endif
+};
+
+} // namespace ranger
+
+#endif /* REGULARIZATIONSTATE_H_ */
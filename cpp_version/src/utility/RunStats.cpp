@@ -0,0 +1,138 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+#include "RunStats.h"
+#include "version.h"
+
+namespace ranger {
+
+std::atomic<bool> RunStats::allocation_counting(false);
+std::atomic<size_t> RunStats::allocated_bytes(0);
+
+// Quote and escape string for JSON output
+std::string jsonString(const std::string& value) {
+  std::string result = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if ((unsigned char) c < 0x20) {
+      result += ' ';
+    } else {
+      result += c;
+    }
+  }
+  return result + "\"";
+}
+
+RunStats::RunStats() :
+    phase_stats(NUM_RUN_PHASES, { 0, 0, 0 }), start_allocated_bytes(getAllocatedBytes()) {
+  allocation_counting.store(true, std::memory_order_relaxed);
+}
+
+RunStats::~RunStats() {
+  allocation_counting.store(false, std::memory_order_relaxed);
+}
+
+void RunStats::addPhase(RunPhase phase, double wall_seconds, double cpu_seconds, size_t bytes_allocated) {
+  phase_stats[phase].wall_seconds += wall_seconds;
+  phase_stats[phase].cpu_seconds += cpu_seconds;
+  phase_stats[phase].bytes_allocated += bytes_allocated;
+}
+
+void RunStats::initTreeStats(size_t num_trees, size_t num_independent_variables) {
+  tree_stats.assign(num_trees, { 0, 0, 0, 0, std::vector<size_t>(num_independent_variables, 0) });
+}
+
+// #nocov start
+void RunStats::writeToFile(const std::string& filename, const std::vector<std::string>& variable_names) const {
+  std::ofstream outfile;
+  outfile.open(filename);
+  if (!outfile.good()) {
+    throw std::runtime_error("Could not write to output file: " + filename + ".");
+  }
+
+  // Bootstrap is measured in the worker threads, wall time summed over trees
+  std::vector<PhaseStats> phases(phase_stats);
+  for (auto& tree : tree_stats) {
+    phases[PHASE_BOOTSTRAP].wall_seconds += tree.bootstrap_seconds;
+  }
+
+  outfile << "{" << std::endl;
+  outfile << "  \"ranger_version\": " << jsonString(RANGER_VERSION) << "," << std::endl;
+  outfile << "  \"phases\": {" << std::endl;
+  for (size_t i = 0; i < NUM_RUN_PHASES; ++i) {
+    outfile << "    " << jsonString(RUN_PHASE_NAMES[i]) << ": { \"wall_seconds\": " << phases[i].wall_seconds;
+    if (i != PHASE_BOOTSTRAP) {
+      outfile << ", \"cpu_seconds\": " << phases[i].cpu_seconds << ", \"bytes_allocated\": "
+          << phases[i].bytes_allocated;
+    }
+    outfile << " }" << (i + 1 < NUM_RUN_PHASES ? "," : "") << std::endl;
+  }
+  outfile << "  }," << std::endl;
+  outfile << "  \"bytes_allocated\": " << getAllocatedBytes() - start_allocated_bytes << "," << std::endl;
+
+  // Per tree, split evaluations summed over variables
+  outfile << "  \"trees\": [";
+  std::vector<size_t> split_evaluations(variable_names.size(), 0);
+  for (size_t tree_idx = 0; tree_idx < tree_stats.size(); ++tree_idx) {
+    const TreeStats& tree = tree_stats[tree_idx];
+    size_t tree_split_evaluations = 0;
+    for (size_t varID = 0; varID < tree.split_evaluations.size() && varID < split_evaluations.size(); ++varID) {
+      split_evaluations[varID] += tree.split_evaluations[varID];
+      tree_split_evaluations += tree.split_evaluations[varID];
+    }
+    outfile << (tree_idx > 0 ? "," : "") << std::endl << "    { \"grow_seconds\": " << tree.grow_seconds
+        << ", \"bootstrap_seconds\": " << tree.bootstrap_seconds << ", \"num_nodes\": " << tree.num_nodes
+        << ", \"depth\": " << tree.depth << ", \"split_evaluations\": " << tree_split_evaluations << " }";
+  }
+  outfile << std::endl << "  ]," << std::endl;
+
+  // Per variable, summed over trees
+  outfile << "  \"split_evaluations\": {";
+  for (size_t varID = 0; varID < variable_names.size(); ++varID) {
+    outfile << (varID > 0 ? "," : "") << std::endl << "    " << jsonString(variable_names[varID]) << ": "
+        << split_evaluations[varID];
+  }
+  outfile << std::endl << "  }" << std::endl;
+  outfile << "}" << std::endl;
+
+  outfile.close();
+}
+// #nocov end
+
+double RunStats::wallTime() {
+  using std::chrono::steady_clock;
+  using std::chrono::duration;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+PhaseTimer::PhaseTimer(RunStats* stats, RunPhase phase) :
+    stats(stats), phase(phase), start_wall(0), start_cpu(0), start_bytes(0) {
+  if (stats) {
+    start_wall = RunStats::wallTime();
+    start_cpu = std::clock();
+    start_bytes = RunStats::getAllocatedBytes();
+  }
+}
+
+PhaseTimer::~PhaseTimer() {
+  if (stats) {
+    stats->addPhase(phase, RunStats::wallTime() - start_wall, (double) (std::clock() - start_cpu) / CLOCKS_PER_SEC,
+        RunStats::getAllocatedBytes() - start_bytes);
+  }
+}
+
+} // namespace ranger
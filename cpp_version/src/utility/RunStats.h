@@ -0,0 +1,115 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef RUNSTATS_H_
+#define RUNSTATS_H_
+
+#include <atomic>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "globals.h"
+
+namespace ranger {
+
+enum RunPhase {
+  PHASE_LOAD = 0,
+  PHASE_SORT = 1,
+  PHASE_BOOTSTRAP = 2,
+  PHASE_GROW = 3,
+  PHASE_OOB = 4,
+  PHASE_IMPORTANCE = 5,
+  PHASE_PREDICT = 6,
+  PHASE_WRITE = 7
+};
+const size_t NUM_RUN_PHASES = 8;
+const std::vector<std::string> RUN_PHASE_NAMES = { "load", "sort", "bootstrap", "grow", "oob", "importance", "predict",
+    "write" };
+
+// Statistics of one tree, only written by the thread growing the tree
+struct TreeStats {
+  double bootstrap_seconds;
+  double grow_seconds;
+  size_t num_nodes;
+  size_t depth;
+
+  // Number of nodes each variable was evaluated for splitting
+  std::vector<size_t> split_evaluations;
+};
+
+// Timings and counters of a run, written to <outprefix>.stats.json. Without a RunStats object (nullptr) nothing is
+// measured. Bytes allocated are counted by the global operator new in AllocationCounting.cpp.
+class RunStats {
+public:
+  RunStats();
+  ~RunStats();
+
+  RunStats(const RunStats&) = delete;
+  RunStats& operator=(const RunStats&) = delete;
+
+  void addPhase(RunPhase phase, double wall_seconds, double cpu_seconds, size_t bytes_allocated);
+
+  // Allocate statistics for all trees before growing
+  void initTreeStats(size_t num_trees, size_t num_independent_variables);
+  TreeStats& getTreeStats(size_t tree_idx) {
+    return tree_stats[tree_idx];
+  }
+
+  void writeToFile(const std::string& filename, const std::vector<std::string>& variable_names) const;
+
+  // Seconds since an arbitrary start point
+  static double wallTime();
+
+  static void countAllocation(size_t size) {
+    if (allocation_counting.load(std::memory_order_relaxed)) {
+      allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+  }
+  static size_t getAllocatedBytes() {
+    return allocated_bytes.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct PhaseStats {
+    double wall_seconds;
+    double cpu_seconds;
+    size_t bytes_allocated;
+  };
+
+  std::vector<PhaseStats> phase_stats;
+  std::vector<TreeStats> tree_stats;
+  size_t start_allocated_bytes;
+
+  static std::atomic<bool> allocation_counting;
+  static std::atomic<size_t> allocated_bytes;
+};
+
+// Adds wall time, CPU time of all threads and allocated bytes from construction to destruction to a phase
+class PhaseTimer {
+public:
+  PhaseTimer(RunStats* stats, RunPhase phase);
+  ~PhaseTimer();
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+  RunStats* stats;
+  RunPhase phase;
+  double start_wall;
+  std::clock_t start_cpu;
+  size_t start_bytes;
+};
+
+} // namespace ranger
+
+#endif /* RUNSTATS_H_ */
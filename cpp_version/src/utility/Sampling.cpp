@@ -0,0 +1,60 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#include <numeric>
+#include <stdexcept>
+
+#include "Sampling.h"
+
+namespace ranger {
+
+AliasTable::AliasTable(const std::vector<double>& weights) :
+    probabilities(weights.size(), 1), aliases(weights.size()) {
+  size_t n = weights.size();
+  double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+  if (n == 0 || !(sum > 0)) {
+    throw std::runtime_error("At least one case weight has to be positive.");
+  }
+
+  // Scale to mean 1 and split in columns below and above the mean
+  std::vector<double> scaled(n);
+  std::vector<index_t> small;
+  std::vector<index_t> large;
+  for (size_t i = 0; i < n; ++i) {
+    if (weights[i] < 0) {
+      throw std::runtime_error("Case weights have to be non-negative.");
+    }
+    scaled[i] = weights[i] * n / sum;
+    aliases[i] = i;
+    if (scaled[i] < 1) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  // Fill each small column with a large one (Vose), remaining columns keep probability 1
+  while (!small.empty() && !large.empty()) {
+    index_t small_column = small.back();
+    small.pop_back();
+    index_t large_column = large.back();
+
+    probabilities[small_column] = scaled[small_column];
+    aliases[small_column] = large_column;
+    scaled[large_column] = (scaled[large_column] + scaled[small_column]) - 1;
+    if (scaled[large_column] < 1) {
+      large.pop_back();
+      small.push_back(large_column);
+    }
+  }
+}
+
+} // namespace ranger
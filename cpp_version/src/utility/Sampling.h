@@ -0,0 +1,78 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef SAMPLING_H_
+#define SAMPLING_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "globals.h"
+#include "RandomGenerator.h"
+
+namespace ranger {
+
+// Draws from a discrete distribution in constant time (Walker's alias method). Built once for all trees, the
+// weights are not copied or normalized per tree.
+class AliasTable {
+public:
+  AliasTable() = default;
+  explicit AliasTable(const std::vector<double>& weights);
+
+  bool empty() const {
+    return probabilities.empty();
+  }
+
+  size_t draw(RandomGenerator& random_number_generator) const {
+    // One uniform number selects the column and decides between the column and its alias
+    double u = random_number_generator.uniform() * probabilities.size();
+    size_t column = std::min((size_t) u, probabilities.size() - 1);
+    if (u - column < probabilities[column]) {
+      return column;
+    } else {
+      return aliases[column];
+    }
+  }
+
+private:
+  std::vector<double> probabilities;
+  std::vector<index_t> aliases;
+};
+
+/**
+ * Draw num_samples of 0..max-1 (or of mapping[0..max-1]) without replacement in random order and append them to
+ * result. Uses selection sampling, only the drawn samples are stored.
+ * @param result Vector to add results to
+ * @param max Number of elements to draw from
+ * @param num_samples Number of samples to draw
+ * @param mapping Values to use instead of 0..max-1, nullptr for none
+ * @param random_number_generator Random number generator
+ */
+template<typename T>
+void drawWithoutReplacementSelection(std::vector<T>& result, size_t max, size_t num_samples,
+    const std::vector<size_t>* mapping, RandomGenerator& random_number_generator) {
+  size_t start = result.size();
+  size_t remaining = std::min(num_samples, max);
+  result.reserve(start + remaining);
+
+  // Select each element with probability (number still to draw) / (number of elements left)
+  for (size_t i = 0; i < max && remaining > 0; ++i) {
+    if (random_number_generator.uniform() * (max - i) < remaining) {
+      result.push_back(mapping ? (*mapping)[i] : i);
+      --remaining;
+    }
+  }
+  std::shuffle(result.begin() + start, result.end(), random_number_generator);
+}
+
+} // namespace ranger
+
+#endif /* SAMPLING_H_ */
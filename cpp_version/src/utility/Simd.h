@@ -0,0 +1,353 @@
+/*-------------------------------------------------------------------------------
+ This file is part of ranger.
+
+ Copyright (c) [2014-2018] [Marvin N. Wright]
+
+ This software may be modified and distributed under the terms of the MIT license.
+
+ Please note that the C++ core of ranger is distributed under MIT license and the
+ R package "ranger" under GPL3 license.
+ #-------------------------------------------------------------------------------*/
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// NEON kernels are selected at compile time (-mfpu=neon on ARMv7, always on AArch64), define RANGER_NO_SIMD to
+// build the scalar versions. Both versions give identical results. ARMv7 NEON flushes subnormal floats to zero and
+// has no double lanes, so kernels comparing or adding floating point values use NEON only on AArch64
+// (RANGER_NEON_FLOAT). ARMv7 gets the integer kernels and the conversion of bytes to float.
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(RANGER_NO_SIMD)
+#include <arm_neon.h>
+#define RANGER_NEON 1
+#if defined(__aarch64__)
+#define RANGER_NEON_FLOAT 1
+#endif
+#endif
+
+namespace ranger {
+
+// Number of leading values less than threshold, values sorted ascending
+inline size_t countSortedBelow(const float* values, size_t num_values, float threshold) {
+  size_t i = 0;
+#ifdef RANGER_NEON_FLOAT
+  // Compare 4 values at once until one is not below
+  float32x4_t thresholds = vdupq_n_f32(threshold);
+  for (; i + 4 <= num_values; i += 4) {
+    uint32x4_t below = vcltq_f32(vld1q_f32(values + i), thresholds);
+    uint32x2_t both = vand_u32(vget_low_u32(below), vget_high_u32(below));
+    if ((vget_lane_u32(both, 0) & vget_lane_u32(both, 1)) != 0xFFFFFFFF) {
+      break;
+    }
+  }
+#endif
+  while (i < num_values && values[i] < threshold) {
+    ++i;
+  }
+  return i;
+}
+
+// Number of values less than threshold, all values are compared without branches. NaN thresholds are never counted.
+inline size_t countBelow(const double* values, size_t num_values, double threshold) {
+  size_t i = 0;
+  size_t count = 0;
+#ifdef RANGER_NEON_FLOAT
+  // True lanes are all ones, subtracting adds 1
+  float64x2_t thresholds = vdupq_n_f64(threshold);
+  uint64x2_t counts = vdupq_n_u64(0);
+  for (; i + 2 <= num_values; i += 2) {
+    counts = vsubq_u64(counts, vcltq_f64(vld1q_f64(values + i), thresholds));
+  }
+  count = vgetq_lane_u64(counts, 0) + vgetq_lane_u64(counts, 1);
+#endif
+  for (; i < num_values; ++i) {
+    count += values[i] < threshold;
+  }
+  return count;
+}
+
+// Bin of each value, the number of split values below it. NaN values are in bin 0.
+inline void computeBins(const double* values, size_t num_values, const double* split_values, size_t num_splits,
+    uint32_t* bins) {
+  size_t i = 0;
+#ifdef RANGER_NEON_FLOAT
+  for (; i + 2 <= num_values; i += 2) {
+    float64x2_t value = vld1q_f64(values + i);
+    uint64x2_t counts = vdupq_n_u64(0);
+    for (size_t j = 0; j < num_splits; ++j) {
+      counts = vsubq_u64(counts, vcltq_f64(vdupq_n_f64(split_values[j]), value));
+    }
+    bins[i] = vgetq_lane_u64(counts, 0);
+    bins[i + 1] = vgetq_lane_u64(counts, 1);
+  }
+#endif
+  for (; i < num_values; ++i) {
+    bins[i] = countBelow(split_values, num_splits, values[i]);
+  }
+}
+
+// Bins of integer values with the split values rounded down, which gives the same bins. Compared in 32 bit integer
+// lanes, exact on ARMv7 as well.
+inline void computeBins(const int32_t* values, size_t num_values, const int32_t* split_floors, size_t num_splits,
+    uint32_t* bins) {
+  size_t i = 0;
+#ifdef RANGER_NEON
+  for (; i + 4 <= num_values; i += 4) {
+    int32x4_t value = vld1q_s32(values + i);
+    uint32x4_t counts = vdupq_n_u32(0);
+    for (size_t j = 0; j < num_splits; ++j) {
+      counts = vsubq_u32(counts, vcltq_s32(vdupq_n_s32(split_floors[j]), value));
+    }
+    vst1q_u32(bins + i, counts);
+  }
+#endif
+  for (; i < num_values; ++i) {
+    uint32_t count = 0;
+    for (size_t j = 0; j < num_splits; ++j) {
+      count += split_floors[j] < values[i];
+    }
+    bins[i] = count;
+  }
+}
+
+// IEEE half precision, stored as uint16_t. Converted by the FPU where the compiler provides __fp16.
+inline float halfToFloat(uint16_t half) {
+#ifdef __ARM_FP16_FORMAT_IEEE
+  __fp16 value;
+  std::memcpy(&value, &half, sizeof(half));
+  return value;
+#else
+  // Move exponent and mantissa into place and rebias by scaling with 2^112, this also normalizes subnormals
+  uint32_t bits = (uint32_t) (half & 0x7FFF) << 13;
+  if ((half & 0x7C00) == 0x7C00) {
+    // Infinity or NaN
+    bits |= 0x7F800000;
+  } else {
+    float scaled;
+    std::memcpy(&scaled, &bits, sizeof(bits));
+    scaled *= 5.192296858534828e33f;
+    std::memcpy(&bits, &scaled, sizeof(bits));
+  }
+  bits |= (uint32_t) (half & 0x8000) << 16;
+  float result;
+  std::memcpy(&result, &bits, sizeof(bits));
+  return result;
+#endif
+}
+
+// Round to nearest even, values beyond the half range become infinity
+inline uint16_t floatToHalf(float value) {
+#ifdef __ARM_FP16_FORMAT_IEEE
+  __fp16 half = value;
+  uint16_t result;
+  std::memcpy(&result, &half, sizeof(result));
+  return result;
+#else
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = bits & 0x80000000;
+  bits ^= sign;
+
+  uint32_t result;
+  if (bits >= 0x47800000) {
+    // Overflow to infinity, NaN stays NaN
+    result = bits > 0x7F800000 ? 0x7E00 : 0x7C00;
+  } else if (bits < 0x38800000) {
+    // Subnormal or zero: adding 0.5 aligns the mantissa and the FPU rounds
+    float shifted;
+    std::memcpy(&shifted, &bits, sizeof(bits));
+    shifted += 0.5f;
+    std::memcpy(&result, &shifted, sizeof(result));
+    result -= 0x3F000000;
+  } else {
+    // Rebias exponent and round to nearest even
+    uint32_t odd = (bits >> 13) & 1;
+    bits += 0xC8000FFF + odd;
+    result = bits >> 13;
+  }
+  return (uint16_t) (result | (sign >> 16));
+#endif
+}
+
+// Split interleaved pixels with 3 or more channels into red, green and blue
+inline void deinterleavePixels(const uint8_t* pixels, size_t num_pixels, size_t channels, uint8_t* red,
+    uint8_t* green, uint8_t* blue) {
+  size_t i = 0;
+#ifdef RANGER_NEON
+  if (channels == 3) {
+    for (; i + 16 <= num_pixels; i += 16) {
+      uint8x16x3_t rgb = vld3q_u8(pixels + 3 * i);
+      vst1q_u8(red + i, rgb.val[0]);
+      vst1q_u8(green + i, rgb.val[1]);
+      vst1q_u8(blue + i, rgb.val[2]);
+    }
+  } else if (channels == 4) {
+    for (; i + 16 <= num_pixels; i += 16) {
+      uint8x16x4_t rgba = vld4q_u8(pixels + 4 * i);
+      vst1q_u8(red + i, rgba.val[0]);
+      vst1q_u8(green + i, rgba.val[1]);
+      vst1q_u8(blue + i, rgba.val[2]);
+    }
+  }
+#endif
+  for (; i < num_pixels; ++i) {
+    red[i] = pixels[channels * i];
+    green[i] = pixels[channels * i + 1];
+    blue[i] = pixels[channels * i + 2];
+  }
+}
+
+// Convert 8 bit values, all of them are exact in float and double
+inline void convertBytes(const uint8_t* values, size_t num_values, float* result) {
+  size_t i = 0;
+#ifdef RANGER_NEON
+  for (; i + 16 <= num_values; i += 16) {
+    uint8x16_t bytes = vld1q_u8(values + i);
+    uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+    uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+    vst1q_f32(result + i, vcvtq_f32_u32(vmovl_u16(vget_low_u16(low))));
+    vst1q_f32(result + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(low))));
+    vst1q_f32(result + i + 8, vcvtq_f32_u32(vmovl_u16(vget_low_u16(high))));
+    vst1q_f32(result + i + 12, vcvtq_f32_u32(vmovl_u16(vget_high_u16(high))));
+  }
+#endif
+  for (; i < num_values; ++i) {
+    result[i] = values[i];
+  }
+}
+
+inline void convertBytes(const uint8_t* values, size_t num_values, double* result) {
+  size_t i = 0;
+#ifdef RANGER_NEON_FLOAT
+  for (; i + 8 <= num_values; i += 8) {
+    uint16x8_t words = vmovl_u8(vld1_u8(values + i));
+    float32x4_t low = vcvtq_f32_u32(vmovl_u16(vget_low_u16(words)));
+    float32x4_t high = vcvtq_f32_u32(vmovl_u16(vget_high_u16(words)));
+    vst1q_f64(result + i, vcvt_f64_f32(vget_low_f32(low)));
+    vst1q_f64(result + i + 2, vcvt_high_f64_f32(low));
+    vst1q_f64(result + i + 4, vcvt_f64_f32(vget_low_f32(high)));
+    vst1q_f64(result + i + 6, vcvt_high_f64_f32(high));
+  }
+#endif
+  for (; i < num_values; ++i) {
+    result[i] = values[i];
+  }
+}
+
+// Add values to sums elementwise. ARMv7 NEON has no double lanes, there the scalar loop is used.
+inline void addToSums(double* sums, const float* values, size_t num_values) {
+  size_t i = 0;
+#ifdef RANGER_NEON_FLOAT
+  for (; i + 4 <= num_values; i += 4) {
+    float32x4_t value = vld1q_f32(values + i);
+    vst1q_f64(sums + i, vaddq_f64(vld1q_f64(sums + i), vcvt_f64_f32(vget_low_f32(value))));
+    vst1q_f64(sums + i + 2, vaddq_f64(vld1q_f64(sums + i + 2), vcvt_high_f64_f32(value)));
+  }
+#endif
+  for (; i < num_values; ++i) {
+    sums[i] += values[i];
+  }
+}
+
+inline void addToSums(double* sums, const double* values, size_t num_values) {
+  size_t i = 0;
+#ifdef RANGER_NEON_FLOAT
+  for (; i + 2 <= num_values; i += 2) {
+    vst1q_f64(sums + i, vaddq_f64(vld1q_f64(sums + i), vld1q_f64(values + i)));
+  }
+#endif
+  for (; i < num_values; ++i) {
+    sums[i] += values[i];
+  }
+}
+
+// Add the 16 bit values of several leaves to 32 bit sums, leaves[i] points to num_values values. With two values per
+// leaf (binary classification) two leaves are added at once.
+inline void addLeafSums(uint32_t* sums, const uint16_t* const * leaves, size_t num_leaves, size_t num_values) {
+  size_t i = 0;
+#ifdef RANGER_NEON
+  if (num_values == 2) {
+    uint32x4_t pair_sums = vdupq_n_u32(0);
+    for (; i + 2 <= num_leaves; i += 2) {
+      uint32_t first;
+      uint32_t second;
+      std::memcpy(&first, leaves[i], sizeof(first));
+      std::memcpy(&second, leaves[i + 1], sizeof(second));
+      uint32x2_t pair = vset_lane_u32(second, vdup_n_u32(first), 1);
+      pair_sums = vaddw_u16(pair_sums, vreinterpret_u16_u32(pair));
+    }
+    sums[0] += vgetq_lane_u32(pair_sums, 0) + vgetq_lane_u32(pair_sums, 2);
+    sums[1] += vgetq_lane_u32(pair_sums, 1) + vgetq_lane_u32(pair_sums, 3);
+  } else if (num_values % 4 == 0) {
+    for (; i < num_leaves; ++i) {
+      for (size_t j = 0; j < num_values; j += 4) {
+        vst1q_u32(sums + j, vaddw_u16(vld1q_u32(sums + j), vld1_u16(leaves[i] + j)));
+      }
+    }
+  }
+#endif
+  for (; i < num_leaves; ++i) {
+    for (size_t j = 0; j < num_values; ++j) {
+      sums[j] += leaves[i][j];
+    }
+  }
+}
+
+// Keys bins[i] * num_classes + classIDs[i] of countClassHistogram(), written to bins
+template<typename T>
+inline void computeClassKeys(T* bins, const T* classIDs, size_t num_samples, size_t num_classes) {
+  for (size_t i = 0; i < num_samples; ++i) {
+    bins[i] = bins[i] * num_classes + classIDs[i];
+  }
+}
+
+// 32 bit indices (default index_t) are computed 4 at once
+inline void computeClassKeys(uint32_t* bins, const uint32_t* classIDs, size_t num_samples, size_t num_classes) {
+  size_t i = 0;
+#ifdef RANGER_NEON
+  uint32x4_t classes = vdupq_n_u32(num_classes);
+  for (; i + 4 <= num_samples; i += 4) {
+    vst1q_u32(bins + i, vmlaq_u32(vld1q_u32(classIDs + i), vld1q_u32(bins + i), classes));
+  }
+#endif
+  for (; i < num_samples; ++i) {
+    bins[i] = bins[i] * num_classes + classIDs[i];
+  }
+}
+
+// Histogram of the keys bins[i] * num_classes + classIDs[i], the bins are overwritten with the keys. Equal keys in a
+// row would wait for each other's increment, in large nodes consecutive samples are counted into four copies: counts
+// and three copies in scratch (3 * num_keys values), which are then added to counts. counts is not reset. T is the
+// index type of the data, index_t.
+template<typename T>
+inline void countClassHistogram(T* bins, const T* classIDs, size_t num_samples, size_t num_classes, size_t num_keys,
+    size_t* scratch, size_t* counts) {
+  computeClassKeys(bins, classIDs, num_samples, num_classes);
+
+  size_t i = 0;
+  if (num_samples >= num_keys) {
+    size_t* counts1 = scratch;
+    size_t* counts2 = scratch + num_keys;
+    size_t* counts3 = scratch + 2 * num_keys;
+    std::memset(scratch, 0, 3 * num_keys * sizeof(size_t));
+    for (; i + 4 <= num_samples; i += 4) {
+      ++counts[bins[i]];
+      ++counts1[bins[i + 1]];
+      ++counts2[bins[i + 2]];
+      ++counts3[bins[i + 3]];
+    }
+    for (size_t key = 0; key < num_keys; ++key) {
+      counts[key] += counts1[key] + counts2[key] + counts3[key];
+    }
+  }
+  for (; i < num_samples; ++i) {
+    ++counts[bins[i]];
+  }
+}
+
+} // namespace ranger
+
+#endif /* SIMD_H_ */
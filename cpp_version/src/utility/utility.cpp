@@ -81,7 +81,7 @@ void loadDoubleVectorFromFile(std::vector<double>& result, std::string filename)
   }
 } // #nocov end
 
-void drawWithoutReplacement(std::vector<size_t>& result, std::mt19937_64& random_number_generator, size_t max,
+void drawWithoutReplacement(std::vector<size_t>& result, RandomGenerator& random_number_generator, size_t max,
     size_t num_samples) {
   if (num_samples < max / 10) {
     drawWithoutReplacementSimple(result, random_number_generator, max, num_samples);
@@ -91,7 +91,7 @@ void drawWithoutReplacement(std::vector<size_t>& result, std::mt19937_64& random
   }
 }
 
-void drawWithoutReplacementSkip(std::vector<size_t>& result, std::mt19937_64& random_number_generator, size_t max,
+void drawWithoutReplacementSkip(std::vector<size_t>& result, RandomGenerator& random_number_generator, size_t max,
     const std::vector<size_t>& skip, size_t num_samples) {
   if (num_samples < max / 10) {
     drawWithoutReplacementSimple(result, random_number_generator, max, skip, num_samples);
@@ -101,7 +101,7 @@ void drawWithoutReplacementSkip(std::vector<size_t>& result, std::mt19937_64& ra
   }
 }
 
-void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64& random_number_generator, size_t max,
+void drawWithoutReplacementSimple(std::vector<size_t>& result, RandomGenerator& random_number_generator, size_t max,
     size_t num_samples) {
 
   result.reserve(num_samples);
@@ -110,18 +110,17 @@ void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64&
   std::vector<bool> temp;
   temp.resize(max, false);
 
-  std::uniform_int_distribution<size_t> unif_dist(0, max - 1);
   for (size_t i = 0; i < num_samples; ++i) {
     size_t draw;
     do {
-      draw = unif_dist(random_number_generator);
+      draw = random_number_generator.bounded(max);
     } while (temp[draw]);
     temp[draw] = true;
     result.push_back(draw);
   }
 }
 
-void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64& random_number_generator, size_t max,
+void drawWithoutReplacementSimple(std::vector<size_t>& result, RandomGenerator& random_number_generator, size_t max,
     const std::vector<size_t>& skip, size_t num_samples) {
 
   result.reserve(num_samples);
@@ -130,11 +129,10 @@ void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64&
   std::vector<bool> temp;
   temp.resize(max, false);
 
-  std::uniform_int_distribution<size_t> unif_dist(0, max - 1 - skip.size());
   for (size_t i = 0; i < num_samples; ++i) {
     size_t draw;
     do {
-      draw = unif_dist(random_number_generator);
+      draw = random_number_generator.bounded(max - skip.size());
       for (auto& skip_value : skip) {
         if (draw >= skip_value) {
           ++draw;
@@ -146,7 +144,7 @@ void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64&
   }
 }
 
-void drawWithoutReplacementFisherYates(std::vector<size_t>& result, std::mt19937_64& random_number_generator,
+void drawWithoutReplacementFisherYates(std::vector<size_t>& result, RandomGenerator& random_number_generator,
     size_t max, size_t num_samples) {
 
   // Create indices
@@ -154,16 +152,15 @@ void drawWithoutReplacementFisherYates(std::vector<size_t>& result, std::mt19937
   std::iota(result.begin(), result.end(), 0);
 
   // Draw without replacement using Fisher Yates algorithm
-  std::uniform_real_distribution<double> distribution(0.0, 1.0);
   for (size_t i = 0; i < num_samples; ++i) {
-    size_t j = i + distribution(random_number_generator) * (max - i);
+    size_t j = i + random_number_generator.bounded(max - i);
     std::swap(result[i], result[j]);
   }
 
   result.resize(num_samples);
 }
 
-void drawWithoutReplacementFisherYates(std::vector<size_t>& result, std::mt19937_64& random_number_generator,
+void drawWithoutReplacementFisherYates(std::vector<size_t>& result, RandomGenerator& random_number_generator,
     size_t max, const std::vector<size_t>& skip, size_t num_samples) {
 
   // Create indices
@@ -176,37 +173,16 @@ void drawWithoutReplacementFisherYates(std::vector<size_t>& result, std::mt19937
   }
 
   // Draw without replacement using Fisher Yates algorithm
-  std::uniform_real_distribution<double> distribution(0.0, 1.0);
   for (size_t i = 0; i < num_samples; ++i) {
-    size_t j = i + distribution(random_number_generator) * (max - skip.size() - i);
+    size_t j = i + random_number_generator.bounded(max - skip.size() - i);
     std::swap(result[i], result[j]);
   }
 
   result.resize(num_samples);
 }
 
-void drawWithoutReplacementWeighted(std::vector<size_t>& result, std::mt19937_64& random_number_generator,
-    size_t max_index, size_t num_samples, const std::vector<double>& weights) {
-
-  result.reserve(num_samples);
-
-  // Set all to not selected
-  std::vector<bool> temp;
-  temp.resize(max_index + 1, false);
-
-  std::discrete_distribution<> weighted_dist(weights.begin(), weights.end());
-  for (size_t i = 0; i < num_samples; ++i) {
-    size_t draw;
-    do {
-      draw = weighted_dist(random_number_generator);
-    } while (temp[draw]);
-    temp[draw] = true;
-    result.push_back(draw);
-  }
-}
-
 double mostFrequentValue(const std::unordered_map<double, size_t>& class_count,
-    std::mt19937_64 random_number_generator) {
+    RandomGenerator random_number_generator) {
   std::vector<double> major_classes;
 
   // Find maximum count
@@ -225,13 +201,12 @@ double mostFrequentValue(const std::unordered_map<double, size_t>& class_count,
     return major_classes[0];
   } else {
     // Choose randomly
-    std::uniform_int_distribution<size_t> unif_dist(0, major_classes.size() - 1);
-    return major_classes[unif_dist(random_number_generator)];
+    return major_classes[random_number_generator.bounded(major_classes.size())];
   }
 }
 
 double computeConcordanceIndex(const Data& data, const std::vector<double>& sum_chf,
-    const std::vector<size_t>& sample_IDs, std::vector<double>* prediction_error_casewise) {
+    const std::vector<index_t>& sample_IDs, std::vector<double>* prediction_error_casewise) {
 
   // Compute concordance index
   double concordance = 0;
@@ -326,6 +301,40 @@ std::string uintToString(uint number) {
 #endif
 }
 
+std::string doubleToString(double number) {
+  if (std::isnan(number)) {
+    return "NAN";
+  } else if (std::isinf(number)) {
+    return number > 0 ? "INFINITY" : "-INFINITY";
+  }
+  // 17 significant digits are enough to round trip any double
+  std::stringstream temp;
+  temp.precision(17);
+  temp << number;
+  return temp.str();
+}
+
+std::string cppStringLiteral(const std::string& value) {
+  std::string result = "\"";
+  for (char c : value) {
+    unsigned char code = c;
+    if (c == '"' || c == '\\' || c == '?') {
+      // Escaped question marks can not form trigraphs
+      result += '\\';
+      result += c;
+    } else if (code < 0x20 || code > 0x7E) {
+      // Always 3 digits, a following digit is not part of the escape
+      result += '\\';
+      result += (char) ('0' + (code >> 6));
+      result += (char) ('0' + ((code >> 3) & 7));
+      result += (char) ('0' + (code & 7));
+    } else {
+      result += c;
+    }
+  }
+  return result + "\"";
+}
+
 std::string beautifyTime(uint seconds) { // #nocov start
   std::string result;
 
@@ -395,55 +404,9 @@ void splitString(std::vector<double>& result, const std::string& input, char spl
   }
 } // #nocov end
 
-void shuffleAndSplit(std::vector<size_t>& first_part, std::vector<size_t>& second_part, size_t n_all, size_t n_first,
-    std::mt19937_64 random_number_generator) {
-
-  // Reserve space
-  first_part.resize(n_all);
-
-  // Fill with 0..n_all-1 and shuffle
-  std::iota(first_part.begin(), first_part.end(), 0);
-  std::shuffle(first_part.begin(), first_part.end(), random_number_generator);
-
-  // Copy to second part
-  second_part.resize(n_all - n_first);
-  std::copy(first_part.begin() + n_first, first_part.end(), second_part.begin());
-
-  // Resize first part
-  first_part.resize(n_first);
-}
-
-void shuffleAndSplitAppend(std::vector<size_t>& first_part, std::vector<size_t>& second_part, size_t n_all,
-    size_t n_first, const std::vector<size_t>& mapping, std::mt19937_64 random_number_generator) {
-  // Old end is start position for new data
-  size_t first_old_size = first_part.size();
-  size_t second_old_size = second_part.size();
-
-  // Reserve space
-  first_part.resize(first_old_size + n_all);
-  std::vector<size_t>::iterator first_start_pos = first_part.begin() + first_old_size;
-
-  // Fill with 0..n_all-1 and shuffle
-  std::iota(first_start_pos, first_part.end(), 0);
-  std::shuffle(first_start_pos, first_part.end(), random_number_generator);
-
-  // Mapping
-  for (std::vector<size_t>::iterator j = first_start_pos; j != first_part.end(); ++j) {
-    *j = mapping[*j];
-  }
-
-  // Copy to second part
-  second_part.resize(second_part.size() + n_all - n_first);
-  std::vector<size_t>::iterator second_start_pos = second_part.begin() + second_old_size;
-  std::copy(first_start_pos + n_first, first_part.end(), second_start_pos);
-
-  // Resize first part
-  first_part.resize(first_old_size + n_first);
-}
-
 std::string checkUnorderedVariables(const Data& data, const std::vector<std::string>& unordered_variable_names) { // #nocov start
   size_t num_rows = data.getNumRows();
-  std::vector<size_t> sampleIDs(num_rows);
+  std::vector<index_t> sampleIDs(num_rows);
   std::iota(sampleIDs.begin(), sampleIDs.end(), 0);
 
   // Check for all unordered variables
@@ -541,12 +504,15 @@ std::vector<double> adjustPvalues(std::vector<double>& unadjusted_pvalues) {
 }
 
 std::vector<double> logrankScores(const std::vector<double>& time, const std::vector<double>& status) {
+  // Get order of timepoints
+  return logrankScores(time, status, order(time, false));
+}
+
+std::vector<double> logrankScores(const std::vector<double>& time, const std::vector<double>& status,
+    const std::vector<size_t>& indices) {
   size_t n = time.size();
   std::vector<double> scores(n);
 
-  // Get order of timepoints
-  std::vector<size_t> indices = order(time, false);
-
   // Compute scores
   double cumsum = 0;
   size_t last_unique = -1;
@@ -17,6 +17,7 @@
 #include <fstream>
 #include <algorithm>
 #include <random>
+#include <numeric>
 #include <unordered_set>
 #include <unordered_map>
 #include <cstddef>
@@ -30,6 +31,7 @@
 
 #include "globals.h"
 #include "Data.h"
+#include "RandomGenerator.h"
 
 namespace ranger {
 
@@ -155,7 +157,7 @@ void loadDoubleVectorFromFile(std::vector<double>& result, std::string filename)
  * @param range_length Length of range. Interval to draw from: 0..max-1
  * @param num_samples Number of samples to draw
  */
-void drawWithoutReplacement(std::vector<size_t>& result, std::mt19937_64& random_number_generator, size_t range_length,
+void drawWithoutReplacement(std::vector<size_t>& result, RandomGenerator& random_number_generator, size_t range_length,
     size_t num_samples);
 
 /**
@@ -166,7 +168,7 @@ void drawWithoutReplacement(std::vector<size_t>& result, std::mt19937_64& random
  * @param skip Values to skip
  * @param num_samples Number of samples to draw
  */
-void drawWithoutReplacementSkip(std::vector<size_t>& result, std::mt19937_64& random_number_generator,
+void drawWithoutReplacementSkip(std::vector<size_t>& result, RandomGenerator& random_number_generator,
     size_t range_length, const std::vector<size_t>& skip, size_t num_samples);
 
 /**
@@ -176,7 +178,7 @@ void drawWithoutReplacementSkip(std::vector<size_t>& result, std::mt19937_64& ra
  * @param range_length Length of range. Interval to draw from: 0..max-1
  * @param num_samples Number of samples to draw
  */
-void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64& random_number_generator, size_t max,
+void drawWithoutReplacementSimple(std::vector<size_t>& result, RandomGenerator& random_number_generator, size_t max,
     size_t num_samples);
 
 /**
@@ -187,7 +189,7 @@ void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64&
  * @param skip Values to skip
  * @param num_samples Number of samples to draw
  */
-void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64& random_number_generator, size_t max,
+void drawWithoutReplacementSimple(std::vector<size_t>& result, RandomGenerator& random_number_generator, size_t max,
     const std::vector<size_t>& skip, size_t num_samples);
 
 /**
@@ -197,7 +199,7 @@ void drawWithoutReplacementSimple(std::vector<size_t>& result, std::mt19937_64&
  * @param max Length of range. Interval to draw from: 0..max-1
  * @param num_samples Number of samples to draw
  */
-void drawWithoutReplacementFisherYates(std::vector<size_t>& result, std::mt19937_64& random_number_generator,
+void drawWithoutReplacementFisherYates(std::vector<size_t>& result, RandomGenerator& random_number_generator,
     size_t max, size_t num_samples);
 
 /**
@@ -208,7 +210,7 @@ void drawWithoutReplacementFisherYates(std::vector<size_t>& result, std::mt19937
  * @param skip Values to skip
  * @param num_samples Number of samples to draw
  */
-void drawWithoutReplacementFisherYates(std::vector<size_t>& result, std::mt19937_64& random_number_generator,
+void drawWithoutReplacementFisherYates(std::vector<size_t>& result, RandomGenerator& random_number_generator,
     size_t max, const std::vector<size_t>& skip, size_t num_samples);
 
 /**
@@ -219,8 +221,26 @@ void drawWithoutReplacementFisherYates(std::vector<size_t>& result, std::mt19937
  * @param num_samples Number of samples to draw
  * @param weights A weight for each element of indices
  */
-void drawWithoutReplacementWeighted(std::vector<size_t>& result, std::mt19937_64& random_number_generator,
-    size_t max_index, size_t num_samples, const std::vector<double>& weights);
+template<typename T>
+void drawWithoutReplacementWeighted(std::vector<T>& result, RandomGenerator& random_number_generator,
+    size_t max_index, size_t num_samples, const std::vector<double>& weights) {
+
+  result.reserve(num_samples);
+
+  // Set all to not selected
+  std::vector<bool> temp;
+  temp.resize(max_index + 1, false);
+
+  std::discrete_distribution<> weighted_dist(weights.begin(), weights.end());
+  for (size_t i = 0; i < num_samples; ++i) {
+    size_t draw;
+    do {
+      draw = weighted_dist(random_number_generator);
+    } while (temp[draw]);
+    temp[draw] = true;
+    result.push_back(draw);
+  }
+}
 
 /**
  * Draw random numbers of a vector without replacement.
@@ -231,7 +251,7 @@ void drawWithoutReplacementWeighted(std::vector<size_t>& result, std::mt19937_64
  */
 template<typename T>
 void drawWithoutReplacementFromVector(std::vector<T>& result, const std::vector<T>& input,
-    std::mt19937_64& random_number_generator, size_t num_samples) {
+    RandomGenerator& random_number_generator, size_t num_samples) {
 
   // Draw random indices
   std::vector<size_t> result_idx;
@@ -252,7 +272,7 @@ void drawWithoutReplacementFromVector(std::vector<T>& result, const std::vector<
  * @return Most frequent class index. Out of range index if all 0.
  */
 template<typename T>
-size_t mostFrequentClass(const std::vector<T>& class_count, std::mt19937_64 random_number_generator) {
+size_t mostFrequentClass(const std::vector<T>& class_count, RandomGenerator random_number_generator) {
   std::vector<size_t> major_classes;
 
 // Find maximum count
@@ -274,8 +294,7 @@ size_t mostFrequentClass(const std::vector<T>& class_count, std::mt19937_64 rand
     return major_classes[0];
   } else {
     // Choose randomly
-    std::uniform_int_distribution<size_t> unif_dist(0, major_classes.size() - 1);
-    return major_classes[unif_dist(random_number_generator)];
+    return major_classes[random_number_generator.bounded(major_classes.size())];
   }
 }
 
@@ -286,7 +305,7 @@ size_t mostFrequentClass(const std::vector<T>& class_count, std::mt19937_64 rand
  * @return Most frequent value
  */
 double mostFrequentValue(const std::unordered_map<double, size_t>& class_count,
-    std::mt19937_64 random_number_generator);
+    RandomGenerator random_number_generator);
 
 /**
  * Compute concordance index for given data and summed cumulative hazard function/estimate
@@ -298,7 +317,7 @@ double mostFrequentValue(const std::unordered_map<double, size_t>& class_count,
  * @return concordance index
  */
 double computeConcordanceIndex(const Data& data, const std::vector<double>& sum_chf,
-    const std::vector<size_t>& sample_IDs, std::vector<double>* prediction_error_casewise);
+    const std::vector<index_t>& sample_IDs, std::vector<double>* prediction_error_casewise);
 
 /**
  * Convert a unsigned integer to string
@@ -307,6 +326,21 @@ double computeConcordanceIndex(const Data& data, const std::vector<double>& sum_
  */
 std::string uintToString(uint number);
 
+/**
+ * Convert a double to string, reading the string back gives exactly the same value
+ * @param number Number to convert
+ * @return Converted number as string, NAN and INFINITY for special values
+ */
+std::string doubleToString(double number);
+
+/**
+ * Convert a string to a C++ string literal, quotes and backslashes are escaped and other characters outside of
+ * printable ASCII are written as octal escapes
+ * @param value String to convert
+ * @return String literal including the quotes
+ */
+std::string cppStringLiteral(const std::string& value);
+
 /**
  * Beautify output of time.
  * @param seconds Time in seconds
@@ -346,8 +380,24 @@ void splitString(std::vector<double>& result, const std::string& input, char spl
  * @param n_first Number of elements of first part
  * @param random_number_generator Random number generator
  */
-void shuffleAndSplit(std::vector<size_t>& first_part, std::vector<size_t>& second_part, size_t n_all, size_t n_first,
-    std::mt19937_64 random_number_generator);
+template<typename T>
+void shuffleAndSplit(std::vector<T>& first_part, std::vector<T>& second_part, size_t n_all, size_t n_first,
+    RandomGenerator random_number_generator) {
+
+  // Reserve space
+  first_part.resize(n_all);
+
+  // Fill with 0..n_all-1 and shuffle
+  std::iota(first_part.begin(), first_part.end(), 0);
+  std::shuffle(first_part.begin(), first_part.end(), random_number_generator);
+
+  // Copy to second part
+  second_part.resize(n_all - n_first);
+  std::copy(first_part.begin() + n_first, first_part.end(), second_part.begin());
+
+  // Resize first part
+  first_part.resize(n_first);
+}
 
 /**
  * Create numbers from 0 to n_all-1, shuffle and split in two parts. Append to existing data.
@@ -358,8 +408,34 @@ void shuffleAndSplit(std::vector<size_t>& first_part, std::vector<size_t>& secon
  * @param mapping Values to use instead of 0...n-1
  * @param random_number_generator Random number generator
  */
-void shuffleAndSplitAppend(std::vector<size_t>& first_part, std::vector<size_t>& second_part, size_t n_all,
-    size_t n_first, const std::vector<size_t>& mapping, std::mt19937_64 random_number_generator);
+template<typename T>
+void shuffleAndSplitAppend(std::vector<T>& first_part, std::vector<T>& second_part, size_t n_all,
+    size_t n_first, const std::vector<size_t>& mapping, RandomGenerator random_number_generator) {
+  // Old end is start position for new data
+  size_t first_old_size = first_part.size();
+  size_t second_old_size = second_part.size();
+
+  // Reserve space
+  first_part.resize(first_old_size + n_all);
+  typename std::vector<T>::iterator first_start_pos = first_part.begin() + first_old_size;
+
+  // Fill with 0..n_all-1 and shuffle
+  std::iota(first_start_pos, first_part.end(), 0);
+  std::shuffle(first_start_pos, first_part.end(), random_number_generator);
+
+  // Mapping
+  for (typename std::vector<T>::iterator j = first_start_pos; j != first_part.end(); ++j) {
+    *j = mapping[*j];
+  }
+
+  // Copy to second part
+  second_part.resize(second_part.size() + n_all - n_first);
+  typename std::vector<T>::iterator second_start_pos = second_part.begin() + second_old_size;
+  std::copy(first_start_pos + n_first, first_part.end(), second_start_pos);
+
+  // Resize first part
+  first_part.resize(first_old_size + n_first);
+}
 
 /**
  * Check if not too many factor levels and all values in unordered categorical variables are positive integers.
@@ -448,17 +524,15 @@ std::vector<size_t> order(const std::vector<T>& values, bool decreasing) {
 }
 
 /**
- * Sample ranks starting from 1. Ties are given the average rank.
+ * Sample ranks starting from 1 for values with known order. Ties are given the average rank.
  * @param values Values to rank
+ * @param indices Ordering of values
  * @return Ranks of input values
  */
 template<typename T>
-std::vector<double> rank(const std::vector<T>& values) {
+std::vector<double> rank(const std::vector<T>& values, const std::vector<size_t>& indices) {
   size_t num_values = values.size();
 
-// Order
-  std::vector<size_t> indices = order(values, false);
-
 // Compute ranks, start at 1
   std::vector<double> ranks(num_values);
   size_t reps = 1;
@@ -478,6 +552,16 @@ std::vector<double> rank(const std::vector<T>& values) {
   return ranks;
 }
 
+/**
+ * Sample ranks starting from 1. Ties are given the average rank.
+ * @param values Values to rank
+ * @return Ranks of input values
+ */
+template<typename T>
+std::vector<double> rank(const std::vector<T>& values) {
+  return rank(values, order(values, false));
+}
+
 /**
  * Compute Logrank scores for survival times
  * @param time Survival time
@@ -486,6 +570,16 @@ std::vector<double> rank(const std::vector<T>& values) {
  */
 std::vector<double> logrankScores(const std::vector<double>& time, const std::vector<double>& status);
 
+/**
+ * Compute Logrank scores for survival times with known order
+ * @param time Survival time
+ * @param status Censoring indicator
+ * @param indices Ordering of time
+ * @return Logrank scores
+ */
+std::vector<double> logrankScores(const std::vector<double>& time, const std::vector<double>& status,
+    const std::vector<size_t>& indices);
+
 /**
  * Compute maximally selected rank statistics
  * @param scores Scores for dependent variable (y)
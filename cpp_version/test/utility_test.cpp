@@ -1,9 +1,37 @@
 #include <map>
 #include <unordered_set>
 #include <fstream>
+#include <sstream>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <thread>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 #include "gtest/gtest.h"
 #include "utility.h"
+#include "RegularizationState.h"
+#include "DataAdaptive.h"
+#include "DataDouble.h"
+#include "DataFloat.h"
+#include "DataMapped.h"
+#include "DataRowMajor.h"
+#include "RunStats.h"
+#include "Sampling.h"
+#include "Simd.h"
+#include "stb_image_write.h"
+#include "ForestClassification.h"
+#include "ForestProbability.h"
+#include "ForestRegression.h"
+#include "ForestSurvival.h"
+#include "PredictionServer.h"
 
 using namespace ranger;
 
@@ -105,6 +133,7 @@ TEST(readWrite1D, int1) {
   std::vector<int> test;
   readVector1D(test, infile);
   infile.close();
+  std::remove("testfile1d");
 
   EXPECT_EQ(expect, test);
 }
@@ -127,6 +156,7 @@ TEST(readWrite1D, double1) {
   std::vector<double> test;
   readVector1D(test, infile);
   infile.close();
+  std::remove("testfile1d");
 
   EXPECT_EQ(expect, test);
 }
@@ -156,6 +186,7 @@ TEST(readWrite2D, int1) {
   std::vector<std::vector<int>> test;
   readVector2D(test, infile);
   infile.close();
+  std::remove("testfile2d");
 
   EXPECT_EQ(expect, test);
 }
@@ -185,6 +216,7 @@ TEST(readWrite2D, double1) {
   std::vector<std::vector<double>> test;
   readVector2D<double>(test, infile);
   infile.close();
+  std::remove("testfile2d");
 
   EXPECT_EQ(expect, test);
 }
@@ -192,7 +224,7 @@ TEST(readWrite2D, double1) {
 TEST(drawWithoutReplacementSkip, small_small1) {
 
   std::vector<size_t> result;
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
   std::map<size_t, uint> counts;
@@ -222,7 +254,7 @@ TEST(drawWithoutReplacementSkip, small_small1) {
 TEST(drawWithoutReplacementSkip, small_small2) {
 
   std::vector<size_t> result;
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
   std::map<size_t, uint> counts;
@@ -252,7 +284,7 @@ TEST(drawWithoutReplacementSkip, small_small2) {
 TEST(drawWithoutReplacementSkip, small_small3) {
 
   std::vector<size_t> result;
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
   std::map<size_t, uint> counts;
@@ -282,7 +314,7 @@ TEST(drawWithoutReplacementSkip, small_small3) {
 TEST(drawWithoutReplacementSkip, small_large1) {
 
   std::vector<size_t> result;
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
   std::map<size_t, uint> counts;
@@ -312,7 +344,7 @@ TEST(drawWithoutReplacementSkip, small_large1) {
 TEST(drawWithoutReplacementSkip, large_large1) {
 
   std::vector<size_t> result;
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
   std::map<size_t, uint> counts;
@@ -339,8 +371,317 @@ TEST(drawWithoutReplacementSkip, large_large1) {
   EXPECT_EQ(0, counts[skip[0]]);
 }
 
+TEST(drawWithoutReplacementSelection, mapping) {
+
+  std::vector<size_t> result;
+  RandomGenerator random_number_generator;
+  random_number_generator.seed(42);
+  std::map<size_t, uint> counts;
+
+  std::vector<size_t> mapping = std::vector<size_t>( { 3, 5, 8, 13, 21, 34, 55, 89, 144, 233 });
+  size_t num_samples = 4;
+  size_t num_replicates = 10000;
+
+  size_t expected_count = num_samples * num_replicates / mapping.size();
+
+  for (size_t i = 0; i < num_replicates; ++i) {
+    result.clear();
+    drawWithoutReplacementSelection(result, mapping.size(), num_samples, &mapping, random_number_generator);
+    EXPECT_EQ(num_samples, std::unordered_set<size_t>(result.begin(), result.end()).size());
+    for (auto& idx : result) {
+      ++counts[idx];
+    }
+  }
+
+  // Check if only mapped values drawn and counts are expected +- 5%
+  EXPECT_EQ(mapping.size(), counts.size());
+  for (auto& value : mapping) {
+    EXPECT_NEAR(expected_count, counts[value], expected_count * 0.05);
+  }
+}
+
+TEST(AliasTable, frequencies) {
+
+  RandomGenerator random_number_generator;
+  random_number_generator.seed(42);
+  std::vector<double> weights = std::vector<double>( { 1, 0, 2, 0.5, 4, 0.5 });
+  AliasTable alias_table(weights);
+
+  size_t num_replicates = 80000;
+  std::vector<size_t> counts(weights.size(), 0);
+  for (size_t i = 0; i < num_replicates; ++i) {
+    ++counts[alias_table.draw(random_number_generator)];
+  }
+
+  // Check if counts are expected +- 5%
+  for (size_t i = 0; i < weights.size(); ++i) {
+    double expected_count = num_replicates * weights[i] / 8;
+    EXPECT_NEAR(expected_count, counts[i], expected_count * 0.05);
+  }
+}
+
+// Bounded values are in [0, range), small ranges are uniform
+TEST(RandomGenerator, bounded) {
+  RandomGenerator random_number_generator(42);
+  for (uint64_t range : std::vector<uint64_t>( { 1, 2, 7, 1000, (uint64_t) 1 << 40,
+      std::numeric_limits<uint64_t>::max() })) {
+    for (size_t i = 0; i < 10000; ++i) {
+      EXPECT_LT(random_number_generator.bounded(range), range);
+    }
+  }
+
+  // Check if counts are expected +- 5%
+  size_t num_replicates = 70000;
+  std::vector<size_t> counts(7, 0);
+  for (size_t i = 0; i < num_replicates; ++i) {
+    ++counts[random_number_generator.bounded(7)];
+  }
+  for (size_t value = 0; value < 7; ++value) {
+    EXPECT_NEAR(num_replicates / 7, counts[value], num_replicates / 7 * 0.05);
+  }
+}
+
+// Uniform values are in [0, 1) with equal counts in 10 bins and mean 0.5
+TEST(RandomGenerator, uniform) {
+  RandomGenerator random_number_generator(7, 3);
+  size_t num_replicates = 100000;
+  std::vector<size_t> counts(10, 0);
+  double sum = 0;
+  for (size_t i = 0; i < num_replicates; ++i) {
+    double value = random_number_generator.uniform();
+    ASSERT_GE(value, 0);
+    ASSERT_LT(value, 1);
+    ++counts[(size_t) (value * 10)];
+    sum += value;
+  }
+  for (size_t bin = 0; bin < 10; ++bin) {
+    EXPECT_NEAR(num_replicates / 10, counts[bin], num_replicates / 10 * 0.05);
+  }
+  EXPECT_NEAR(0.5, sum / num_replicates, 0.01);
+}
+
+// Streams of the same seed and stream seeds give uncorrelated sequences
+TEST(RandomGenerator, streams) {
+  size_t num_draws = 10000;
+  std::vector<RandomGenerator> generators = { RandomGenerator(1, 0), RandomGenerator(1, 1), RandomGenerator(1, 2),
+      RandomGenerator(RandomGenerator(1).streamSeed(0)), RandomGenerator(RandomGenerator(1).streamSeed(1)) };
+  std::vector<std::vector<double>> values(generators.size());
+  for (size_t i = 0; i < generators.size(); ++i) {
+    for (size_t j = 0; j < num_draws; ++j) {
+      values[i].push_back(generators[i].uniform() - 0.5);
+    }
+  }
+
+  // Correlation of independent sequences is about 1/sqrt(num_draws)
+  for (size_t i = 0; i < values.size(); ++i) {
+    for (size_t j = i + 1; j < values.size(); ++j) {
+      double sum_products = 0;
+      size_t num_equal = 0;
+      for (size_t k = 0; k < num_draws; ++k) {
+        sum_products += values[i][k] * values[j][k];
+        num_equal += values[i][k] == values[j][k];
+      }
+      EXPECT_NEAR(0, sum_products / num_draws * 12, 0.05);
+      EXPECT_EQ(0, num_equal);
+    }
+  }
+}
+
+// The same seed and stream give the same sequence, independent of other generators, other seeds do not
+TEST(RandomGenerator, reproducible) {
+  RandomGenerator first(123, 5);
+  std::vector<uint64_t> values;
+  for (size_t i = 0; i < 100; ++i) {
+    values.push_back(first());
+  }
+
+  RandomGenerator second;
+  second.seed(123, 5);
+  RandomGenerator other(123, 6);
+  for (size_t i = 0; i < 100; ++i) {
+    other();
+    EXPECT_EQ(values[i], second());
+  }
+
+  // Discarding skips draws
+  RandomGenerator skipping(123, 5);
+  skipping.discard(40);
+  EXPECT_EQ(values[40], skipping());
+
+  // Reseeding starts over
+  second.seed(123, 5);
+  EXPECT_EQ(values[0], second());
+
+  for (uint64_t seed : { 0, 1, 122, 124 }) {
+    RandomGenerator different(seed, 5);
+    size_t num_equal = 0;
+    for (size_t i = 0; i < 100; ++i) {
+      num_equal += different() == values[i];
+    }
+    EXPECT_EQ(0, num_equal);
+  }
+
+  // Works with std distributions
+  std::uniform_int_distribution<size_t> distribution(0, 9);
+  RandomGenerator distribution_first(9);
+  RandomGenerator distribution_second(9);
+  for (size_t i = 0; i < 100; ++i) {
+    EXPECT_EQ(distribution(distribution_first), distribution(distribution_second));
+  }
+}
+
+TEST(Simd, countSortedBelow) {
+  std::vector<float> values( { -3, -1, 0, 0, 0.5, 1, 2, 2, 2, 7, 8, 9, 100 });
+  for (float threshold : { -5.0f, -1.0f, 0.0f, 0.25f, 2.0f, 2.5f, 9.0f, 1000.0f }) {
+    size_t expect = 0;
+    while (expect < values.size() && values[expect] < threshold) {
+      ++expect;
+    }
+    EXPECT_EQ(expect, ranger::countSortedBelow(values.data(), values.size(), threshold));
+  }
+  EXPECT_EQ(0, ranger::countSortedBelow(values.data(), values.size(), NAN));
+}
+
+TEST(Simd, countBelow) {
+  // Sorted split values of extra trees, odd length for the remainder loop
+  std::vector<double> values( { -2, 0.1, 0.1, 3, 4.5 });
+  for (double threshold : { -3.0, -2.0, 0.1, 0.2, 4.5, 5.0 }) {
+    size_t expect = 0;
+    while (expect < values.size() && values[expect] < threshold) {
+      ++expect;
+    }
+    EXPECT_EQ(expect, ranger::countBelow(values.data(), values.size(), threshold));
+  }
+  EXPECT_EQ(0, ranger::countBelow(values.data(), values.size(), NAN));
+}
+
+TEST(Simd, computeBins) {
+  // Bins as counted by countBelow, 7 values for the remainder loops
+  std::vector<double> split_values( { -2, 0.1, 0.1, 3, 4.5 });
+  std::vector<double> values( { -3, -2, 0.1, 0.2, 4.5, 5, NAN });
+  std::vector<uint32_t> bins(values.size());
+  ranger::computeBins(values.data(), values.size(), split_values.data(), split_values.size(), bins.data());
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(ranger::countBelow(split_values.data(), split_values.size(), values[i]), bins[i]);
+  }
+
+  // Integer values with rounded down split values give the same bins
+  std::vector<double> integer_split_values( { 0.5, 2, 2.75, 65534.5 });
+  std::vector<int32_t> split_floors( { 0, 2, 2, 65534 });
+  std::vector<int32_t> integer_values( { 0, 1, 2, 3, 65534, 65535, 2 });
+  ranger::computeBins(integer_values.data(), integer_values.size(), split_floors.data(), split_floors.size(),
+      bins.data());
+  for (size_t i = 0; i < integer_values.size(); ++i) {
+    EXPECT_EQ(ranger::countBelow(integer_split_values.data(), integer_split_values.size(), integer_values[i]),
+        bins[i]);
+  }
+}
+
+TEST(Simd, half) {
+  // Exact values, rounding to nearest even, subnormals and overflow
+  for (float value : { 0.0f, -2.0f, 0.5f, 255.0f, 2048.0f, 65504.0f, 6.1035156e-05f, 5.9604645e-08f }) {
+    EXPECT_EQ(value, ranger::halfToFloat(ranger::floatToHalf(value)));
+  }
+  EXPECT_EQ(2048.0f, ranger::halfToFloat(ranger::floatToHalf(2049.0f)));
+  EXPECT_EQ(2052.0f, ranger::halfToFloat(ranger::floatToHalf(2051.0f)));
+  EXPECT_EQ(0.0f, ranger::halfToFloat(ranger::floatToHalf(1e-9f)));
+  EXPECT_TRUE(std::isinf(ranger::halfToFloat(ranger::floatToHalf(70000.0f))));
+  EXPECT_TRUE(std::isnan(ranger::halfToFloat(ranger::floatToHalf(NAN))));
+
+  // All half values convert back unchanged
+  for (uint32_t half = 0; half < 0x7C00; ++half) {
+    EXPECT_EQ(half, ranger::floatToHalf(ranger::halfToFloat(half)));
+  }
+}
+
+// Small node counted directly, large node with copies, both not a multiple of the vector length
+template<typename T>
+void checkCountClassHistogram() {
+  size_t num_bins = 5;
+  size_t num_classes = 3;
+  size_t num_keys = num_bins * num_classes;
+  for (size_t num_samples : { 7, 61 }) {
+    std::vector<T> bins(num_samples);
+    std::vector<T> classIDs(num_samples);
+    std::vector<size_t> expect(num_keys, 1);
+    for (size_t i = 0; i < num_samples; ++i) {
+      bins[i] = (i * 7) % num_bins;
+      classIDs[i] = (i / 2) % num_classes;
+      ++expect[bins[i] * num_classes + classIDs[i]];
+    }
+    std::vector<size_t> counts(num_keys, 1);
+    std::vector<size_t> scratch(3 * num_keys, 9);
+    ranger::countClassHistogram(bins.data(), classIDs.data(), num_samples, num_classes, num_keys, scratch.data(),
+        counts.data());
+    EXPECT_EQ(expect, counts);
+  }
+}
+
+// Both index widths, 64 bit with RANGER_64BIT_INDEX
+TEST(Simd, countClassHistogram) {
+  checkCountClassHistogram<uint32_t>();
+  checkCountClassHistogram<uint64_t>();
+}
+
+void checkPixels(size_t num_channels) {
+  // Not a multiple of the vector length to cover the remainder loops
+  size_t num_pixels = 37;
+  std::vector<uint8_t> pixels(num_channels * num_pixels);
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = (i * 89 + 7) % 256;
+  }
+
+  std::vector<uint8_t> channels(3 * num_pixels);
+  ranger::deinterleavePixels(pixels.data(), num_pixels, num_channels, channels.data(), channels.data() + num_pixels,
+      channels.data() + 2 * num_pixels);
+  std::vector<float> values_float(num_pixels);
+  ranger::convertBytes(channels.data() + num_pixels, num_pixels, values_float.data());
+  std::vector<double> values_double(num_pixels);
+  ranger::convertBytes(channels.data() + num_pixels, num_pixels, values_double.data());
+  std::vector<double> sums(num_pixels, 0.5);
+  ranger::addToSums(sums.data(), values_float.data(), num_pixels);
+  ranger::addToSums(sums.data(), values_double.data(), num_pixels);
+
+  for (size_t i = 0; i < num_pixels; ++i) {
+    EXPECT_EQ(pixels[num_channels * i], channels[i]);
+    EXPECT_EQ(pixels[num_channels * i + 1], channels[num_pixels + i]);
+    EXPECT_EQ(pixels[num_channels * i + 2], channels[2 * num_pixels + i]);
+    EXPECT_EQ(pixels[num_channels * i + 1], values_float[i]);
+    EXPECT_EQ(pixels[num_channels * i + 1], values_double[i]);
+    EXPECT_EQ(0.5 + 2 * pixels[num_channels * i + 1], sums[i]);
+  }
+}
+
+// RGB and RGBA, the alpha channel is skipped
+TEST(Simd, pixels) {
+  checkPixels(3);
+  checkPixels(4);
+}
+
+// Leaves with 2 values are added in pairs, multiples of 4 values in vectors, others one by one
+TEST(Simd, addLeafSums) {
+  for (size_t num_values : { 1, 2, 3, 4, 8 }) {
+    for (size_t num_leaves : { 0, 1, 2, 7, 16 }) {
+      std::vector<std::vector<uint16_t>> leaf_values(num_leaves);
+      std::vector<const uint16_t*> leaves;
+      std::vector<uint32_t> expected_sums(num_values, 100000);
+      for (size_t i = 0; i < num_leaves; ++i) {
+        for (size_t j = 0; j < num_values; ++j) {
+          leaf_values[i].push_back(65535 - (i * 7919 + j * 104729) % 1000);
+          expected_sums[j] += leaf_values[i][j];
+        }
+        leaves.push_back(leaf_values[i].data());
+      }
+
+      std::vector<uint32_t> sums(num_values, 100000);
+      ranger::addLeafSums(sums.data(), leaves.data(), num_leaves, num_values);
+      EXPECT_EQ(expected_sums, sums);
+    }
+  }
+}
+
 TEST(mostFrequentClass, notEqual1) {
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -350,7 +691,7 @@ TEST(mostFrequentClass, notEqual1) {
 }
 
 TEST(mostFrequentClass, notEqual2) {
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -360,7 +701,7 @@ TEST(mostFrequentClass, notEqual2) {
 }
 
 TEST(mostFrequentClass, equal1) {
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -371,7 +712,7 @@ TEST(mostFrequentClass, equal1) {
 }
 
 TEST(mostFrequentClass, equal2) {
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -383,7 +724,7 @@ TEST(mostFrequentClass, equal2) {
 
 TEST(mostFrequentValue, notEqual1) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -397,7 +738,7 @@ TEST(mostFrequentValue, notEqual1) {
 
 TEST(mostFrequentValue, notEqual2) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -411,7 +752,7 @@ TEST(mostFrequentValue, notEqual2) {
 
 TEST(mostFrequentValue, equal1) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -426,7 +767,7 @@ TEST(mostFrequentValue, equal1) {
 
 TEST(mostFrequentValue, equal2) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -441,7 +782,7 @@ TEST(mostFrequentValue, equal2) {
 
 TEST(mostFrequentValue, equal3) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -486,6 +827,27 @@ TEST(beautifyTime, days2) {
   EXPECT_EQ("3 days, 7 hours, 49 minutes, 5 seconds", beautifyTime(287345));
 }
 
+TEST(doubleToString, roundTrip) {
+  std::vector<double> values = { 0, 1, -2.5, 0.1, 1.0 / 3, 146.5, 1e-300, 1.7976931348623157e308 };
+  for (auto& value : values) {
+    EXPECT_EQ(value, std::stod(doubleToString(value)));
+  }
+}
+
+TEST(doubleToString, special) {
+  EXPECT_EQ("NAN", doubleToString(NAN));
+  EXPECT_EQ("INFINITY", doubleToString(INFINITY));
+  EXPECT_EQ("-INFINITY", doubleToString(-INFINITY));
+}
+
+TEST(cppStringLiteral, escape) {
+  EXPECT_EQ("\"x1\"", cppStringLiteral("x1"));
+  EXPECT_EQ("\"a\\\"b\\\\c\"", cppStringLiteral("a\"b\\c"));
+  EXPECT_EQ("\"\\?\\?=\"", cppStringLiteral("?\?="));
+  EXPECT_EQ("\"x\\0151\"", cppStringLiteral("x\r1"));
+  EXPECT_EQ("\"\\303\\251\"", cppStringLiteral("\xC3\xA9"));
+}
+
 TEST(roundToNextMultiple, test0) {
   EXPECT_EQ(0, roundToNextMultiple(0, 4));
 }
@@ -564,7 +926,7 @@ TEST(splitString, test4) {
 
 TEST(shuffleAndSplit, test1) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -579,7 +941,7 @@ TEST(shuffleAndSplit, test1) {
 
 TEST(shuffleAndSplit, test2) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -594,7 +956,7 @@ TEST(shuffleAndSplit, test2) {
 
 TEST(shuffleAndSplit, test3) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -609,7 +971,7 @@ TEST(shuffleAndSplit, test3) {
 
 TEST(shuffleAndSplit, test4) {
 
-  std::mt19937_64 random_number_generator;
+  RandomGenerator random_number_generator;
   std::random_device random_device;
   random_number_generator.seed(random_device());
 
@@ -622,6 +984,24 @@ TEST(shuffleAndSplit, test4) {
   EXPECT_EQ(3, second_part.size());
 }
 
+TEST(shuffleAndSplit, test5) {
+
+  // Same split for size_t and index_t vectors with the same seed
+  RandomGenerator random_number_generator;
+  random_number_generator.seed(42);
+
+  std::vector<size_t> first_part;
+  std::vector<size_t> second_part;
+  shuffleAndSplit(first_part, second_part, 100, 63, random_number_generator);
+
+  std::vector<index_t> first_part_index;
+  std::vector<index_t> second_part_index;
+  shuffleAndSplit(first_part_index, second_part_index, 100, 63, random_number_generator);
+
+  EXPECT_EQ(first_part, std::vector<size_t>(first_part_index.begin(), first_part_index.end()));
+  EXPECT_EQ(second_part, std::vector<size_t>(second_part_index.begin(), second_part_index.end()));
+}
+
 TEST(maxstatPValueLau92, test1) {
 
   // From R call dput(sapply(seq(0.5, 10, by = 0.5), maxstat::pLausen92, minprop = 0.1, maxprop = 0.9))
@@ -873,6 +1253,23 @@ TEST(rank, test3) {
 
 
 
+TEST(rank, ordered) {
+
+  // Presorted values with ties, positions are the order
+  std::vector<double> x = std::vector<double>( { 1, 2, 2, 3, 5, 5, 5, 8 });
+  std::vector<size_t> indices(x.size());
+  std::iota(indices.begin(), indices.end(), 0);
+
+  const std::vector<double> expect = std::vector<double>( { 1, 2.5, 2.5, 4, 6, 6, 6, 8 });
+
+  std::vector<double> ranks = rank(x, indices);
+
+  // Compare with expectation
+  for (size_t i = 0; i < x.size(); ++i) {
+    EXPECT_EQ(ranks[i], expect[i]);
+  }
+}
+
 TEST(logrankScores, test1) {
 
   // From R call:
@@ -1328,3 +1725,879 @@ TEST(numSamplesLeftOfCutpoint, test1) {
   }
 }
 
+
+// Allocations are only counted while a RunStats object exists
+TEST(RunStats, allocationCounting) {
+  size_t bytes_before = RunStats::getAllocatedBytes();
+  std::vector<char>* buffer = new std::vector<char>(1000);
+  EXPECT_EQ(bytes_before, RunStats::getAllocatedBytes());
+  delete buffer;
+
+  RunStats stats;
+  bytes_before = RunStats::getAllocatedBytes();
+  buffer = new std::vector<char>(1000);
+  EXPECT_GE(RunStats::getAllocatedBytes() - bytes_before, (size_t) 1000);
+  delete buffer;
+}
+
+// Unique values and indexes with counting sort and lookup (integer columns with small range) and with std::sort
+// and binary search (other columns) are the same as of sorting each column, for any number of threads
+void checkSort(size_t num_rows, uint num_threads) {
+  std::vector<double> values;
+  for (size_t row = 0; row < num_rows; ++row) {
+    values.push_back((row * 7919) % 251);
+    values.push_back(static_cast<double>((row * 131) % 1000) - 500);
+    values.push_back((row * 37) % 101 * 0.25);
+    values.push_back((row * 104729) % 100003 * 1000.0);
+    values.push_back(5);
+  }
+  DataDouble data;
+  data.loadFromValues( { "a", "b", "c", "d", "e" }, values, num_rows);
+  data.sort(num_threads);
+
+  for (size_t col = 0; col < 5; ++col) {
+    std::vector<double> unique_values;
+    for (size_t row = 0; row < num_rows; ++row) {
+      unique_values.push_back(values[row * 5 + col]);
+    }
+    std::sort(unique_values.begin(), unique_values.end());
+    unique_values.erase(std::unique(unique_values.begin(), unique_values.end()), unique_values.end());
+
+    ASSERT_EQ(unique_values.size(), data.getNumUniqueDataValues(col));
+    for (size_t i = 0; i < unique_values.size(); ++i) {
+      EXPECT_EQ(unique_values[i], data.getUniqueDataValue(col, i));
+    }
+    for (size_t row = 0; row < num_rows; ++row) {
+      size_t index = std::lower_bound(unique_values.begin(), unique_values.end(), values[row * 5 + col])
+          - unique_values.begin();
+      EXPECT_EQ(index, data.getIndex(row, col));
+    }
+  }
+}
+
+TEST(Data, sort) {
+  // 8 bit indexes
+  checkSort(200, 1);
+  checkSort(200, 3);
+
+  // 16 bit indexes
+  checkSort(2000, 1);
+  checkSort(2000, 4);
+
+  // Wide indexes
+  checkSort(70000, 1);
+  checkSort(70000, 4);
+}
+
+// Image rows are pixels (x outer, y inner), columns are the kernel positions (x offset outer, y offset inner) of
+// all channels, named by channel and kernel position
+TEST(Data, loadFromImg) {
+  const int width = 4;
+  const int height = 3;
+  std::vector<uint8_t> pixels(width * height * 3);
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = (i * 37) % 256;
+  }
+  ASSERT_TRUE(stbi_write_png("testimg.png", width, height, 3, pixels.data(), width * 3));
+
+  DataDouble data;
+  std::vector<std::string> dependent_variable_names = { "y" };
+  data.loadFromFileAlex("testimg.png", "", dependent_variable_names, false, 3);
+  std::remove("testimg.png");
+
+  ASSERT_EQ(width * height, data.getNumRows());
+  ASSERT_EQ(27, data.getNumCols());
+  const std::vector<std::string>& names = data.getVariableNames();
+  ASSERT_EQ(27, names.size());
+  EXPECT_EQ("R00", names[0]);
+  EXPECT_EQ("G00", names[1]);
+  EXPECT_EQ("B00", names[2]);
+  EXPECT_EQ("R01", names[3]);
+  EXPECT_EQ("B08", names[26]);
+
+  // Edge pixels are repeated
+  for (int i = 0; i < width; ++i) {
+    for (int j = 0; j < height; ++j) {
+      size_t col = 0;
+      for (int k = i - 1; k <= i + 1; ++k) {
+        for (int l = j - 1; l <= j + 1; ++l) {
+          int x = std::min(std::max(k, 0), width - 1);
+          int y = std::min(std::max(l, 0), height - 1);
+          for (size_t c = 0; c < 3; ++c) {
+            EXPECT_EQ(pixels[(y * width + x) * 3 + c], data.get_x(i * height + j, col++));
+          }
+        }
+      }
+      EXPECT_EQ(1, data.get_y(i * height + j, 0));
+    }
+  }
+}
+
+// Each column in the narrowest exact type
+TEST(DataAdaptive, columnTypes) {
+  std::vector<double> values = { 1, 0, 300, 0.5, 16777215, 1e300, 0, 255, 7, 1.5, 0.25, 1, 1, 7, 65535, -3, 0.75, 2 };
+  DataAdaptive data;
+  data.loadFromValues( { "bit", "uint8", "uint16", "half", "float", "double" }, values, 3);
+  data.packColumns();
+
+  EXPECT_EQ(DataAdaptive::COLUMN_BIT, data.getColumnType(0));
+  EXPECT_EQ(DataAdaptive::COLUMN_UINT8, data.getColumnType(1));
+  EXPECT_EQ(DataAdaptive::COLUMN_UINT16, data.getColumnType(2));
+  EXPECT_EQ(DataAdaptive::COLUMN_HALF, data.getColumnType(3));
+  EXPECT_EQ(DataAdaptive::COLUMN_FLOAT, data.getColumnType(4));
+  EXPECT_EQ(DataAdaptive::COLUMN_DOUBLE, data.getColumnType(5));
+  for (size_t row = 0; row < 3; ++row) {
+    for (size_t col = 0; col < 6; ++col) {
+      EXPECT_EQ(values[row * 6 + col], data.get_x(row, col));
+    }
+  }
+
+  // Typed loops give the same values
+  std::vector<index_t> sampleIDs = { 2, 0, 1 };
+  for (size_t col = 0; col < 6; ++col) {
+    std::vector<double> all_values;
+    data.getAllValues(all_values, sampleIDs, col, 0, 2);
+    std::vector<double> expect = { values[col], values[12 + col] };
+    std::sort(expect.begin(), expect.end());
+    expect.erase(std::unique(expect.begin(), expect.end()), expect.end());
+    EXPECT_EQ(expect, all_values);
+
+    double min, max;
+    data.getMinMaxValues(min, max, sampleIDs, col, 0, 3);
+    EXPECT_EQ(std::min( { values[col], values[6 + col], values[12 + col] }), min);
+    EXPECT_EQ(std::max( { values[col], values[6 + col], values[12 + col] }), max);
+
+    // Gathered in sample order, integer columns also as integers
+    std::vector<double> node_values;
+    data.getValues(node_values, sampleIDs, col, 1, 3);
+    EXPECT_EQ(std::vector<double>( { values[col], values[6 + col] }), node_values);
+    std::vector<int32_t> integer_values;
+    EXPECT_EQ(col < 3, data.getIntegerValues(integer_values, sampleIDs, col, 1, 3));
+    if (col < 3) {
+      EXPECT_EQ(std::vector<int32_t>( { (int32_t) values[col], (int32_t) values[6 + col] }), integer_values);
+    }
+  }
+}
+
+// Shadow variables for corrected impurity importance read the permuted rows, copied after the data or through the
+// permutation (memory saving)
+template<typename T>
+void checkShadowColumns(bool materialize) {
+  size_t num_rows = 50;
+  std::vector<double> values(3 * num_rows);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = ((i * 7919) % 97) * 0.5;
+  }
+  T data;
+  data.loadFromValues( { "a", "b", "c" }, values, num_rows);
+  data.sort(2);
+  data.permuteSampleIDs(RandomGenerator(7));
+  if (materialize) {
+    data.materializeShadowColumns(2);
+  }
+
+  std::vector<index_t> sampleIDs(num_rows);
+  std::iota(sampleIDs.begin(), sampleIDs.end(), 0);
+  std::vector<index_t> indexes(num_rows);
+  for (size_t col = 0; col < 3; ++col) {
+    data.getIndexes(sampleIDs, 3 + col, 0, num_rows, indexes.data());
+    for (size_t row = 0; row < num_rows; ++row) {
+      size_t permuted_row = data.getPermutedSampleID(row);
+      EXPECT_EQ(values[permuted_row * 3 + col], data.get_x(row, 3 + col));
+      EXPECT_EQ(data.getIndex(permuted_row, col), data.getIndex(row, 3 + col));
+      EXPECT_EQ(data.getIndex(permuted_row, col), indexes[row]);
+    }
+  }
+}
+
+TEST(Data, shadowColumns) {
+  checkShadowColumns<DataDouble>(true);
+  checkShadowColumns<DataDouble>(false);
+  checkShadowColumns<DataFloat>(true);
+  checkShadowColumns<DataFloat>(false);
+}
+
+// Values are stored in the mapped file, which is removed directly
+TEST(DataMapped, values) {
+  std::vector<double> values = { 1, 0.5, 255, -2, 3, 7.25 };
+  DataMapped<double> data("testfilemapped");
+  data.loadFromValues( { "a", "b", "c" }, values, 2);
+  EXPECT_FALSE(std::ifstream("testfilemapped").good());
+  for (size_t row = 0; row < 2; ++row) {
+    for (size_t col = 0; col < 3; ++col) {
+      EXPECT_EQ(values[row * 3 + col], data.get_x(row, col));
+    }
+  }
+}
+
+// Files larger than max_mapping are written and read through windows, each thread has its own windows
+TEST(DataMapped, windows) {
+  size_t num_rows = 5000;
+  std::vector<double> values(3 * num_rows);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = ((i * 7919) % 1000) * 0.25;
+  }
+
+  // 120 KB file, windows of one page
+  DataMapped<double> data("testfilemapped", 1 << 16);
+  data.loadFromValues( { "a", "b", "c" }, values, num_rows);
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0; thread_idx < 4; ++thread_idx) {
+    threads.emplace_back([&data, &values, num_rows, thread_idx]() {
+      for (size_t i = 0; i < num_rows; ++i) {
+        size_t row = thread_idx % 2 ? num_rows - 1 - i : (i * 37) % num_rows;
+        for (size_t col = 0; col < 3; ++col) {
+          EXPECT_EQ(values[row * 3 + col], data.get_x(row, col));
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Row-major data stores rows contiguously, set_x and set_x_column only write their own cells
+template<typename T>
+void checkRowMajorLayout() {
+  std::vector<double> values = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+  DataRowMajor<T> data;
+  DataDouble column_major;
+  data.loadFromValues( { "a", "b", "c" }, values, 4);
+  column_major.loadFromValues( { "a", "b", "c" }, values, 4);
+  for (size_t row = 0; row < 4; ++row) {
+    for (size_t col = 0; col < 3; ++col) {
+      EXPECT_EQ(values[row * 3 + col], data.get_x(row, col));
+      EXPECT_EQ(column_major.get_x(row, col), data.get_x(row, col));
+    }
+  }
+
+  bool error = false;
+  data.set_x(1, 2, 42, error);
+  values[2 * 3 + 1] = 42;
+  const uint8_t column[] = { 20, 30 };
+  data.set_x_column(2, 1, column, 2, error);
+  values[1 * 3 + 2] = 20;
+  values[2 * 3 + 2] = 30;
+  EXPECT_FALSE(error);
+  for (size_t row = 0; row < 4; ++row) {
+    for (size_t col = 0; col < 3; ++col) {
+      EXPECT_EQ(values[row * 3 + col], data.get_x(row, col));
+    }
+  }
+}
+
+TEST(DataRowMajor, layout) {
+  checkRowMajorLayout<double>();
+  checkRowMajorLayout<float>();
+  checkRowMajorLayout<uint8_t>();
+}
+
+// Level-wise growth finds the same splits as growing node by node. The responses are small integers, so that the
+// response sums of regression are exact in any order.
+template<typename T>
+void checkLevelWiseGrowth() {
+  std::ofstream datafile("testlevelwise.csv");
+  datafile << "x1 x2 x3 y" << std::endl;
+  for (size_t i = 0; i < 300; ++i) {
+    size_t x1 = (i * 7) % 9;
+    size_t x2 = (i * 13) % 4;
+    size_t x3 = (i * 3) % 6;
+    datafile << x1 << " " << x2 << " " << x3 << " " << ((x1 + x2 + i % 3) % 3) << std::endl;
+  }
+  datafile.close();
+
+  std::vector<std::vector<std::vector<size_t>>> split_varIDs;
+  std::vector<std::vector<std::vector<double>>> split_values;
+  for (bool level_wise : { false, true }) {
+    T forest;
+    forest.initCpp("y", MEM_DOUBLE, "testlevelwise.csv", "", 3, "testlevelwise", 5, nullptr, 1, 1, "", IMP_NONE, 0,
+        "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP, false,
+        RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+    forest.setLevelWiseGrowth(level_wise);
+    forest.run(false, false);
+    split_varIDs.push_back(forest.getSplitVarIDs());
+    split_values.push_back(forest.getSplitValues());
+  }
+  EXPECT_EQ(split_varIDs[0], split_varIDs[1]);
+  EXPECT_EQ(split_values[0], split_values[1]);
+  EXPECT_GT(split_varIDs[0][0].size(), 1);
+
+  std::remove("testlevelwise.csv");
+}
+
+TEST(ForestClassification, levelWiseGrowth) {
+  checkLevelWiseGrowth<ForestClassification>();
+}
+
+TEST(ForestProbability, levelWiseGrowth) {
+  checkLevelWiseGrowth<ForestProbability>();
+}
+
+TEST(ForestRegression, levelWiseGrowth) {
+  checkLevelWiseGrowth<ForestRegression>();
+}
+
+// Level-wise growth with memory saving splitting, in memory and out-of-core, finds the same splits as growing node by
+// node
+template<typename T>
+void checkLevelWiseGrowthMemorySaving() {
+  std::ofstream datafile("testlevelwise_savemem.csv");
+  datafile << "x1 x2 x3 y" << std::endl;
+  for (size_t i = 0; i < 300; ++i) {
+    size_t x1 = (i * 7) % 9;
+    size_t x2 = (i * 13) % 4;
+    double x3 = ((i * 3) % 61) * 0.1;
+    datafile << x1 << " " << x2 << " " << x3 << " " << ((x1 + x2 + i % 3) % 3) << std::endl;
+  }
+  datafile.close();
+
+  std::vector<std::vector<std::vector<size_t>>> split_varIDs;
+  std::vector<std::vector<std::vector<double>>> split_values;
+  for (size_t run = 0; run < 3; ++run) {
+    T forest;
+    if (run == 2) {
+      forest.setOutOfCoreFile("testlevelwise_savemem.mapped");
+    }
+    forest.setLevelWiseGrowth(run > 0);
+    forest.initCpp("y", MEM_DOUBLE, "testlevelwise_savemem.csv", "", 3, "testlevelwise", 5, nullptr, 1, 1, "",
+        IMP_NONE, 0, "", { }, "", true, { }, true, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP,
+        false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+    forest.run(false, false);
+    split_varIDs.push_back(forest.getSplitVarIDs());
+    split_values.push_back(forest.getSplitValues());
+  }
+  EXPECT_EQ(split_varIDs[0], split_varIDs[1]);
+  EXPECT_EQ(split_values[0], split_values[1]);
+  EXPECT_EQ(split_varIDs[0], split_varIDs[2]);
+  EXPECT_EQ(split_values[0], split_values[2]);
+  EXPECT_GT(split_varIDs[0][0].size(), 1);
+
+  std::remove("testlevelwise_savemem.csv");
+}
+
+TEST(ForestClassification, levelWiseGrowthMemorySaving) {
+  checkLevelWiseGrowthMemorySaving<ForestClassification>();
+}
+
+TEST(ForestProbability, levelWiseGrowthMemorySaving) {
+  checkLevelWiseGrowthMemorySaving<ForestProbability>();
+}
+
+TEST(ForestRegression, levelWiseGrowthMemorySaving) {
+  checkLevelWiseGrowthMemorySaving<ForestRegression>();
+}
+
+// Permutation importance does not depend on the number of threads, which split trees and variables into chunks
+template<typename T>
+void checkPermutationImportanceThreads() {
+  std::ofstream datafile("testimportance.csv");
+  datafile << "x1 x2 x3 x4 y" << std::endl;
+  for (size_t i = 0; i < 200; ++i) {
+    size_t x1 = (i * 7) % 9;
+    size_t x2 = (i * 13) % 4;
+    double x3 = ((i * 3) % 61) * 0.1;
+    datafile << x1 << " " << x2 << " " << x3 << " " << (i * 11) % 5 << " " << ((x1 + x2 + i % 3) % 3) << std::endl;
+  }
+  datafile.close();
+
+  for (auto importance_mode : { IMP_PERM_BREIMAN, IMP_PERM_LIAW, IMP_PERM_RAW, IMP_PERM_CASEWISE }) {
+    std::vector<std::vector<double>> importance;
+    std::vector<std::vector<double>> importance_casewise;
+    for (uint num_threads : { 1, 2, 5 }) {
+      T forest;
+      forest.initCpp("y", MEM_DOUBLE, "testimportance.csv", "", 2, "testimportance", 12, nullptr, 1, num_threads,
+          "", importance_mode, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA,
+          DEFAULT_MINPROP, false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0,
+          false, 3);
+      forest.run(false, true);
+      importance.push_back(forest.getVariableImportance());
+      importance_casewise.push_back(forest.getVariableImportanceCasewise());
+    }
+
+    // Chunks are summed in a different order
+    for (size_t run = 1; run < importance.size(); ++run) {
+      ASSERT_EQ(importance[0].size(), importance[run].size());
+      for (size_t varID = 0; varID < importance[0].size(); ++varID) {
+        EXPECT_NEAR(importance[0][varID], importance[run][varID], 1e-12 * (1 + std::abs(importance[0][varID])));
+      }
+      ASSERT_EQ(importance_casewise[0].size(), importance_casewise[run].size());
+      for (size_t i = 0; i < importance_casewise[0].size(); ++i) {
+        EXPECT_NEAR(importance_casewise[0][i], importance_casewise[run][i],
+            1e-12 * (1 + std::abs(importance_casewise[0][i])));
+      }
+    }
+    EXPECT_EQ(4, importance[0].size());
+    EXPECT_EQ(importance_mode == IMP_PERM_CASEWISE ? 4 * 200 : 0, importance_casewise[0].size());
+  }
+  std::remove("testimportance.csv");
+}
+
+TEST(ForestClassification, permutationImportanceThreads) {
+  checkPermutationImportanceThreads<ForestClassification>();
+}
+
+TEST(ForestRegression, permutationImportanceThreads) {
+  checkPermutationImportanceThreads<ForestRegression>();
+}
+
+// Maxstat splitting with samples presorted once per tree finds the same splits as sorting in each node (--savemem)
+template<typename T>
+void checkMaxstatPresorted(const std::string& status_variable_name) {
+  std::ofstream datafile("testmaxstat.csv");
+  datafile << "x1 x2 x3 time status" << std::endl;
+  for (size_t i = 0; i < 300; ++i) {
+    size_t x1 = (i * 7) % 9;
+    double x2 = ((i * 13) % 41) * 0.5;
+    double x3 = ((i * 3) % 61) * 0.1;
+    datafile << x1 << " " << x2 << " " << x3 << " " << 1 + x1 * 3 + (i * 11) % 17 + (x2 > 10) * 5 << " "
+        << (i % 5 != 0) << std::endl;
+  }
+  datafile.close();
+
+  std::vector<std::vector<std::vector<size_t>>> split_varIDs;
+  std::vector<std::vector<std::vector<double>>> split_values;
+  std::vector<double> prediction_errors;
+  for (bool memory_saving_splitting : { false, true }) {
+    T forest;
+    forest.initCpp("time", MEM_DOUBLE, "testmaxstat.csv", "", 2, "testmaxstat", 5, nullptr, 1, 1, "", IMP_NONE, 0, "",
+        { }, status_variable_name, true, { }, memory_saving_splitting, MAXSTAT, "", false, 0, DEFAULT_ALPHA,
+        DEFAULT_MINPROP, false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false,
+        3);
+    forest.run(false, true);
+    split_varIDs.push_back(forest.getSplitVarIDs());
+    split_values.push_back(forest.getSplitValues());
+    prediction_errors.push_back(forest.getOverallPredictionError());
+  }
+  EXPECT_EQ(split_varIDs[0], split_varIDs[1]);
+  EXPECT_EQ(split_values[0], split_values[1]);
+  EXPECT_NEAR(prediction_errors[0], prediction_errors[1], 1e-12);
+  EXPECT_GT(split_varIDs[0][0].size(), 1);
+  std::remove("testmaxstat.csv");
+}
+
+TEST(ForestRegression, maxstatPresorted) {
+  checkMaxstatPresorted<ForestRegression>("");
+}
+
+TEST(ForestSurvival, maxstatPresorted) {
+  checkMaxstatPresorted<ForestSurvival>("status");
+}
+
+// Fixed point probabilities agree with the floating point prediction up to the rounding of the leaves
+TEST(ForestProbability, fixedPointPrediction) {
+  std::ofstream datafile("testfixedpoint.csv");
+  datafile << "x1 x2 y" << std::endl;
+  for (size_t i = 0; i < 100; ++i) {
+    size_t x1 = (i * 37) % 256;
+    size_t x2 = (i * 11) % 7;
+    datafile << x1 << " " << x2 << " " << ((x1 > 100) + (x2 + i) % 2) % 3 << std::endl;
+  }
+  datafile.close();
+
+  ForestProbability training_forest;
+  training_forest.initCpp("y", MEM_DOUBLE, "testfixedpoint.csv", "", 0, "testfixedpoint", 20, nullptr, 1, 1, "",
+      IMP_NONE, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP,
+      false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+  training_forest.run(false, false);
+  training_forest.saveToFile();
+
+  std::vector<std::vector<std::vector<double>>> predictions;
+  for (bool fixed_point : { false, true }) {
+    ForestProbability forest;
+    forest.initCpp("", MEM_DOUBLE, "testfixedpoint.csv", "", 0, "testfixedpoint", 0, nullptr, 1, 2,
+        "testfixedpoint.forest", IMP_NONE, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0,
+        DEFAULT_ALPHA, DEFAULT_MINPROP, false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false,
+        0, 0, false, 3);
+    forest.setFixedPointPrediction(fixed_point, false);
+    forest.run(false, false);
+    predictions.push_back(forest.getPredictions()[0]);
+  }
+  ASSERT_EQ(predictions[0].size(), predictions[1].size());
+  for (size_t i = 0; i < predictions[0].size(); ++i) {
+    for (size_t j = 0; j < predictions[0][i].size(); ++j) {
+      EXPECT_NEAR(predictions[0][i][j], predictions[1][i][j], 1e-4);
+    }
+  }
+
+  std::remove("testfixedpoint.csv");
+  std::remove("testfixedpoint.forest");
+}
+
+// Version 2 forests predict as the original forest on double data, also for values just below the split values
+TEST(CompactForest, doubleSplitValues) {
+  std::ofstream datafile("testcompact.csv");
+  datafile << std::setprecision(17) << "x y" << std::endl;
+  for (size_t i = 0; i < 40; ++i) {
+    datafile << i * 0.1 << " " << (i * 7) % 10 << std::endl;
+  }
+  datafile.close();
+
+  // Values at the split values of the trees, which are midpoints of the training values
+  std::ofstream predfile("testcompact_pred.csv");
+  predfile << std::setprecision(17) << "x y" << std::endl;
+  for (size_t i = 0; i + 1 < 40; ++i) {
+    predfile << (i * 0.1 + (i + 1) * 0.1) / 2 << " 0" << std::endl;
+  }
+  predfile.close();
+
+  ForestRegression training_forest;
+  training_forest.initCpp("y", MEM_DOUBLE, "testcompact.csv", "", 0, "testcompact", 10, nullptr, 1, 1, "", IMP_NONE,
+      0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP, false,
+      RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+  training_forest.run(false, false);
+  training_forest.saveToFile();
+  std::rename("testcompact.forest", "testcompact_v1.forest");
+  training_forest.saveToCompactFile(false);
+
+  // Version 1 and 2 files, traversed and with the QuickScorer
+  std::vector<std::vector<std::vector<double>>> predictions;
+  for (auto& forest_file : { "testcompact_v1.forest", "testcompact_v1.forest", "testcompact.forest",
+      "testcompact.forest" }) {
+    ForestRegression forest;
+    forest.initCpp("", MEM_DOUBLE, "testcompact_pred.csv", "", 0, "testcompact", 0, nullptr, 1, 1, forest_file,
+        IMP_NONE, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP,
+        false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+    if (predictions.size() % 2 == 1) {
+      forest.setPredictionBackend(BACKEND_QUICKSCORER);
+    }
+    forest.run(false, false);
+    predictions.push_back(forest.getPredictions()[0]);
+  }
+
+  // Version 1 trees keep their double leaf values with the QuickScorer, version 2 leaf values are saved as float
+  EXPECT_EQ(predictions[0], predictions[1]);
+  for (size_t i = 0; i < predictions[0][0].size(); ++i) {
+    EXPECT_NEAR(predictions[0][0][i], predictions[2][0][i], 1e-5);
+    EXPECT_NEAR(predictions[0][0][i], predictions[3][0][i], 1e-5);
+  }
+
+  std::remove("testcompact.csv");
+  std::remove("testcompact_pred.csv");
+  std::remove("testcompact.forest");
+  std::remove("testcompact_v1.forest");
+}
+
+// QuickScorer predictions of version 1 probability forests are aggregated from the double class frequencies of the
+// trees, in multiple threads
+TEST(QuickScorer, version1Probability) {
+  std::ofstream datafile("testcompact_probability.csv");
+  datafile << "x1 x2 y" << std::endl;
+  for (size_t i = 0; i < 300; ++i) {
+    datafile << (i * 37) % 101 << " " << (i * 53) % 97 * 0.1 << " " << (i * 7919) % 7 % 3 << std::endl;
+  }
+  datafile.close();
+
+  ForestProbability training_forest;
+  training_forest.initCpp("y", MEM_DOUBLE, "testcompact_probability.csv", "", 0, "testcompact_probability", 10,
+      nullptr, 1, 1, "", IMP_NONE, 5, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA,
+      DEFAULT_MINPROP, false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false,
+      3);
+  training_forest.run(false, false);
+  training_forest.saveToFile();
+
+  std::vector<std::vector<std::vector<double>>> predictions;
+  for (auto backend : { BACKEND_TRAVERSAL, BACKEND_QUICKSCORER }) {
+    ForestProbability forest;
+    forest.initCpp("", MEM_DOUBLE, "testcompact_probability.csv", "", 0, "testcompact_probability", 0, nullptr, 1, 3,
+        "testcompact_probability.forest", IMP_NONE, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false,
+        0, DEFAULT_ALPHA, DEFAULT_MINPROP, false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false,
+        false, 0, 0, false, 3);
+    forest.setPredictionBackend(backend);
+    forest.run(false, false);
+    predictions.push_back(forest.getPredictions()[0]);
+  }
+  EXPECT_EQ(predictions[0], predictions[1]);
+
+  std::remove("testcompact_probability.csv");
+  std::remove("testcompact_probability.forest");
+}
+
+// Sections outside of the file are reported as corrupt instead of being read
+TEST(CompactForest, corruptHeader) {
+  CompactForestBuilder builder(TREE_CLASSIFICATION, 2, { "y" }, { true, false }, { 0, 1 }, 1);
+  builder.addTree( { { 1, 0, 0 }, { 2, 0, 0 } }, { 1, 0, 0 }, { 1, 0, 0 }, { 0, 1 });
+  std::vector<char> buffer = builder.finish();
+  std::vector<char> valid = buffer;
+  CompactForest forest(std::move(valid));
+  EXPECT_EQ(std::vector<std::string>( { "y" }), forest.getDependentVariableNames());
+  EXPECT_EQ(std::vector<double>( { 0, 1 }), forest.getClassValues());
+
+  // Offsets beyond the end and offsets overflowing with the section size
+  for (size_t field : { offsetof(CompactForestHeader, names_offset), offsetof(CompactForestHeader, is_ordered_offset),
+      offsetof(CompactForestHeader, class_values_offset), offsetof(CompactForestHeader, split_masks_offset),
+      offsetof(CompactForestHeader, trees_offset) }) {
+    for (uint64_t offset : { (uint64_t) buffer.size() - 1, std::numeric_limits<uint64_t>::max() - 3 }) {
+      std::vector<char> corrupt = buffer;
+      std::memcpy(corrupt.data() + field, &offset, sizeof(offset));
+      EXPECT_THROW(CompactForest(std::move(corrupt)), std::runtime_error);
+    }
+  }
+
+  // Tree nodes outside of the file
+  CompactTreeInfo tree_info;
+  uint64_t trees_offset = ((const CompactForestHeader*) buffer.data())->trees_offset;
+  std::memcpy(&tree_info, buffer.data() + trees_offset, sizeof(tree_info));
+  tree_info.num_nodes = 1 << 30;
+  std::vector<char> corrupt = buffer;
+  std::memcpy(corrupt.data() + trees_offset, &tree_info, sizeof(tree_info));
+  EXPECT_THROW(CompactForest(std::move(corrupt)), std::runtime_error);
+}
+
+// 8 bit nodes find the same terminal nodes as the float nodes, traversing one tree at a time (less than 4 trees) or 4
+// trees at once
+TEST(CompactForest, quantizedTraversal) {
+  std::ofstream datafile("testcompact_quantized.csv");
+  datafile << "x1 x2 y" << std::endl;
+  for (size_t i = 0; i < 300; ++i) {
+    datafile << (i * 37) % 256 << " " << (i * 53) % 97 << " " << (i * 7919) % 1009 << std::endl;
+  }
+  datafile.close();
+
+  for (uint num_trees : { 3, 10 }) {
+    ForestRegression training_forest;
+    training_forest.initCpp("y", MEM_DOUBLE, "testcompact_quantized.csv", "", 0, "testcompact_quantized", num_trees,
+        nullptr, 1, 1, "", IMP_NONE, 1, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA,
+        DEFAULT_MINPROP, false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false,
+        3);
+    training_forest.run(false, false);
+    training_forest.saveToCompactFile(true);
+    std::rename("testcompact_quantized.forest", "testcompact_quantized8.forest");
+    training_forest.saveToCompactFile(false);
+
+    std::vector<std::vector<std::vector<double>>> terminal_nodes;
+    for (auto& forest_file : { "testcompact_quantized.forest", "testcompact_quantized8.forest" }) {
+      ForestRegression forest;
+      forest.initCpp("", MEM_DOUBLE, "testcompact_quantized.csv", "", 0, "testcompact_quantized", 0, nullptr, 1, 1,
+          forest_file, IMP_NONE, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA,
+          DEFAULT_MINPROP, false, TERMINALNODES, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0,
+          false, 3);
+      forest.run(false, false);
+      terminal_nodes.push_back(forest.getPredictions()[0]);
+    }
+    EXPECT_EQ(terminal_nodes[0], terminal_nodes[1]);
+    EXPECT_EQ(num_trees, terminal_nodes[0][0].size());
+  }
+  std::remove("testcompact_quantized.csv");
+  std::remove("testcompact_quantized.forest");
+  std::remove("testcompact_quantized8.forest");
+}
+
+// QuickScorer finds the same terminal nodes as tree traversal, also for trees with more than 64 leaves which are
+// traversed below the frontier
+TEST(QuickScorer, deepTrees) {
+  std::ofstream datafile("testcompact_deep.csv");
+  datafile << "x1 x2 y" << std::endl;
+  for (size_t i = 0; i < 400; ++i) {
+    datafile << (i * 37) % 101 << " " << (i * 53) % 97 * 0.5 << " " << (i * 7919) % 1009 << std::endl;
+  }
+  datafile.close();
+
+  std::vector<std::vector<std::vector<double>>> terminal_nodes;
+  for (auto backend : { BACKEND_TRAVERSAL, BACKEND_QUICKSCORER }) {
+    ForestRegression forest;
+    forest.initCpp("y", MEM_DOUBLE, "testcompact_deep.csv", "", 0, "testcompact_deep", 10, nullptr, 1, 1, "",
+        IMP_NONE, 1, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP,
+        false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+    forest.run(false, false);
+    forest.saveToCompactFile(false);
+
+    ForestRegression prediction_forest;
+    prediction_forest.initCpp("", MEM_DOUBLE, "testcompact_deep.csv", "", 0, "testcompact_deep", 0, nullptr, 1, 1,
+        "testcompact_deep.forest", IMP_NONE, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0,
+        DEFAULT_ALPHA, DEFAULT_MINPROP, false, TERMINALNODES, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false,
+        false, 0, 0, false, 3);
+    prediction_forest.setPredictionBackend(backend);
+    prediction_forest.run(false, false);
+    terminal_nodes.push_back(prediction_forest.getPredictions()[0]);
+  }
+  EXPECT_EQ(terminal_nodes[0], terminal_nodes[1]);
+
+  // At least one tree is truncated
+  EXPECT_GT(*std::max_element(terminal_nodes[0][0].begin(), terminal_nodes[0][0].end()), 127);
+
+  std::remove("testcompact_deep.csv");
+  std::remove("testcompact_deep.forest");
+}
+
+// Variables used by a tree are seen by trees lag and more positions later, trees may finish out of order
+TEST(RegularizationState, lag) {
+  RegularizationState state;
+  state.init(3, 6, 2);
+  state.setUsed(1, 2);
+  state.setUsed(1, 0);
+  state.setUsed(2, 3);
+  EXPECT_FALSE(state.isUsed(0, 5));
+  EXPECT_FALSE(state.isUsed(1, 1));
+  EXPECT_TRUE(state.isUsed(1, 2));
+  EXPECT_FALSE(state.isUsed(2, 4));
+  EXPECT_TRUE(state.isUsed(2, 5));
+
+  // Tree 3 waits for trees 0 and 1
+  state.setGrown(1);
+  std::thread waiting([&state]() {
+    state.waitForTree(3);
+  });
+  state.setGrown(0);
+  waiting.join();
+  state.waitForTree(1);
+}
+
+// Forest loaded for prediction, predicts column-major data instead of the row-major prediction data
+class ColumnMajorPredictionForest: public ForestRegression {
+public:
+  void predictColumnMajor(const std::vector<double>& values, size_t num_rows) {
+    std::unique_ptr<Data> prediction_data = make_unique_ranger<DataDouble>();
+    prediction_data->loadFromValues(data->getVariableNames(), values, num_rows);
+    setPredictionData(std::move(prediction_data));
+    predict();
+  }
+};
+
+// Predictions of row-major data are the same as of column-major data
+TEST(DataRowMajor, predictions) {
+  std::ofstream datafile("testrowmajor.csv");
+  datafile << "x1 x2 x3 y" << std::endl;
+  for (size_t i = 0; i < 200; ++i) {
+    datafile << (i * 37) % 101 << " " << (i * 53) % 97 * 0.5 << " " << (i * 17) % 13 << " " << (i * 7919) % 1009
+        << std::endl;
+  }
+  datafile.close();
+
+  ForestRegression training_forest;
+  training_forest.initCpp("y", MEM_DOUBLE, "testrowmajor.csv", "", 0, "testrowmajor", 20, nullptr, 1, 1, "",
+      IMP_NONE, 5, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP,
+      false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+  training_forest.run(false, false);
+  training_forest.saveToFile();
+
+  std::vector<double> values;
+  for (size_t i = 0; i < 50; ++i) {
+    values.push_back((i * 11) % 101);
+    values.push_back((i * 29) % 97 * 0.5);
+    values.push_back(i % 13);
+  }
+
+  ForestRegression row_major_forest;
+  ColumnMajorPredictionForest column_major_forest;
+  for (ForestRegression* forest : { &row_major_forest, static_cast<ForestRegression*>(&column_major_forest) }) {
+    forest->initCpp("", MEM_DOUBLE, "testrowmajor.csv", "", 0, "testrowmajor", 0, nullptr, 1, 1,
+        "testrowmajor.forest", IMP_NONE, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0,
+        DEFAULT_ALPHA, DEFAULT_MINPROP, false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false,
+        false, 0, 0, false, 3);
+  }
+  row_major_forest.predictValues(values, 50);
+  column_major_forest.predictColumnMajor(values, 50);
+  EXPECT_EQ(50, row_major_forest.getPredictions()[0][0].size());
+  EXPECT_EQ(row_major_forest.getPredictions(), column_major_forest.getPredictions());
+
+  std::remove("testrowmajor.csv");
+  std::remove("testrowmajor.forest");
+}
+
+// Regression forest for y = (x > 10), saved to testforest.forest and loaded for prediction
+std::unique_ptr<Forest> loadTestForest() {
+  std::ofstream datafile("testforest.csv");
+  datafile << "x y" << std::endl;
+  for (size_t i = 1; i <= 20; ++i) {
+    datafile << i << " " << (i > 10) << std::endl;
+  }
+  datafile.close();
+
+  ForestRegression training_forest;
+  training_forest.initCpp("y", MEM_DOUBLE, "testforest.csv", "", 0, "testforest", 10, nullptr, 1, 1, "", IMP_NONE, 0, "",
+      { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP, false, RESPONSE,
+      DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+  training_forest.run(false, false);
+  training_forest.saveToFile();
+
+  std::unique_ptr<Forest> forest = make_unique_ranger<ForestRegression>();
+  forest->initCpp("", MEM_DOUBLE, "testforest.csv", "", 0, "testforest", 0, nullptr, 1, 1, "testforest.forest",
+      IMP_NONE, 0, "", { }, "", true, { }, false, DEFAULT_SPLITRULE, "", false, 0, DEFAULT_ALPHA, DEFAULT_MINPROP,
+      false, RESPONSE, DEFAULT_NUM_RANDOM_SPLITS, DEFAULT_MAXDEPTH, { }, false, false, 0, 0, false, 3);
+  return forest;
+}
+
+// Requests on a stream, errors do not stop the server
+TEST(PredictionServer, stream) {
+  std::unique_ptr<Forest> forest = loadTestForest();
+  PredictionServer server(*forest, false, nullptr);
+
+  std::stringstream requests("values 2\n2\n19\nbogus\nvalues 1\n1 2\npredict testforest.csv testforest_pred\nquit\n");
+  std::stringstream replies;
+  EXPECT_TRUE(server.serveStream(requests, replies));
+
+  std::string line;
+  double prediction;
+  getline(replies, line);
+  EXPECT_EQ("ok 3", line);
+  getline(replies, line);
+  replies >> prediction;
+  EXPECT_LT(prediction, 0.5);
+  replies >> prediction;
+  EXPECT_GT(prediction, 0.5);
+  getline(replies, line);
+  getline(replies, line);
+  EXPECT_EQ("error Unknown request: bogus.", line);
+  getline(replies, line);
+  EXPECT_EQ(0, line.find("error "));
+  getline(replies, line);
+  EXPECT_EQ("ok testforest_pred.prediction", line);
+  getline(replies, line);
+  EXPECT_EQ("ok", line);
+  EXPECT_TRUE(std::ifstream("testforest_pred.prediction").good());
+
+  std::remove("testforest.csv");
+  std::remove("testforest.forest");
+  std::remove("testforest_pred.prediction");
+}
+
+#ifndef _WIN32
+// Client for the socket server: send requests, close the sending side and return all replies
+std::string sendToPredictionServer(const std::string& socket_path, const std::string& requests) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  for (size_t i = 0; i < 100 && connect(fd, (sockaddr*) &address, sizeof(address)) != 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  EXPECT_EQ((ssize_t) requests.size(), write(fd, requests.c_str(), requests.size()));
+  shutdown(fd, SHUT_WR);
+
+  std::string replies;
+  char buffer[256];
+  ssize_t num_bytes;
+  while ((num_bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+    replies.append(buffer, num_bytes);
+  }
+  close(fd);
+  return replies;
+}
+
+TEST(PredictionServer, socket) {
+  std::unique_ptr<Forest> forest = loadTestForest();
+  PredictionServer server(*forest, false, nullptr);
+  std::thread server_thread(&PredictionServer::serveSocket, &server, "testforest.socket");
+
+  std::string replies = sendToPredictionServer("testforest.socket", "values 1\n19\nquit\n");
+  server_thread.join();
+
+  std::stringstream reply_stream(replies);
+  std::string line;
+  double prediction;
+  getline(reply_stream, line);
+  EXPECT_EQ("ok 2", line);
+  getline(reply_stream, line);
+  reply_stream >> prediction;
+  EXPECT_GT(prediction, 0.5);
+  getline(reply_stream, line);
+  getline(reply_stream, line);
+  EXPECT_EQ("ok", line);
+  EXPECT_FALSE(std::ifstream("testforest.socket").good());
+
+  std::remove("testforest.csv");
+  std::remove("testforest.forest");
+}
+#endif